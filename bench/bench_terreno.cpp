@@ -0,0 +1,269 @@
+// Microbenchmarks for the terrain generation and mesh loading hot paths (no gl
+// context nor gl code needed). Each benchmark is calibrated to run for at least --min-time
+// per sample, and the per-item time of every sample goes to the json report, so
+// two runs (e.g. two commits) can be compared with compare_bench.py. Run it from
+// the bin folder:
+//    bench_terreno [--json file] [--label text] [--filter text] [--samples n] [--min-time ms]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Bezier.hpp"
+#include "Caminos.hpp"
+#include "ObjMesh.hpp"
+#include "Geometry.hpp"
+#include "Misc.hpp"
+#include "Terreno.hpp"
+
+// keeps the compiler from optimizing away the result of a benchmarked call
+template<typename T>
+inline void doNotOptimize(const T &value) {
+#ifdef __GNUC__
+	asm volatile("" : : "g"(&value) : "memory");
+#else
+	static volatile const void *sink; sink = &value;
+#endif
+}
+
+// readObj logs every file it opens through cg_info (std::cerr)
+class QuietStderr {
+public:
+	QuietStderr() : old(std::cerr.rdbuf(nullptr)) { }
+	~QuietStderr() { std::cerr.rdbuf(old); std::cerr.clear(); }
+private:
+	std::streambuf *old;
+};
+
+struct Result {
+	std::string name;
+	long long iterations = 0; // per sample
+	int items = 1; // per iteration, times are per item
+	std::vector<double> ns; // one per sample
+	double median() const {
+		std::vector<double> v = ns; std::sort(v.begin(),v.end());
+		return v.size()%2 ? v[v.size()/2] : (v[v.size()/2-1]+v[v.size()/2])/2;
+	}
+	double mean() const { double s = 0; for(double x : ns) s += x; return s/ns.size(); }
+	double stddev() const {
+		double m = mean(), s = 0; for(double x : ns) s += (x-m)*(x-m);
+		return ns.size()>1 ? std::sqrt(s/(ns.size()-1)) : 0.0;
+	}
+};
+
+class Suite {
+public:
+	std::string filter;
+	int samples = 15;
+	double min_time = 0.05; // seconds per sample
+	std::vector<Result> results;
+
+	// func runs one iteration over "items" items (i.e. calls to the benchmarked function)
+	void run(const std::string &name, int items, const std::function<void()> &func) {
+		if (name.find(filter)==std::string::npos) return;
+		using clock = std::chrono::steady_clock;
+		// calibrate: double the iterations until a sample takes long enough
+		long long iterations = 1;
+		func(); // warm up caches and lazy allocations
+		for(;;) {
+			auto t0 = clock::now();
+			for(long long i=0;i<iterations;++i) func();
+			double t = std::chrono::duration<double>(clock::now()-t0).count();
+			if (t>=min_time or iterations>=(1LL<<30)) break;
+			iterations = t>0 ? std::max(iterations*2,(long long)(iterations*min_time/t*1.2)) : iterations*10;
+		}
+		Result r; r.name = name; r.iterations = iterations; r.items = items;
+		for(int s=0;s<samples;++s) {
+			auto t0 = clock::now();
+			for(long long i=0;i<iterations;++i) func();
+			double t = std::chrono::duration<double>(clock::now()-t0).count();
+			r.ns.push_back(t*1e9/(double(iterations)*items));
+		}
+		std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(14) << r.median() << " ns" << std::setw(8) << std::setprecision(1)
+				  << (r.median()>0 ? 100.0*r.stddev()/r.mean() : 0.0) << " %" << std::endl;
+		results.push_back(std::move(r));
+	}
+
+	bool writeJson(const std::string &fname, const std::string &label) const {
+		std::ofstream file(fname);
+		if (not file.is_open()) return false;
+		std::time_t now = std::time(nullptr);
+		char date[32]; std::strftime(date,sizeof(date),"%Y-%m-%dT%H:%M:%S",std::localtime(&now));
+		file << "{\n  \"label\": \"" << label << "\",\n  \"date\": \"" << date << "\",\n"
+#ifdef __VERSION__
+			 << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+#endif
+			 << "  \"unit\": \"ns per item\",\n  \"benchmarks\": [";
+		file << std::setprecision(17);
+		for(size_t i=0;i<results.size();++i) {
+			const Result &r = results[i];
+			file << (i?",":"") << "\n    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+				 << ", \"items\": " << r.items << ", \"median\": " << r.median() << ", \"mean\": " << r.mean()
+				 << ", \"stddev\": " << r.stddev() << ", \"samples\": [";
+			for(size_t j=0;j<r.ns.size();++j) file << (j?", ":"") << r.ns[j];
+			file << "] }";
+		}
+		file << "\n  ]\n}\n";
+		return file.good();
+	}
+};
+
+int main(int argc, char *argv[]) {
+	Suite suite;
+	std::string json = "bench_terreno.json", label;
+	for(int i=1;i<argc;++i) {
+		std::string opt = argv[i];
+		if (i+1>=argc) { std::cerr << "Missing value for " << opt << std::endl; return 2; }
+		std::string val = argv[++i];
+		if (opt=="--json") json = val;
+		else if (opt=="--label") label = val;
+		else if (opt=="--filter") suite.filter = val;
+		else if (opt=="--samples") suite.samples = std::max(2,std::atoi(val.c_str()));
+		else if (opt=="--min-time") suite.min_time = std::atof(val.c_str())/1000.0;
+		else { std::cerr << "Unknown option " << opt << std::endl; return 1; }
+	}
+	std::cout << std::left << std::setw(48) << "benchmark" << std::right << std::setw(17) << "median/item"
+			  << std::setw(10) << "cv" << std::endl;
+
+	// noise
+	for(int size : {64,128,256}) {
+		for(int octaves : {1,4,8}) {
+			ParametrosTerreno p; p.tamanioMapa = size; p.numeroDeOctavas = octaves;
+			suite.run("createNoiseMap/size="+std::to_string(size)+"/octaves="+std::to_string(octaves),1,
+					  [&](){ doNotOptimize(createNoiseMap(p)); });
+		}
+	}
+	for(int subdivision : {1,8,64}) {
+		ParametrosTerreno p; p.tamanioMapa = 128;
+		MapaDeRuido octava(p.tamanioMapa+1,FilaDeRuido(p.tamanioMapa+1));
+		GeneradorTerreno generador(0);
+		suite.run("generarOctava/size=128/subdivision="+std::to_string(subdivision),1,
+				  [&](){ generarOctava(p,generador,octava,1.f,subdivision); doNotOptimize(octava); });
+	}
+
+	// interpolation, over a batch of random points in a unit cell
+	{
+		const int n = 4096;
+		GeneradorTerreno generador(1);
+		std::vector<float> in(n*6);
+		for(float &x : in) x = aleatorio(generador);
+		suite.run("interpolacionBilineal",n,[&](){
+			float acc = 0;
+			for(int i=0;i<n;++i) {
+				const float *v = &in[i*6];
+				acc += interpolacionBilineal(0,0,1,1,v[0],v[1],v[2],v[3],v[4],v[5]);
+			}
+			doNotOptimize(acc);
+		});
+		suite.run("interpolacionBilinealParanormal",n,[&](){
+			glm::vec3 acc(0.f);
+			for(int i=0;i<n;++i) {
+				const float *v = &in[i*6];
+				acc += interpolacionBilinealParanormal(0,0,1,1,v[0],v[1],v[2],v[3],v[4],v[5]);
+			}
+			doNotOptimize(acc);
+		});
+	}
+
+	// batched terrain queries over a map that fits in cache, per point
+	{
+		const int n = 4096;
+		ParametrosTerreno p; p.tamanioMapa = 256;
+		MuestreadorTerreno muestreador(createNoiseMap(p));
+		GeneradorTerreno generador(2);
+		std::vector<glm::vec2> points(n);
+		for(glm::vec2 &q : points) q = glm::vec2(aleatorio(generador)*2.f-1.f,aleatorio(generador)*2.f-1.f);
+		std::vector<float> heights(n), slopes(n);
+		std::vector<glm::vec3> normals(n);
+		suite.run("MuestreadorTerreno/heights",n,[&](){ muestreador.muestrear(points.data(),n,heights.data()); doNotOptimize(heights); });
+		suite.run("MuestreadorTerreno/normals",n,[&](){ muestreador.muestrear(points.data(),n,nullptr,normals.data()); doNotOptimize(normals); });
+		suite.run("MuestreadorTerreno/slopes",n,[&](){ muestreador.muestrear(points.data(),n,nullptr,nullptr,slopes.data()); doNotOptimize(slopes); });
+		suite.run("MuestreadorTerreno/altura",n,[&](){
+			for(int i=0;i<n;++i) heights[i] = muestreador.altura(points[i].x,points[i].y);
+			doNotOptimize(heights);
+		});
+	}
+
+	// bezier curves, per point
+	{
+		const int n = 4096;
+		std::vector<glm::vec3> out(n);
+		Bezier<glm::vec3,3> cubic{ {0,0,0}, {1,2,0}, {2,-1,1}, {3,0,0} };
+		Bezier<glm::vec3,7> curve7;
+		for(int i=0;i<=7;++i) curve7[i] = glm::vec3(i*0.3f,i%2?1.f:-1.f,i*i*0.1f);
+		suite.run("Bezier::at/degree=3",n,[&](){ for(int i=0;i<n;++i) out[i] = cubic.at(float(i)/(n-1)); doNotOptimize(out); });
+		suite.run("Bezier::at/degree=7",n,[&](){ for(int i=0;i<n;++i) out[i] = curve7.at(float(i)/(n-1)); doNotOptimize(out); });
+		suite.run("Bezier::sample/degree=3",n,[&](){ cubic.sample(out.data(),n); doNotOptimize(out); });
+		suite.run("Bezier::sample/degree=7",n,[&](){ curve7.sample(out.data(),n); doNotOptimize(out); });
+		std::vector<glm::vec3> strip;
+		auto flatness = [](const Bezier<glm::vec3,3> &c){ return c.flatness(); };
+		for(float tolerance : {1e-2f,1e-4f}) {
+			std::ostringstream name; name << "Bezier::tessellate/degree=3/tolerance=" << tolerance;
+			suite.run(name.str(),1,[&](){ strip.clear(); cubic.tessellate(strip,tolerance,flatness); doNotOptimize(strip); });
+		}
+	}
+
+	// carving a road and a river: the whole map, and only the blocks around a moved curve
+	{
+		ParametrosTerreno p; p.tamanioMapa = 256;
+		MapaDeRuido mapa = createNoiseMap(p);
+		Camino ruta, rio;
+		ruta.curva = { {-0.9f,0.f,-0.6f}, {-0.3f,0.f,0.4f}, {0.3f,0.f,-0.5f}, {0.9f,0.f,0.5f} };
+		rio.tipo = Camino::cRio;
+		rio.curva = { {-0.2f,-0.15f,-1.f}, {0.5f,-0.15f,-0.3f}, {-0.6f,-0.15f,0.3f}, {0.1f,-0.15f,1.f} };
+		TalladorDeCaminos tallador;
+		tallador.agregar(ruta); tallador.agregar(rio);
+		suite.run("TalladorDeCaminos/size=256/all",1,[&](){ tallador.setBase(p,mapa); doNotOptimize(tallador.aplicar()); });
+		Camino movido = rio;
+		int paso = 0;
+		suite.run("TalladorDeCaminos/size=256/move",1,[&](){
+			movido.curva[1].x = 0.5f-0.01f*(++paso%16);
+			tallador.mover(1,movido); doNotOptimize(tallador.aplicar());
+		});
+	}
+
+	// meshes (bundled in bin/models)
+	for(std::string name : {"malla16.16","mallaSlides","mallaRefinada","bush"}) {
+		std::string fname = "models/"+name+".obj";
+		if (getModificationTime(fname)<0) { std::cerr << "Skipping " << fname << " (run from the bin folder)" << std::endl; continue; }
+		ObjMesh obj;
+		{
+			QuietStderr quiet;
+			obj = readObj(fname);
+			suite.run("readObj/"+name,1,[&](){ doNotOptimize(readObj(fname)); });
+		}
+		suite.run("toGeometry/"+name,1,[&](){ doNotOptimize(toGeometry(obj)); });
+		Geometry geo = toGeometry(obj);
+		suite.run("generateNormals/"+name,1,[&](){ geo.generateNormals(); doNotOptimize(geo.normals); });
+		suite.run("generateNormals/"+name+"/angle",1,[&](){ geo.generateNormals(Geometry::nwAngle); doNotOptimize(geo.normals); });
+		std::vector<glm::vec3> positions;
+		suite.run("centerAndResize/"+name,1,[&](){
+			positions = obj.positions; // copying is part of the time, but it is much cheaper
+			centerAndResize(positions); doNotOptimize(positions);
+		});
+		if (name=="bush") continue; // not a terrain
+		centerAndResize(geo.positions);
+		ParametrosTerreno p;
+		MapaDeRuido mapa = createNoiseMap(p);
+		std::vector<glm::vec3> vertices, normales; std::vector<glm::vec2> coords;
+		suite.run("modifyMesh/"+name,1,[&](){
+			modifyMesh(p,geo.positions,vertices,normales,coords,mapa);
+			doNotOptimize(vertices);
+		});
+	}
+
+	if (not json.empty()) {
+		if (suite.writeJson(json,label)) std::cout << "Results saved to " << json << std::endl;
+		else { std::cerr << "Could not write " << json << std::endl; return 1; }
+	}
+	return 0;
+}
+
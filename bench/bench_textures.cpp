@@ -0,0 +1,47 @@
+// Decodes the same set of images with 1..N worker threads and reports the 
+// throughput of each run. Run it from the bin folder:
+//    bench_textures [count] [threads] [images...]
+// (defaults: 64 decodes of the images in models/, 1..hardware threads)
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+
+int main(int argc, char *argv[]) {
+	int count = argc>1 ? std::atoi(argv[1]) : 64;
+	int max_threads = argc>2 ? std::atoi(argv[2]) : int(std::thread::hardware_concurrency());
+	std::vector<std::string> images;
+	for(int i=3;i<argc;++i) images.push_back(argv[i]);
+	if (images.empty()) 
+		images = { "models/grass.jpg", "models/green.png", "models/elevation_gradient.png",
+				   "models/elevation_gradient_2.png", "models/elevation_gradient_3.png" };
+	
+	std::vector<std::string> fnames;
+	for(int i=0;i<count;++i) fnames.push_back(images[i%images.size()]);
+	
+	size_t pixels = 0;
+	for(const Image &img : loadImages(images)) // warm up the file cache
+		pixels += size_t(img.width)*img.height;
+	std::cout << count << " decodes of " << images.size() << " images (" 
+			  << pixels/images.size() << " pixels per image on average)" << std::endl;
+	
+	std::cout << "threads     seconds   images/s   speedup" << std::endl;
+	double t1 = 0;
+	for(int nthreads=1;nthreads<=std::max(1,max_threads);++nthreads) {
+		ThreadPool pool(nthreads);
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<Image> decoded = loadImages(fnames,true,&pool);
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+		if (nthreads==1) t1 = t;
+		std::cout << std::setw(7) << nthreads << std::fixed << std::setprecision(4)
+				  << std::setw(12) << t << std::setprecision(1) << std::setw(11) << count/t
+				  << std::setprecision(2) << std::setw(10) << t1/t << std::endl;
+	}
+	return 0;
+}
+
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# Compares two json reports from bench_terreno (e.g. before and after a change):
+#    compare_bench.py base.json new.json [--alpha 0.01] [--threshold 2] [--fail-on-regression]
+# For every benchmark in both files it runs Welch's t-test on the samples and
+# prints the change of the median. A change is reported as faster/slower only if
+# it is statistically significant (p < alpha) *and* bigger than threshold %,
+# everything else is noise. Only the standard library is needed.
+import argparse
+import json
+import math
+import sys
+
+
+def betacf(a, b, x):
+	# continued fraction for the incomplete beta function (Numerical Recipes)
+	tiny = 1e-300
+	qab, qap, qam = a+b, a+1.0, a-1.0
+	c, d = 1.0, 1.0-qab*x/qap
+	d = 1.0/(d if abs(d)>tiny else tiny)
+	h = d
+	for m in range(1, 300):
+		m2 = 2*m
+		aa = m*(b-m)*x/((qam+m2)*(a+m2))
+		d = 1.0+aa*d; d = 1.0/(d if abs(d)>tiny else tiny)
+		c = 1.0+aa/c; c = c if abs(c)>tiny else tiny
+		h *= d*c
+		aa = -(a+m)*(qab+m)*x/((a+m2)*(qap+m2))
+		d = 1.0+aa*d; d = 1.0/(d if abs(d)>tiny else tiny)
+		c = 1.0+aa/c; c = c if abs(c)>tiny else tiny
+		delta = d*c
+		h *= delta
+		if abs(delta-1.0)<1e-12:
+			break
+	return h
+
+
+def betainc(a, b, x):
+	# regularized incomplete beta I_x(a,b)
+	if x<=0.0: return 0.0
+	if x>=1.0: return 1.0
+	lbeta = math.lgamma(a+b)-math.lgamma(a)-math.lgamma(b)
+	front = math.exp(lbeta+a*math.log(x)+b*math.log(1.0-x))
+	if x<(a+1.0)/(a+b+2.0):
+		return front*betacf(a, b, x)/a
+	return 1.0-front*betacf(b, a, 1.0-x)/b
+
+
+def welch(x, y):
+	# two sided p-value of Welch's t-test (unequal variances)
+	nx, ny = len(x), len(y)
+	mx, my = sum(x)/nx, sum(y)/ny
+	vx = sum((v-mx)**2 for v in x)/(nx-1)
+	vy = sum((v-my)**2 for v in y)/(ny-1)
+	se2 = vx/nx+vy/ny
+	if se2==0.0:
+		return 0.0 if mx!=my else 1.0
+	t = (my-mx)/math.sqrt(se2)
+	df = se2**2/((vx/nx)**2/(nx-1)+(vy/ny)**2/(ny-1))
+	return betainc(df/2.0, 0.5, df/(df+t*t))
+
+
+def median(v):
+	s = sorted(v); n = len(s)
+	return s[n//2] if n%2 else (s[n//2-1]+s[n//2])/2.0
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Compares two bench_terreno json reports')
+	parser.add_argument('base')
+	parser.add_argument('new')
+	parser.add_argument('--alpha', type=float, default=0.01, help='significance level')
+	parser.add_argument('--threshold', type=float, default=2.0, help='minimum change to report, in %%')
+	parser.add_argument('--fail-on-regression', action='store_true', help='exit with 1 if something got slower')
+	args = parser.parse_args()
+
+	with open(args.base) as f: base = json.load(f)
+	with open(args.new) as f: new = json.load(f)
+	new_by_name = {b['name']: b for b in new['benchmarks']}
+
+	print('base: %s (%s)' % (base.get('label') or args.base, base.get('date', '?')))
+	print('new:  %s (%s)' % (new.get('label') or args.new, new.get('date', '?')))
+	print('%-48s %14s %14s %9s %9s  %s' % ('benchmark', 'base ns', 'new ns', 'change', 'p', ''))
+	regressions = 0
+	for b in base['benchmarks']:
+		n = new_by_name.get(b['name'])
+		if n is None:
+			continue
+		x, y = b['samples'], n['samples']
+		mb, mn = median(x), median(y)
+		change = 100.0*(mn-mb)/mb if mb>0 else 0.0
+		p = welch(x, y) if len(x)>1 and len(y)>1 else 1.0
+		verdict = ''
+		if p<args.alpha and abs(change)>=args.threshold:
+			verdict = 'slower' if change>0 else 'faster'
+			regressions += change>0
+		print('%-48s %14.1f %14.1f %+8.1f%% %9.2g  %s' % (b['name'], mb, mn, change, p, verdict))
+	missing = [b['name'] for b in new['benchmarks'] if b['name'] not in {x['name'] for x in base['benchmarks']}]
+	if missing:
+		print('only in new: ' + ', '.join(missing))
+	if args.fail_on_regression and regressions:
+		sys.exit(1)
+
+
+if __name__=='__main__':
+	main()
@@ -0,0 +1,199 @@
+// Regression harness for terrain generation: runs the generator over a matrix of
+// parameters and checks every stage's output (noise map, vertices, normals,
+// texture coordinates, bushes' matrices) against the golden checksums in
+// golden_terreno.txt, so terrains shipped by seed stay reproducible. It also
+// times each case (best of 3), so it can be used as a performance gate too.
+// Run it from the bin folder:
+//    regresion_terreno [--bless] [--golden file] [--mesh obj] [--tolerance rel] [--perf factor]
+// --bless        rewrites the golden file with the current results
+// --tolerance    a stage whose hash differs still passes if its count is the same and
+//                its sum, sum of abs, min and max are within this relative error
+//                (for rewrites that only reassociate float operations)
+// --perf         fails the cases that take more than factor times the golden time
+// Exact hashes depend on the compiler, glm version and float flags (e.g. fma or
+// fast-math), and times on the machine: bless on the reference build.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ObjMesh.hpp"
+#include "Misc.hpp"
+#include "Terreno.hpp"
+
+// checksum of a stage: exact hash of the bits, plus a few statistics for the
+// tolerance mode
+struct Checksum {
+	uint64_t hash = 14695981039346656037ull; // fnv-1a 64
+	long long count = 0;
+	double sum = 0, sum_abs = 0, min = 0, max = 0;
+
+	void add(float v) {
+		if (v==0.f) v = 0.f; // -0 == +0
+		uint32_t bits;
+		if (v!=v) bits = 0x7fc00000u; // any nan is the same nan
+		else std::memcpy(&bits,&v,4);
+		for(int i=0;i<4;++i) hash = (hash^((bits>>(8*i))&0xff))*1099511628211ull;
+		if (count==0) min = max = v;
+		min = std::min<double>(min,v); max = std::max<double>(max,v);
+		sum += v; sum_abs += std::fabs(v);
+		++count;
+	}
+	template<typename V> void addAll(const V &v) { for(int i=0;i<v.length();++i) add(v[i]); }
+
+	bool closeTo(const Checksum &o, double tolerance) const {
+		auto close = [&](double a, double b) { return std::fabs(a-b)<=tolerance*std::max(1.0,std::max(std::fabs(a),std::fabs(b))); };
+		return count==o.count and close(sum,o.sum) and close(sum_abs,o.sum_abs) and close(min,o.min) and close(max,o.max);
+	}
+};
+
+std::ostream &operator<<(std::ostream &out, const Checksum &c) {
+	return out << std::hex << std::setw(16) << std::setfill('0') << c.hash << std::dec << std::setfill(' ') << " " << c.count
+		<< std::setprecision(17) << " " << c.sum << " " << c.sum_abs << " " << c.min << " " << c.max;
+}
+
+std::istream &operator>>(std::istream &in, Checksum &c) {
+	return in >> std::hex >> c.hash >> std::dec >> c.count >> c.sum >> c.sum_abs >> c.min >> c.max;
+}
+
+const char *stage_names[] = { "noise", "vertices", "normals", "texcoords", "bushes" };
+const int stages_count = 5;
+
+struct CaseResult {
+	Checksum stages[stages_count];
+	double ms = 0;
+};
+
+static std::string caseName(const ParametrosTerreno &p) {
+	std::ostringstream ss;
+	ss << "seed=" << p.seed << ",size=" << p.tamanioMapa << ",octaves=" << p.numeroDeOctavas << ",freq=" << p.freq
+	   << ",amp=" << p.amp << ",persistency=" << p.persistency << ",lacunarity=" << p.lacunarity;
+	return ss.str();
+}
+
+// same steps as the interactive program (Escena::regenerarTerreno)
+static CaseResult runCase(const ParametrosTerreno &p, const std::vector<glm::vec3> &plane) {
+	CaseResult r;
+	r.ms = 1e30;
+	std::vector<glm::vec3> vertices, normals; std::vector<glm::vec2> coords;
+	std::vector<glm::mat4> bushes(20);
+	MapaDeRuido noise;
+	for(int rep=0;rep<3;++rep) {
+		auto t0 = std::chrono::steady_clock::now();
+		noise = createNoiseMap(p);
+		modifyMesh(p,plane,vertices,normals,coords,noise);
+		ubicarYuyos(p,noise,bushes);
+		r.ms = std::min(r.ms,std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-t0).count());
+	}
+	for(const FilaDeRuido &row : noise) for(float v : row) r.stages[0].add(v);
+	for(const glm::vec3 &v : vertices) r.stages[1].addAll(v);
+	for(const glm::vec3 &v : normals) r.stages[2].addAll(v);
+	for(const glm::vec2 &v : coords) r.stages[3].addAll(v);
+	for(const glm::mat4 &m : bushes) for(int i=0;i<4;++i) r.stages[4].addAll(m[i]);
+	return r;
+}
+
+int main(int argc, char *argv[]) {
+	std::string golden_fname = "../bench/golden_terreno.txt", mesh_fname = "models/mallaRefinada.obj";
+	bool bless = false;
+	double tolerance = -1, perf = -1;
+	for(int i=1;i<argc;++i) {
+		std::string opt = argv[i];
+		if (opt=="--bless") { bless = true; continue; }
+		if (i+1>=argc) { std::cerr << "Missing value for " << opt << std::endl; return 2; }
+		std::string val = argv[++i];
+		if (opt=="--golden") golden_fname = val;
+		else if (opt=="--mesh") mesh_fname = val;
+		else if (opt=="--tolerance") tolerance = std::atof(val.c_str());
+		else if (opt=="--perf") perf = std::atof(val.c_str());
+		else { std::cerr << "Unknown option " << opt << std::endl; return 2; }
+	}
+
+	// the plane as Model::load leaves it (fitted to [-1,1])
+	if (getModificationTime(mesh_fname)<0) { std::cerr << "Missing " << mesh_fname << " (run from the bin folder)" << std::endl; return 2; }
+	ObjMesh obj = readObj(mesh_fname);
+	centerAndResize(obj.positions);
+	std::vector<glm::vec3> plane = toGeometry(obj).positions;
+
+	std::vector<ParametrosTerreno> cases;
+	for(int seed : {0,7,12345}) for(int size : {16,64,128}) for(int octaves : {1,3,8}) for(int freq : {1,3})
+	for(int amp : {1,2}) for(float persistency : {2.f,2.5f}) for(float lacunarity : {0.5f,0.35f}) {
+		ParametrosTerreno p;
+		p.seed = seed; p.tamanioMapa = size; p.numeroDeOctavas = octaves; p.freq = freq; p.amp = amp;
+		p.persistency = persistency; p.lacunarity = lacunarity;
+		cases.push_back(p);
+	}
+
+	std::map<std::string,CaseResult> golden;
+	if (not bless) {
+		std::ifstream file(golden_fname);
+		if (not file.is_open()) { std::cerr << "Could not read " << golden_fname << " (create it with --bless)" << std::endl; return 2; }
+		for(std::string line; std::getline(file,line); ) {
+			fixEOL(line);
+			if (line.empty() or line[0]=='#') continue;
+			std::istringstream ss(line);
+			std::string name, stage;
+			ss >> name >> stage;
+			CaseResult &r = golden[name];
+			if (stage=="ms") { ss >> r.ms; continue; }
+			auto it = std::find(stage_names,stage_names+stages_count,stage);
+			if (it==stage_names+stages_count or not (ss >> r.stages[it-stage_names])) {
+				std::cerr << golden_fname << ": invalid line: " << line << std::endl; return 2;
+			}
+		}
+	}
+
+	std::ostringstream out;
+	out << "# golden checksums for regresion_terreno (hash count sum sum_abs min max), regenerate with --bless\n";
+	int exact = 0, tolerated = 0, failed = 0, slower = 0, missing = 0;
+	double total_ms = 0, golden_ms = 0;
+	for(const ParametrosTerreno &p : cases) {
+		std::string name = caseName(p);
+		CaseResult r = runCase(p,plane);
+		total_ms += r.ms;
+		for(int s=0;s<stages_count;++s) out << name << " " << stage_names[s] << " " << r.stages[s] << "\n";
+		out << name << " ms " << std::fixed << std::setprecision(3) << r.ms << std::defaultfloat << "\n";
+		if (bless) continue;
+
+		auto it = golden.find(name);
+		if (it==golden.end()) { std::cout << "MISSING " << name << std::endl; ++missing; continue; }
+		const CaseResult &g = it->second;
+		golden_ms += g.ms;
+		bool all_exact = true, ok = true;
+		for(int s=0;s<stages_count;++s) {
+			if (r.stages[s].hash==g.stages[s].hash and r.stages[s].count==g.stages[s].count) continue;
+			all_exact = false;
+			if (tolerance>=0 and r.stages[s].closeTo(g.stages[s],tolerance)) continue;
+			ok = false;
+			std::cout << "FAILED  " << name << " " << stage_names[s] << "\n    expected " << g.stages[s]
+					  << "\n    got      " << r.stages[s] << std::endl;
+		}
+		if (not ok) ++failed; else if (all_exact) ++exact; else ++tolerated;
+		if (perf>0 and r.ms>perf*g.ms+0.5) { // +0.5ms, tiny cases are all noise
+			std::cout << "SLOWER  " << name << ": " << r.ms << " ms, golden " << g.ms << " ms" << std::endl;
+			++slower;
+		}
+	}
+
+	if (bless) {
+		std::ofstream file(golden_fname);
+		file << out.str();
+		if (not file.good()) { std::cerr << "Could not write " << golden_fname << std::endl; return 2; }
+		std::cout << cases.size() << " cases written to " << golden_fname << " (" << total_ms << " ms)" << std::endl;
+		return 0;
+	}
+	std::cout << cases.size() << " cases: " << exact << " exact, " << tolerated << " within tolerance, "
+			  << failed << " failed, " << missing << " missing";
+	if (perf>0) std::cout << ", " << slower << " slower than " << perf << "x";
+	std::cout << std::fixed << std::setprecision(1) << "\ntime: " << total_ms << " ms (golden " << golden_ms << " ms)" << std::endl;
+	return failed or missing or slower ? 1 : 0;
+}
+
@@ -0,0 +1,14 @@
+// bloques compartidos por todos los programas (ver common/utils/UniformBlocks.hpp),
+// se actualizan una vez por cuadro
+
+layout(std140) uniform Camera {
+	mat4 viewMatrix;
+	mat4 projectionMatrix;
+};
+
+layout(std140) uniform Lights {
+	vec4 lightPosition;
+	vec4 lightVSPosition; // ya en el espacio de la vista
+	vec3 lightColor;
+	float ambientStrength;
+};
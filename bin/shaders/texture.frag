@@ -3,7 +3,6 @@
 in vec3 fragNormal;
 in vec3 fragPosition;
 in vec2 fragTexCoords;
-in vec4 lightVSPosition;
 
 // propiedades del material
 uniform sampler2D colorTexture;
@@ -14,9 +13,8 @@ uniform vec3 emissionColor;
 uniform float opacity;
 uniform float shininess;
 
-// propiedades de la luz
-uniform float ambientStrength;
-uniform vec3 lightColor;
+// propiedades de la luz y la camara
+#include "funcs/uniformBlocks.glsl"
 
 out vec4 fragColor;
 
@@ -4,22 +4,33 @@ in vec3 vertexPosition;
 in vec3 vertexNormal;
 in vec2 vertexTexCoords;
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform vec4 lightPosition;
+#include "funcs/uniformBlocks.glsl"
+
+// calculadas una vez por dibujo (Shader::setModelMatrix), no por vertice
+uniform mat4 modelViewMatrix;
+uniform mat4 mvpMatrix;
+uniform mat3 normalMatrix;
+
+#ifdef INSTANCED
+// una por instancia (InstanceBuffer), se aplican antes que las de arriba
+in mat4 instanceMatrix;
+in mat3 instanceNormalMatrix;
+#endif
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec2 fragTexCoords;
-out vec4 lightVSPosition;
 
 void main() {
-	mat4 vm = viewMatrix * modelMatrix;
-	vec4 vmp = vm * vec4(vertexPosition,1.f);
+#ifdef INSTANCED
+	vec4 vmp = modelViewMatrix * (instanceMatrix * vec4(vertexPosition,1.f));
 	gl_Position = projectionMatrix * vmp;
+	fragNormal = normalMatrix * (instanceNormalMatrix * vertexNormal);
+#else
+	vec4 vmp = modelViewMatrix * vec4(vertexPosition,1.f);
+	gl_Position = mvpMatrix * vec4(vertexPosition,1.f);
+	fragNormal = normalMatrix * vertexNormal;
+#endif
 	fragPosition = vec3(vmp);
-	fragNormal = mat3(transpose(inverse(vm))) * vertexNormal;
-	lightVSPosition = viewMatrix * lightPosition;
 	fragTexCoords = vertexTexCoords;
 }
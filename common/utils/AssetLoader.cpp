@@ -0,0 +1,110 @@
+#include <chrono>
+#include "AssetLoader.hpp"
+#include "Window.hpp"
+#include "TextureData.hpp"
+
+AssetLoader::AssetLoader(ThreadPool &pool) : pool(pool) {
+	
+}
+
+AssetLoader::~AssetLoader() {
+	// decodes still running would queue their uploads into a destroyed loader
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		decoded_cv.wait(lock,[this](){ return decoding==0; });
+	}
+	*alive = false; // uploads left in the pool's main thread queue do nothing
+	if (upload_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopping = true;
+		}
+		shared_cv.notify_all();
+		upload_thread.join();
+	}
+	upload_window.reset();
+}
+
+void AssetLoader::enableSharedContext(Window &main_window) {
+	cg_assert(!upload_window,"Shared context already enabled");
+	upload_window.reset(new Window(1,1,"uploads",Window::fHidden,main_window));
+	glfwMakeContextCurrent(main_window); // the new window took over the current context
+	upload_thread = std::thread([this](){ uploadThreadLoop(); });
+}
+
+AssetHandle<std::vector<Model>> AssetLoader::loadModels(const std::string &name, int flags) {
+	return request<std::vector<Model>,std::vector<ModelData>>(
+		[name,flags](){ return Model::loadData(name,flags); },
+		[flags](std::vector<ModelData> &vdata, std::vector<Model> &models){
+			models.reserve(vdata.size());
+			for(ModelData &data : vdata)
+				models.emplace_back(std::move(data),flags&Model::fKeepGeometry);
+		}, false ); // vaos can not be shared between contexts
+}
+
+AssetHandle<Model> AssetLoader::loadModel(const std::string &name, int flags) {
+	return request<Model,ModelData>(
+		[name,flags](){ return Model::loadDataSingle(name,flags); },
+		[flags](ModelData &data, Model &model){
+			model = Model(std::move(data),flags&Model::fKeepGeometry);
+		}, false );
+}
+
+AssetHandle<Texture> AssetLoader::loadTexture(const std::string &fname, bool repeat_s, bool repeat_t) {
+	return request<Texture,TextureData>(
+		[fname](){ return loadTextureCached(fname); },
+		[repeat_s,repeat_t](TextureData &data, Texture &texture){
+			texture = Texture(data,repeat_s,repeat_t);
+		}, true );
+}
+
+void AssetLoader::queueUpload(Upload upload, bool shareable) {
+	std::lock_guard<std::mutex> lock(mtx);
+	if (shareable and upload_thread.joinable()) {
+		shared_queue.push_back(std::move(upload));
+		shared_cv.notify_one();
+	} else {
+		std::shared_ptr<bool> alive = this->alive;
+		main_uploads.push_back(pool.submitToMainThread([alive,upload](){ if (*alive) upload(false); }));
+	}
+}
+
+int AssetLoader::processUploads(double budget_seconds) {
+	int count = pool.runMainThreadTasks(budget_seconds);
+	// uploads run in the order they were queued
+	while(true) {
+		std::future<void> done;
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (main_uploads.empty() or main_uploads.front().wait_for(std::chrono::seconds(0))!=std::future_status::ready) break;
+			done = std::move(main_uploads.front());
+			main_uploads.pop_front();
+		}
+		done.get();
+	}
+	return count;
+}
+
+void AssetLoader::finishAll() {
+	while(not idle()) {
+		if (processUploads(1.0)==0)
+			std::this_thread::yield();
+	}
+}
+
+void AssetLoader::uploadThreadLoop() {
+	glfwMakeContextCurrent(*upload_window);
+	while(true) {
+		Upload upload;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			shared_cv.wait(lock,[this](){ return stopping or not shared_queue.empty(); });
+			if (stopping) break;
+			upload = std::move(shared_queue.front());
+			shared_queue.pop_front();
+		}
+		upload(true);
+	}
+	glfwMakeContextCurrent(nullptr);
+}
+
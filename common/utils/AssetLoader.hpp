@@ -0,0 +1,116 @@
+#ifndef ASSETLOADER_HPP
+#define ASSETLOADER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Debug.hpp"
+#include "Model.hpp"
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+
+class Window;
+
+// an asset being loaded by an AssetLoader; get() is valid once ready() returns true
+template<typename T>
+class Asset {
+public:
+	bool ready() const { return is_ready.load(); }
+	T &get() { cg_assert(ready(),"Asset not loaded yet"); return value; }
+private:
+	friend class AssetLoader;
+	T value;
+	std::atomic<bool> is_ready{false};
+};
+
+template<typename T>
+using AssetHandle = std::shared_ptr<Asset<T>>;
+
+// Parses and decodes assets on worker threads, then queues the gl uploads. 
+// Uploads are main thread tasks of the pool (see ThreadPool::submitToMainThread)
+// and run within processUploads (under a time budget), or, for objects that can be shared between contexts (textures), on an upload 
+// thread with its own context if enableSharedContext was called.
+class AssetLoader {
+public:
+	AssetLoader(ThreadPool &pool = ThreadPool::shared());
+	~AssetLoader();
+	
+	AssetLoader(const AssetLoader &other) = delete;
+	AssetLoader &operator=(const AssetLoader &other) = delete;
+	
+	// creates a hidden window sharing main_window's context, must be called from the main thread
+	void enableSharedContext(Window &main_window);
+	
+	AssetHandle<std::vector<Model>> loadModels(const std::string &name, int flags=0);
+	AssetHandle<Model> loadModel(const std::string &name, int flags=0);
+	AssetHandle<Texture> loadTexture(const std::string &fname, bool repeat_s=true, bool repeat_t=true);
+	
+	// runs the pool's main thread tasks (these uploads and any other) until budget 
+	// is exhausted (at least one), returns how many were run; meant to be called 
+	// once per frame, rethrows the error of a request that failed
+	int processUploads(double budget_seconds);
+	// blocks until every requested asset is ready
+	void finishAll();
+	
+	int pending() const { return pending_count.load(); }
+	bool idle() const { return pending()==0; }
+	
+private:
+	// gl part of a request, receives true if running on the shared context
+	using Upload = std::function<void(bool)>;
+	template<typename T, typename Data>
+	AssetHandle<T> request(std::function<Data()> decode, std::function<void(Data&,T&)> upload, bool shareable);
+	void queueUpload(Upload upload, bool shareable);
+	void uploadThreadLoop();
+	
+	ThreadPool &pool;
+	std::atomic<int> pending_count{0};
+	std::mutex mtx;
+	std::deque<Upload> shared_queue;
+	std::deque<std::future<void>> main_uploads; // in the pool's main thread queue
+	std::shared_ptr<bool> alive = std::make_shared<bool>(true); // for those, main thread only
+	std::condition_variable shared_cv;
+	int decoding = 0; // tasks in the pool that still use this (guarded by mtx)
+	std::condition_variable decoded_cv;
+	std::unique_ptr<Window> upload_window;
+	std::thread upload_thread;
+	bool stopping = false;
+};
+
+template<typename T, typename Data>
+AssetHandle<T> AssetLoader::request(std::function<Data()> decode, std::function<void(Data&,T&)> upload, bool shareable) {
+	auto asset = std::make_shared<Asset<T>>();
+	++pending_count;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		++decoding;
+	}
+	pool.submit([this,asset,decode,upload,shareable](){
+		auto data = std::make_shared<Data>();
+		std::exception_ptr error;
+		try { *data = decode(); } 
+		catch(...) { error = std::current_exception(); }
+		queueUpload([this,asset,data,error,upload](bool on_shared_context){
+			if (error) { --pending_count; std::rethrow_exception(error); }
+			upload(*data,asset->value);
+			if (on_shared_context) glFinish(); // make sure the object is complete before other contexts use it
+			asset->is_ready = true;
+			--pending_count;
+		}, shareable and (not error));
+		std::lock_guard<std::mutex> lock(mtx); // the destructor waits for this
+		--decoding;
+		decoded_cv.notify_all();
+	});
+	return asset;
+}
+
+#endif
+
@@ -2,13 +2,25 @@
 #define BEZIER_HPP
 #include <initializer_list>
 #include <iterator>
+#include <vector>
 #include <glm/glm.hpp>
 #include "Debug.hpp"
 
+// de Casteljau's triangle, levels [D,D-L): q has D+1 points, and q[0..D-L] end 
+// up being the points of that level (L=D gives the point on the curve). O(D^2) 
+// lerps, the loops have constant bounds so the compiler can unroll them.
 template<typename VEC, int D> 
 struct DecastImpl {
+	static void reduce(VEC q[], float t, int levels=D) {
+		for(int k=D;k>D-levels;--k)
+			for(int i=0;i<k;++i)
+				q[i] = q[i]*(1-t) + q[i+1]*t;
+	}
 	static VEC eval(const VEC p[], float t) {
-		return DecastImpl<VEC,D-1>::eval(p,t)*(1-t) + DecastImpl<VEC,D-1>::eval(p+1,t)*t;
+		VEC q[D+1];
+		for(int i=0;i<=D;++i) q[i] = p[i];
+		reduce(q,t);
+		return q[0];
 	}
 };
 
@@ -22,6 +34,20 @@ VEC Decast(const VEC p[], float t) {
 	return DecastImpl<VEC,D>::eval(p,t);
 }
 
+// distance from p to the segment ab
+template<typename VEC>
+float distanceToSegment(const VEC &p, const VEC &a, const VEC &b) {
+	VEC ab = b-a;
+	float len2 = glm::dot(ab,ab);
+	float t = len2>0.f ? glm::dot(p-a,ab)/len2 : 0.f;
+	t = t<0.f ? 0.f : (t>1.f ? 1.f : t);
+	return glm::length(p-(a+ab*t));
+}
+
+constexpr float binomialCoefficient(int n, int k) {
+	return k==0 or k==n ? 1.f : binomialCoefficient(n-1,k-1)+binomialCoefficient(n-1,k);
+}
+
 template<typename VEC=glm::vec3, int DEGREE=3>
 class Bezier {
 	VEC p[DEGREE+1];
@@ -38,14 +64,106 @@ public:
 		return Decast<VEC,DEGREE>(p,t);
 	}
 	VEC at(float t, VEC &deriv) const {
-		VEC x[2] = { Decast<VEC,DEGREE-1>(p,t), Decast<VEC,DEGREE-1>(p+1,t) };
-		deriv = (x[1]-x[0])*float(DEGREE);
-		return Decast<VEC,1>(x,t);
+		VEC q[DEGREE+1];
+		for(int i=0;i<=DEGREE;++i) q[i] = p[i];
+		DecastImpl<VEC,DEGREE>::reduce(q,t,DEGREE-1); // the last level's two points
+		deriv = (q[1]-q[0])*float(DEGREE);
+		return Decast<VEC,1>(q,t);
 	}
+	
+	// n points at uniform t in [t0,t1] (n>1), same as at() up to rounding. Uses the
+	// Bernstein form (non-negative weights, as stable as de Casteljau but O(D) per 
+	// point), a block of t values at a time so the inner loops can be vectorized.
+	// Forward differencing would be cheaper, but its error grows as n^D.
+	void sample(VEC out[], int n, float t0=0.f, float t1=1.f) const;
+	
+	// de Casteljau split at t: left is [0,t] of this curve and right is [t,1]
+	void split(float t, Bezier &left, Bezier &right) const;
+	
+	// Upper bound of the distance between the curve and its chord (by the convex 
+	// hull property, that of the farthest control point). 0 for a line.
+	float flatness() const;
+	
+	// Adaptive tessellation for a line strip: appends the first point and then the
+	// end of every piece, splitting pieces in halves until error(piece)<=tolerance
+	// or max_depth levels (2^max_depth segments at most). error(const Bezier&) can 
+	// be flatness() itself, or measure it after projecting the control points to 
+	// pixels. Flat stretches take one segment, tight bends as many as they need.
+	template<typename Error>
+	void tessellate(std::vector<VEC> &out, float tolerance, const Error &error, int max_depth=10) const;
 	int degree() const { return DEGREE; }
 	VEC *data() { return p; }
 	const VEC *data() const { return p; }
 	const int size() const { return DEGREE+1; }
+private:
+	template<typename Error>
+	void tessellatePiece(std::vector<VEC> &out, float tolerance, const Error &error, int depth) const;
 };
 
+template<typename VEC, int DEGREE>
+void Bezier<VEC,DEGREE>::split(float t, Bezier &left, Bezier &right) const {
+	VEC q[DEGREE+1];
+	for(int i=0;i<=DEGREE;++i) q[i] = p[i];
+	// the first point of every level of the triangle goes to left, the last one to right
+	for(int k=DEGREE;k>=0;--k) {
+		left.p[DEGREE-k] = q[0];
+		right.p[k] = q[k];
+		for(int i=0;i<k;++i) q[i] = q[i]*(1-t) + q[i+1]*t;
+	}
+}
+
+template<typename VEC, int DEGREE>
+float Bezier<VEC,DEGREE>::flatness() const {
+	float d = 0.f;
+	for(int i=1;i<DEGREE;++i) {
+		float di = distanceToSegment(p[i],p[0],p[DEGREE]);
+		if (di>d) d = di;
+	}
+	return d;
+}
+
+template<typename VEC, int DEGREE>
+template<typename Error>
+void Bezier<VEC,DEGREE>::tessellate(std::vector<VEC> &out, float tolerance, const Error &error, int max_depth) const {
+	out.push_back(p[0]);
+	tessellatePiece(out,tolerance,error,max_depth);
+}
+
+template<typename VEC, int DEGREE>
+template<typename Error>
+void Bezier<VEC,DEGREE>::tessellatePiece(std::vector<VEC> &out, float tolerance, const Error &error, int depth) const {
+	if (depth==0 or error(*this)<=tolerance) { out.push_back(p[DEGREE]); return; }
+	Bezier left, right;
+	split(0.5f,left,right);
+	left.tessellatePiece(out,tolerance,error,depth-1);
+	right.tessellatePiece(out,tolerance,error,depth-1);
+}
+
+template<typename VEC, int DEGREE>
+void Bezier<VEC,DEGREE>::sample(VEC out[], int n, float t0, float t1) const {
+	constexpr int B = 8, C = VEC::length();
+	float binom[DEGREE+1];
+	for(int k=0;k<=DEGREE;++k) binom[k] = binomialCoefficient(DEGREE,k);
+	float dt = n>1 ? (t1-t0)/(n-1) : 0.f;
+	for(int first=0;first<n;first+=B) {
+		int count = n-first<B ? n-first : B;
+		// weights w[k][j] = binom(D,k) * t^k * (1-t)^(D-k) for the j-th t of the block
+		float t[B], s[B], tk[DEGREE+1][B], sk[DEGREE+1][B], w[DEGREE+1][B];
+		for(int j=0;j<B;++j) { 
+			t[j] = j==count-1 and first+j==n-1 ? t1 : t0+dt*(first+j); // exact end point
+			s[j] = 1.f-t[j]; tk[0][j] = sk[0][j] = 1.f; 
+		}
+		for(int k=1;k<=DEGREE;++k)
+			for(int j=0;j<B;++j) { tk[k][j] = tk[k-1][j]*t[j]; sk[k][j] = sk[k-1][j]*s[j]; }
+		for(int k=0;k<=DEGREE;++k)
+			for(int j=0;j<B;++j) w[k][j] = binom[k]*tk[k][j]*sk[DEGREE-k][j];
+		float acc[C][B] = {};
+		for(int k=0;k<=DEGREE;++k)
+			for(int c=0;c<C;++c)
+				for(int j=0;j<B;++j) acc[c][j] += w[k][j]*p[k][c];
+		for(int j=0;j<count;++j)
+			for(int c=0;c<C;++c) out[first+j][c] = acc[c][j];
+	}
+}
+
 #endif
@@ -1,22 +1,21 @@
+#include <algorithm>
 #include "BezierRenderer.hpp"
 #include "Debug.hpp"
+#include "GLState.hpp"
 
-BezierRenderer::BezierRenderer(int nsamples) : shader("shaders/curve") { 
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-	
-	v_curve.resize(nsamples);
+BezierRenderer::BezierRenderer(int max_depth) : shader("shaders/curve"), max_depth(max_depth) {
+	glGenVertexArrays(2, VAO);
 	v_poly.resize(4);
 	glGenBuffers(2, VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-	glBufferData(GL_ARRAY_BUFFER, v_curve.size() * sizeof(glm::vec3), v_curve.data(), GL_DYNAMIC_DRAW);  
 	glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-	glBufferData(GL_ARRAY_BUFFER, 4*sizeof(glm::vec3), v_poly.data(), GL_DYNAMIC_DRAW);  
+	glBufferData(GL_ARRAY_BUFFER, 4*sizeof(glm::vec3), v_poly.data(), GL_DYNAMIC_DRAW);
+	mem.set(4*sizeof(glm::vec3));
 }
 
 BezierRenderer::~BezierRenderer() {
 	glDeleteBuffers(2,VBO);
-	glDeleteVertexArrays(1,&VAO);
+	for(GLuint vao : VAO) GLState::current().forgetVertexArray(vao);
+	glDeleteVertexArrays(2,VAO);
 }
 
 Shader &BezierRenderer::getShader() {
@@ -24,28 +23,56 @@ Shader &BezierRenderer::getShader() {
 	return shader;
 }
 
-void BezierRenderer::drawPoly(bool full) {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[1]);
-	GLint loc_pos = glGetAttribLocation(shader.getProgramId(), "vertexPosition"); 
+void BezierRenderer::setScreen(const glm::mat4 &mvp, const glm::vec2 &viewport, float pixels) {
+	screen_space = true;
+	screen_error.mvp = mvp;
+	screen_error.half_viewport = viewport*0.5f;
+	tolerance = pixels;
+}
+
+void BezierRenderer::setTolerance(float tolerance) {
+	screen_space = false;
+	this->tolerance = tolerance;
+}
+
+void BezierRenderer::begin() {
+	v_curve.clear();
+	firsts.clear();
+	counts.clear();
+}
+
+void BezierRenderer::end() {
+	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
+	// orphans the old storage every time, so a draw still using it doesn't stall this
+	curve_capacity = std::max(v_curve.size(),curve_capacity);
+	glBufferData(GL_ARRAY_BUFFER, curve_capacity * sizeof(glm::vec3), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, v_curve.size() * sizeof(glm::vec3), v_curve.data());
+	mem.set((curve_capacity+v_poly.size())*sizeof(glm::vec3));
+}
+
+void BezierRenderer::bindVertexArray(int i) {
+	GLState::current().bindVertexArray(VAO[i]);
+	if (attribs_serial[i]==shader.getSerial()) return;
+	attribs_serial[i] = shader.getSerial();
+	glBindBuffer(GL_ARRAY_BUFFER,VBO[i]);
+	GLint loc_pos = shader.attribLocation(cg_name("vertexPosition"));
 	cg_assert(loc_pos!=-1,"Shader does not have vertexPosition attribute");
 	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(loc_pos);
-	shader.setUniform("color",color_poly);
+}
+
+void BezierRenderer::drawPoly(bool full) {
+	bindVertexArray(1);
+	GLint loc_color = shader.uniformLocation(cg_name("color"));
+	shader.setUniform(loc_color,color_poly);
 	glDrawArrays(full?GL_LINE_STRIP:GL_LINES, 0,v_poly.size());
-	shader.setUniform("color",color_points);
+	shader.setUniform(loc_color,color_points);
 	glDrawArrays(GL_POINTS, 0,v_poly.size());
-	glBindVertexArray(0);
 }
 
-void BezierRenderer::drawCurve() {
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
-	GLint loc_pos = glGetAttribLocation(shader.getProgramId(), "vertexPosition"); 
-	cg_assert(loc_pos!=-1,"Shader does not have vertexPosition attribute");
-	glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(loc_pos);
-	shader.setUniform("color",color_curve);
-	glDrawArrays(GL_POINTS, 0,v_curve.size());
-	glBindVertexArray(0);
+void BezierRenderer::drawCurves() {
+	if (counts.empty()) return;
+	bindVertexArray(0);
+	shader.setUniform(shader.uniformLocation(cg_name("color")),color_curve);
+	glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), counts.size());
 }
@@ -1,34 +1,92 @@
 #ifndef BEZIERRENDERER_HPP
 #define BEZIERRENDERER_HPP
+#include <limits>
+#include <vector>
 #include <glad/glad.h>
+#include "Bezier.hpp"
+#include "MemoryStats.hpp"
 #include "Shaders.hpp"
 
+// Draws bezier curves as line strips, tessellated adaptively (Bezier::tessellate)
+// for a maximum error in pixels if setScreen was called, or else in the curves'
+// own space. Any number of curves share one buffer and are drawn with a single
+// glMultiDrawArrays, so thousands of them (roads, contour lines) are one draw:
+//    renderer.begin(); for(auto &c : curves) renderer.add(c); renderer.end();
+//    ... renderer.drawCurves();
+// update(curve) does the same for a single curve, plus its control polygon for drawPoly.
 class BezierRenderer {
 public:
-	BezierRenderer(int nsamples=100);
+	BezierRenderer(int max_depth=10); // at most 2^max_depth segments per curve
 	~BezierRenderer();
 	Shader &getShader();
-	template<typename Bezier>
-	void update(Bezier &b);
+
+	// error in pixels, after projecting with mvp to a viewport of that size
+	void setScreen(const glm::mat4 &mvp, const glm::vec2 &viewport, float pixels=0.5f);
+	// error in the curves' space (the default, 1e-3)
+	void setTolerance(float tolerance);
+
+	void begin();
+	template<int D> void add(const Bezier<glm::vec3,D> &b);
+	void end(); // uploads the curves added since begin
+	int curvesCount() const { return counts.size(); }
+	int verticesCount() const { return v_curve.size(); }
+
+	template<int D> void update(const Bezier<glm::vec3,D> &b);
 	void drawPoly(bool full=true);
-	void drawCurve();
+	void drawCurves();
+	void drawCurve() { drawCurves(); }
+
 private:
+	// Flatness of the projected control points. A projected polynomial curve is a
+	// rational one with weights w, and with every w>0 the convex hull bound still
+	// holds; a piece crossing the near plane is never flat.
+	struct ScreenError {
+		glm::mat4 mvp;
+		glm::vec2 half_viewport;
+		template<int D> float operator()(const Bezier<glm::vec3,D> &b) const;
+	};
+	// the vao remembers the attribute setup, redone only if the shader was reloaded
+	void bindVertexArray(int i);
+
 	Shader shader;
-	GLuint VAO=0, VBO[2]={0,0};
+	GLuint VAO[2]={0,0}, VBO[2]={0,0}; // curves, polygon
+	unsigned attribs_serial[2] = {0,0};
+	int max_depth;
+	bool screen_space = false;
+	float tolerance = 1e-3f;
+	ScreenError screen_error;
 	std::vector<glm::vec3> v_curve, v_poly;
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+	size_t curve_capacity = 0; // of VBO[0], in vertices
+	TrackedBytes mem{memory_stats::cBuffers};
 	glm::vec3 color_curve = {1.f, 1.f, 1.f};
 	glm::vec3 color_poly = {.0f, .0f, .0f};
 	glm::vec3 color_points = {0.f, 0.f, 0.f};
 };
 
+template<int D>
+float BezierRenderer::ScreenError::operator()(const Bezier<glm::vec3,D> &b) const {
+	Bezier<glm::vec2,D> s;
+	for(int i=0;i<=D;++i) {
+		glm::vec4 c = mvp*glm::vec4(b[i],1.f);
+		if (c.w<=1e-6f) return std::numeric_limits<float>::infinity();
+		s[i] = glm::vec2(c.x,c.y)/c.w*half_viewport;
+	}
+	return s.flatness();
+}
+
+template<int D>
+void BezierRenderer::add(const Bezier<glm::vec3,D> &b) {
+	firsts.push_back(v_curve.size());
+	if (screen_space) b.tessellate(v_curve,tolerance,screen_error,max_depth);
+	else b.tessellate(v_curve,tolerance,[](const Bezier<glm::vec3,D> &c){ return c.flatness(); },max_depth);
+	counts.push_back(v_curve.size()-firsts.back());
+}
 
-template<typename Bezier>
-void BezierRenderer::update(Bezier &b) {
-	double n = double(v_curve.size())-1;
-	for(size_t i=0;i<v_curve.size();++i)
-		v_curve[i] = b.at(double(i)/n);
-	glBindBuffer(GL_ARRAY_BUFFER,VBO[0]);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, v_curve.size() * sizeof(glm::vec3), v_curve.data());
+template<int D>
+void BezierRenderer::update(const Bezier<glm::vec3,D> &b) {
+	begin(); add(b); end();
 	v_poly[0] = b[0];
 	v_poly[1] = b[1];
 	v_poly[2] = b[b.degree()-1];
@@ -1,6 +1,7 @@
 #include "Callbacks.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <GLFW/glfw3.h>
 #include <glm/ext.hpp>
 #include "Window.hpp"
@@ -11,6 +12,8 @@ int win_width = 1000, win_height = 750;
 glm::vec3 view_target = {0.f,0.f,0.f}, view_pos = {0.f,0.f,3.f};
 float model_angle = -0.8f, view_angle = 0.6f, view_fov = 45.f;
 bool use_perspective = true;
+glm::vec2 world_pos = {0.f,0.f};
+bool world_pan = false;
 
 namespace common_callbacks {
 	
@@ -18,12 +21,19 @@ namespace common_callbacks {
 enum class MouseAction { None, Rotate, Zoom, Pan };
 MouseAction mouse_action = MouseAction::None;
 glm::vec2 last_mouse_pos;
+std::function<void(double,double)> pick_callback;
 
 void mouseMoveCallback(GLFWwindow* window, double xpos, double ypos) {
 	glm::vec2 current_mouse_pos(xpos,ypos);
 	glm::vec2 delta = current_mouse_pos - last_mouse_pos;
 	switch(mouse_action) {
 	case MouseAction::Pan:
+		if (world_pan) {
+			// screen right and down in the model's xz plane (it's rotated by model_angle)
+			glm::vec2 right(std::cos(model_angle),std::sin(model_angle)), down(-std::sin(model_angle),std::cos(model_angle));
+			world_pos -= right*(delta.x/win_width*2.f) + down*(delta.y/win_height*2.f);
+			break;
+		}
 		view_target.x -= delta.x/win_width*2.f;
 		view_target.y += delta.y/win_height*2.f;
 		view_target.x = std::min(1.f,std::max(-1.f,view_target.x));
@@ -52,6 +62,10 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 			else if (mods&GLFW_MOD_SHIFT) mouse_action = MouseAction::Pan;
 			else if (not mods)              mouse_action = MouseAction::Rotate;
 		}
+	} else if (button==GLFW_MOUSE_BUTTON_RIGHT and action==GLFW_PRESS and pick_callback) {
+		double xpos, ypos;
+		glfwGetCursorPos(window,&xpos,&ypos);
+		pick_callback(xpos,ypos);
 	}
 }
 
@@ -68,8 +82,21 @@ std::array<glm::mat4,3> getMatrixes() {
 	       };
 }
 
+void getMouseRay(double xpos, double ypos, glm::vec3 &origin, glm::vec3 &direction) {
+	auto ms = getMatrixes();
+	glm::mat4 inv = glm::inverse(ms[2]*ms[1]*ms[0]);
+	float x = 2.f*float(xpos)/win_width-1.f, y = 1.f-2.f*float(ypos)/win_height;
+	glm::vec4 near_point = inv*glm::vec4(x,y,-1.f,1.f), far_point = inv*glm::vec4(x,y,1.f,1.f);
+	origin = glm::vec3(near_point)/near_point.w;
+	direction = glm::vec3(far_point)/far_point.w-origin;
+}
+
 } // namespace
 
+void setPickCallback(std::function<void(double,double)> callback) {
+	common_callbacks::pick_callback = std::move(callback);
+}
+
 void setCommonCallbacks(GLFWwindow * window) {
 	glfwSetFramebufferSizeCallback(window,common_callbacks::viewResizeCallback);
 	glfwSetCursorPosCallback(window, common_callbacks::mouseMoveCallback);
@@ -2,6 +2,7 @@
 #define CALLBACKS_HPP
 
 #include <array>
+#include <functional>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
@@ -10,6 +11,10 @@ extern int win_width, win_height;
 extern glm::vec3 view_target, view_pos;
 extern float model_angle, view_angle, view_fov;
 extern bool use_perspective;
+// with world_pan, panning moves world_pos (x,z of an unbounded world, drawn 
+// around the origin) instead of view_target, and with no limits
+extern glm::vec2 world_pos;
+extern bool world_pan;
 
 namespace common_callbacks {
 	
@@ -18,10 +23,15 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void viewResizeCallback(GLFWwindow *, int w, int h);
 
 std::array<glm::mat4,3> getMatrixes();
+// ray under the cursor (window coordinates, as in mouseMoveCallback) in model
+// space: from the near plane (t=0) to the far plane (t=1)
+void getMouseRay(double xpos, double ypos, glm::vec3 &origin, glm::vec3 &direction);
 
 } // anonymous namespace
 
 void setCommonCallbacks(GLFWwindow* window);
+// called with the cursor position on a right click (if ImGui doesn't want it)
+void setPickCallback(std::function<void(double,double)> callback);
 
 class Shader;
 void setMatrixes(Shader &shader);
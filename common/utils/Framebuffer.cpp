@@ -0,0 +1,67 @@
+#include <algorithm>
+#include "Framebuffer.hpp"
+#include "Debug.hpp"
+
+Framebuffer::Framebuffer(int width, int height) : w(width), h(height) {
+	cg_assert(w>0 and h>0,"Invalid framebuffer size");
+	glGenRenderbuffers(1,&color);
+	glBindRenderbuffer(GL_RENDERBUFFER,color);
+	glRenderbufferStorage(GL_RENDERBUFFER,GL_RGBA8,w,h);
+	glGenRenderbuffers(1,&depth);
+	glBindRenderbuffer(GL_RENDERBUFFER,depth);
+	glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,w,h);
+	glBindRenderbuffer(GL_RENDERBUFFER,0);
+	
+	glGenFramebuffers(1,&fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER,fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_RENDERBUFFER,color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,depth);
+	cg_assert(glCheckFramebufferStatus(GL_FRAMEBUFFER)==GL_FRAMEBUFFER_COMPLETE,"Incomplete framebuffer");
+	glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+Framebuffer::Framebuffer(Framebuffer &&other) {
+	*this = static_cast<const Framebuffer&>(other);
+	other = static_cast<const Framebuffer&>(Framebuffer());
+}
+
+Framebuffer &Framebuffer::operator=(Framebuffer &&other) {
+	freeResources();
+	*this = static_cast<const Framebuffer&>(other);
+	other = static_cast<const Framebuffer&>(Framebuffer());
+	return *this;
+}
+
+void Framebuffer::freeResources() {
+	if (fbo) glDeleteFramebuffers(1,&fbo);
+	if (color) glDeleteRenderbuffers(1,&color);
+	if (depth) glDeleteRenderbuffers(1,&depth);
+	fbo = color = depth = 0;
+}
+
+Framebuffer::~Framebuffer() {
+	freeResources();
+}
+
+void Framebuffer::bind() const {
+	cg_assert(fbo,"Framebuffer not initialized");
+	glBindFramebuffer(GL_FRAMEBUFFER,fbo);
+	glViewport(0,0,w,h);
+}
+
+void Framebuffer::bindDefault() {
+	glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+std::vector<unsigned char> Framebuffer::readPixels() const {
+	std::vector<unsigned char> pixels(size_t(w)*h*4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER,fbo);
+	glPixelStorei(GL_PACK_ALIGNMENT,1);
+	glReadPixels(0,0,w,h,GL_RGBA,GL_UNSIGNED_BYTE,pixels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT,4);
+	size_t row = size_t(w)*4;
+	for(int y=0;y<h/2;++y) // gl rows go from the bottom up
+		std::swap_ranges(pixels.begin()+y*row,pixels.begin()+(y+1)*row,pixels.begin()+(h-1-y)*row);
+	return pixels;
+}
+
@@ -0,0 +1,34 @@
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#include <vector>
+#include <glad/glad.h>
+
+// offscreen render target: rgba8 color + 24 bits depth (renderbuffers)
+class Framebuffer {
+public:
+	Framebuffer() = default;
+	Framebuffer(int width, int height);
+	Framebuffer(Framebuffer &&other);
+	Framebuffer &operator=(Framebuffer &&other);
+	~Framebuffer();
+	
+	void bind() const; // also sets the viewport
+	static void bindDefault();
+	
+	// color contents, rgba, first row at the top (like images, unlike gl)
+	std::vector<unsigned char> readPixels() const;
+	
+	int width() const { return w; }
+	int height() const { return h; }
+	
+private:
+	Framebuffer(const Framebuffer &) = delete;
+	Framebuffer &operator=(const Framebuffer &) = default;
+	void freeResources();
+	GLuint fbo = 0, color = 0, depth = 0;
+	int w = 0, h = 0;
+};
+
+#endif
+
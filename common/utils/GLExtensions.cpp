@@ -0,0 +1,47 @@
+#include <set>
+#include "GLExtensions.hpp"
+
+bool hasGLExtension(const std::string &name) {
+	static const std::set<std::string> extensions = [](){
+		std::set<std::string> ret;
+		GLint n = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS,&n);
+		for(GLint i=0;i<n;++i)
+			ret.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS,i)));
+		return ret;
+	}();
+	return extensions.count(name);
+}
+
+static GLADloadproc proc_loader = nullptr;
+
+void setGLProcLoader(GLADloadproc loader) {
+	proc_loader = loader;
+}
+
+const GLExtensionFunctions &glExtensionFunctions() {
+	static const GLExtensionFunctions functions = [](){
+		GLExtensionFunctions ret;
+		if (not proc_loader) return ret;
+		auto load = [](const char *name) { return proc_loader(name); };
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION,&major);
+		glGetIntegerv(GL_MINOR_VERSION,&minor);
+		if (major*10+minor>=41 or hasGLExtension("GL_ARB_get_program_binary")) {
+			GLint formats = 0; // a driver may have the functions but no format to use them
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS,&formats);
+			if (formats>0) {
+				ret.getProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(load("glGetProgramBinary"));
+				ret.programBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(load("glProgramBinary"));
+				ret.programParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(load("glProgramParameteri"));
+			}
+		}
+		if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+			ret.maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsKHR"));
+		else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+			ret.maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsARB"));
+		return ret;
+	}();
+	return functions;
+}
+
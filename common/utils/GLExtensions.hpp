@@ -0,0 +1,43 @@
+#ifndef GLEXTENSIONS_HPP
+#define GLEXTENSIONS_HPP
+
+#include <string>
+#include <glad/glad.h>
+
+// things that glad was not generated for (it only knows core 3.3)
+
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+
+// ARB_get_program_binary (core in 4.1)
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+// KHR_parallel_shader_compile (and its ARB twin, same values)
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// entry points for those extensions, null if the context does not have them
+struct GLExtensionFunctions {
+	PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = nullptr;
+	bool hasProgramBinary() const { return getProgramBinary and programBinary; }
+	bool hasParallelCompile() const { return maxShaderCompilerThreads; }
+};
+
+// true if the current context reports that extension (the list is read on first call)
+bool hasGLExtension(const std::string &name);
+
+// Window gives the loader it used for glad, the functions are loaded on first call
+void setGLProcLoader(GLADloadproc loader);
+const GLExtensionFunctions &glExtensionFunctions();
+
+#endif
+
@@ -0,0 +1,115 @@
+#include "GLState.hpp"
+#include "Debug.hpp"
+
+GLState &GLState::current() {
+	static thread_local GLState state;
+	return state;
+}
+
+GLState::GLState() {
+	for(GLuint &s : sampler_objects) s = 0;
+	invalidate();
+}
+
+GLState::~GLState() {
+	// samplers are not deleted, the context is usually gone by now
+}
+
+void GLState::invalidate() {
+	program = vao = unknown;
+	for(int i=0;i<max_units;++i) {
+		textures[i] = samplers[i] = unknown;
+		texture_targets[i] = GL_NONE;
+	}
+	polygon_mode = blend_src = blend_dst = GL_NONE;
+	active_unit = blend_enabled = -1;
+}
+
+bool GLState::skip(bool unchanged) {
+	++frame.calls;
+	if (unchanged) ++frame.skipped;
+	return unchanged;
+}
+
+void GLState::newFrame() {
+	last_frame = frame;
+	frame = Stats();
+}
+
+void GLState::useProgram(GLuint p) {
+	if (skip(program==p)) return;
+	glUseProgram(p);
+	program = p;
+}
+
+void GLState::bindVertexArray(GLuint v) {
+	if (skip(vao==v)) return;
+	glBindVertexArray(v);
+	vao = v;
+}
+
+void GLState::activeTexture(int unit) {
+	if (active_unit==unit) return;
+	glActiveTexture(GL_TEXTURE0+unit);
+	active_unit = unit;
+}
+
+void GLState::bindTexture(int unit, GLenum target, GLuint texture) {
+	cg_assert(unit>=0 and unit<max_units,"Invalid texture unit");
+	if (skip(textures[unit]==texture and texture_targets[unit]==target)) return;
+	activeTexture(unit);
+	glBindTexture(target,texture);
+	textures[unit] = texture;
+	texture_targets[unit] = target;
+}
+
+void GLState::bindSampler(int unit, GLuint sampler) {
+	cg_assert(unit>=0 and unit<max_units,"Invalid texture unit");
+	if (skip(samplers[unit]==sampler)) return;
+	glBindSampler(unit,sampler);
+	samplers[unit] = sampler;
+}
+
+void GLState::polygonMode(GLenum mode) {
+	if (skip(polygon_mode==mode)) return;
+	glPolygonMode(GL_FRONT_AND_BACK,mode);
+	polygon_mode = mode;
+}
+
+void GLState::enableBlend(bool enabled) {
+	if (skip(blend_enabled==int(enabled))) return;
+	if (enabled) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+	blend_enabled = enabled;
+}
+
+void GLState::blendFunc(GLenum sfactor, GLenum dfactor) {
+	if (skip(blend_src==sfactor and blend_dst==dfactor)) return;
+	glBlendFunc(sfactor,dfactor);
+	blend_src = sfactor; blend_dst = dfactor;
+}
+
+GLuint GLState::sampler(bool repeat_s, bool repeat_t, bool mipmapped) {
+	GLuint &s = sampler_objects[(repeat_s?1:0)+(repeat_t?2:0)+(mipmapped?4:0)];
+	if (s==0) {
+		glGenSamplers(1,&s);
+		glSamplerParameteri(s, GL_TEXTURE_WRAP_S, repeat_s?GL_REPEAT:GL_CLAMP_TO_BORDER);
+		glSamplerParameteri(s, GL_TEXTURE_WRAP_T, repeat_t?GL_REPEAT:GL_CLAMP_TO_BORDER);
+		glSamplerParameteri(s, GL_TEXTURE_MIN_FILTER, mipmapped?GL_LINEAR_MIPMAP_LINEAR:GL_LINEAR);
+		glSamplerParameteri(s, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	return s;
+}
+
+void GLState::forgetProgram(GLuint p) {
+	if (program==p) program = unknown;
+}
+
+void GLState::forgetVertexArray(GLuint v) {
+	if (vao==v) vao = unknown;
+}
+
+void GLState::forgetTexture(GLuint texture) {
+	for(int i=0;i<max_units;++i)
+		if (textures[i]==texture) textures[i] = unknown;
+}
+
@@ -0,0 +1,55 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include <glad/glad.h>
+
+// Remembers the gl state that the render loop sets most often, and skips the 
+// calls that would not change anything. There is one instance per thread (as a 
+// context can only be current in one thread). Code that changes this state 
+// without using this class must call invalidate() afterwards.
+class GLState {
+public:
+	static GLState &current();
+	
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindTexture(int unit, GLenum target, GLuint texture);
+	void bindSampler(int unit, GLuint sampler);
+	void polygonMode(GLenum mode); // for GL_FRONT_AND_BACK
+	void enableBlend(bool enabled);
+	void blendFunc(GLenum sfactor, GLenum dfactor);
+	
+	// shared sampler object for a wrapping mode (linear filtering, trilinear if 
+	// the texture has mip levels)
+	GLuint sampler(bool repeat_s, bool repeat_t, bool mipmapped=false);
+	
+	// objects about to be deleted (gl unbinds them, and their names can be reused)
+	void forgetProgram(GLuint program);
+	void forgetVertexArray(GLuint vao);
+	void forgetTexture(GLuint texture);
+	
+	void invalidate(); // forget everything
+	
+	struct Stats { int calls = 0, skipped = 0; };
+	void newFrame(); // closes the counters for the current frame
+	const Stats &lastFrameStats() const { return last_frame; }
+	
+	~GLState();
+	
+private:
+	GLState();
+	GLState(const GLState &other) = delete;
+	GLState &operator=(const GLState &other) = delete;
+	bool skip(bool unchanged);
+	void activeTexture(int unit);
+	
+	static constexpr GLuint unknown = ~GLuint(0);
+	static constexpr int max_units = 16;
+	GLuint program, vao, textures[max_units], samplers[max_units], sampler_objects[8];
+	GLenum texture_targets[max_units], polygon_mode, blend_src, blend_dst;
+	int active_unit, blend_enabled;
+	Stats frame, last_frame;
+};
+
+#endif
+
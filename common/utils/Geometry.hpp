@@ -2,44 +2,46 @@
 #define GEOMETRY_HPP
 
 #include <vector>
-#include <glad/glad.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include "MemoryStats.hpp"
+
+// Mesh data on the cpu side, no gl here (the buffers are in GeometryRenderer.hpp).
+
+// Triangles around each vertex, in compressed sparse row form: those of vertex v
+// are corners[first[v]] to corners[first[v+1]-1], each one as 3*triangle+corner
+// (an index into triangles), in triangle order. It depends only on the topology,
+// so it is built once and reused while the positions change.
+struct VertexAdjacency {
+	std::vector<int> first, corners;
+	void build(const std::vector<int> &triangles, int vertices_count);
+	bool builtFor(const std::vector<int> &triangles, int vertices_count) const {
+		return first.size()==size_t(vertices_count)+1 and corners.size()==triangles.size();
+	}
+};
 
 struct Geometry {
 	std::vector<glm::vec3> positions;
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec2> tex_coords;
 	std::vector<int> triangles;
-	void generateNormals();
 	
-};
-
-class GeometryRenderer {
-public:
-	GeometryRenderer() = default;
-	GeometryRenderer(const Geometry &geo, bool dynamic=false);
-	GeometryRenderer(GeometryRenderer &&geo);
-	GeometryRenderer &operator=(GeometryRenderer &&geo);
-	void draw() const;
-	GLuint vertexArray() const { return VAO; }
-	GLuint positionsVBO() const { return VBO_pos; }
-	GLuint normalsVBO() const { return VBO_norms; }
-	GLuint texCoordsVBO() const { return VBO_tcs; }
-	
-	void updateTexCoords(const std::vector<glm::vec2> &vtc, bool realloc=false, bool dynamic=false);
-	void updatePositions(const std::vector<glm::vec3> &vp, bool realloc=false, bool dynamic=false);
-	void updateNormals(const std::vector<glm::vec3> &vn, bool realloc=false, bool dynamic=false);
-	void updateElements(const std::vector<int> &ve, bool realloc=false, bool dynamic=false);
+	// How the normals of the triangles around a vertex are averaged: by area (the 
+	// default, what plain accumulation of the cross products does), by the angle 
+	// of the triangle at that vertex, or all the same.
+	enum NormalWeights { nwArea, nwAngle, nwUniform };
+	// With triangles, it computes the faces' normals and then gathers them per
+	// vertex through adjacency, both in parallel (ThreadPool::shared) with no write
+	// conflicts. Only the positions are read, so regenerating after moving vertices
+	// costs no rebuild.
+	void generateNormals(NormalWeights weights=nwArea);
+	VertexAdjacency adjacency; // built by generateNormals when missing or stale
+	// call it after changing triangles in place (a change in sizes is detected)
+	void topologyChanged() { adjacency = VertexAdjacency(); }
 	
-	~GeometryRenderer();
-private:
-	GeometryRenderer(const GeometryRenderer &) = delete;
-	GeometryRenderer &operator=(const GeometryRenderer &) = default;
-	void freeResources();
-	GLuint VAO=0, VBO_pos=0, VBO_tcs=0, VBO_norms=0, EBO=0;
-	int count = 0;
+	// recounts the bytes held by the vectors (call it after changing their sizes)
+	void trackMemory();
+	TrackedBytes memory{memory_stats::cGeometry};
 };
 
 #endif
-
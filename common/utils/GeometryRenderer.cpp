@@ -0,0 +1,124 @@
+#include <glm/ext.hpp>
+#include "GeometryRenderer.hpp"
+#include "Debug.hpp"
+#include "GLState.hpp"
+
+template<typename vector>
+static void updateBuffer(GLenum type, GLuint &id, vector &v, bool realloc, bool dynamic, TrackedBytes &mem) {
+	if (id==0) {
+		cg_assert(realloc,"Texture coordinates not initialized");
+		glGenBuffers(1, &id);
+	}
+	glBindBuffer(type, id);
+	if (realloc) {
+		glBufferData(type, v.size()*sizeof(typename vector::value_type), v.data(), dynamic?GL_DYNAMIC_DRAW:GL_STATIC_DRAW);
+		mem.set(v.size()*sizeof(typename vector::value_type));
+	} else
+		glBufferSubData(type, 0, v.size()*sizeof(typename vector::value_type), v.data());
+}
+
+GeometryRenderer::GeometryRenderer(const Geometry &geo, bool dynamic) {
+	
+	cg_assert(geo.positions.size(),"Empty Geometry");
+	
+	glGenVertexArrays(1,&VAO);
+	GLState::current().bindVertexArray(VAO);
+	
+	updateBuffer(GL_ARRAY_BUFFER,VBO_pos,geo.positions,true,dynamic,mem_pos);
+	
+	if (not geo.normals.empty()) {
+		cg_assert(geo.normals.size()==geo.positions.size(),"Wrong normals count");
+		updateBuffer(GL_ARRAY_BUFFER,VBO_norms,geo.normals,true,dynamic,mem_norms);  
+	}
+	if (not geo.tex_coords.empty()) {
+		cg_assert(geo.tex_coords.size()==geo.positions.size(),"Wrong texture coordinates count");
+		updateBuffer(GL_ARRAY_BUFFER,VBO_tcs,geo.tex_coords,true,dynamic,mem_tcs);  
+	}
+	if (not geo.triangles.empty()) {
+		updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,geo.triangles,true,dynamic,mem_ebo);
+		count = geo.triangles.size();
+	} else 
+		count = geo.positions.size();
+}
+
+GeometryRenderer::GeometryRenderer(GeometryRenderer &&geo) {
+	*this = static_cast<const GeometryRenderer&>(geo);
+	geo = static_cast<const GeometryRenderer&>(GeometryRenderer());
+}
+
+GeometryRenderer &GeometryRenderer::operator=(GeometryRenderer &&geo) {
+	freeResources();
+	*this = static_cast<const GeometryRenderer&>(geo);
+	geo = static_cast<const GeometryRenderer&>(GeometryRenderer());
+	return *this;
+}
+
+void GeometryRenderer::draw() const {
+	GLState::current().bindVertexArray(VAO); // no need to unbind it, everyone binds its own vao before drawing
+	if (EBO) glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
+	else glDrawArrays(GL_TRIANGLES, 0,count);
+}
+
+void GeometryRenderer::drawInstanced(int instances) const {
+	GLState::current().bindVertexArray(VAO);
+	if (EBO) glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0, instances);
+	else glDrawArraysInstanced(GL_TRIANGLES, 0, count, instances);
+}
+
+void GeometryRenderer::freeResources() {
+	if (VAO==0) return;
+	if (VBO_pos) glDeleteBuffers(1,&VBO_pos);
+	if (VBO_norms) glDeleteBuffers(1,&VBO_norms);
+	if (VBO_tcs) glDeleteBuffers(1,&VBO_tcs);
+	if (EBO) glDeleteBuffers(1,&EBO);
+	GLState::current().forgetVertexArray(VAO);
+	glDeleteVertexArrays(1,&VAO);
+}
+GeometryRenderer::~GeometryRenderer() {
+	freeResources();
+}
+
+void GeometryRenderer::updateTexCoords (const std::vector<glm::vec2> &vtc, bool realloc, bool dynamic) {
+	updateBuffer(GL_ARRAY_BUFFER, VBO_tcs,vtc,realloc,dynamic,mem_tcs);
+}
+
+void GeometryRenderer::updatePositions (const std::vector<glm::vec3> &vp, bool realloc, bool dynamic) {
+	updateBuffer(GL_ARRAY_BUFFER, VBO_pos,vp,realloc,dynamic,mem_pos);
+}
+
+void GeometryRenderer::updateNormals (const std::vector<glm::vec3> &vn, bool realloc, bool dynamic) {
+	updateBuffer(GL_ARRAY_BUFFER, VBO_norms,vn,realloc,dynamic,mem_norms);
+}
+
+void GeometryRenderer::updateElements(const std::vector<int> &ve, bool realloc, bool dynamic) {
+	GLState::current().bindVertexArray(VAO); // the element buffer binding is part of the vao
+	updateBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO,ve,realloc,dynamic,mem_ebo);
+}
+
+InstanceBuffer::InstanceBuffer(InstanceBuffer &&other) {
+	*this = static_cast<const InstanceBuffer&>(other);
+	other = static_cast<const InstanceBuffer&>(InstanceBuffer());
+}
+
+InstanceBuffer &InstanceBuffer::operator=(InstanceBuffer &&other) {
+	if (vbo) glDeleteBuffers(1,&vbo);
+	*this = static_cast<const InstanceBuffer&>(other);
+	other = static_cast<const InstanceBuffer&>(InstanceBuffer());
+	return *this;
+}
+
+void InstanceBuffer::update(const std::vector<glm::mat4> &models) {
+	if (models.empty() and vbo==0) return;
+	std::vector<Instance> instances(models.size());
+	for(size_t i=0;i<models.size();++i)
+		instances[i] = { models[i], glm::transpose(glm::inverse(glm::mat3(models[i]))) };
+	instances_count = instances.size();
+	bool realloc = instances_count>capacity; // the vao keeps pointing to the same buffer id anyway
+	if (realloc) capacity = instances_count;
+	updateBuffer(GL_ARRAY_BUFFER,vbo,instances,realloc,true,mem);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	if (vbo) glDeleteBuffers(1,&vbo);
+}
+
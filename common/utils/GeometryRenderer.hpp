@@ -0,0 +1,71 @@
+#ifndef GEOMETRYRENDERER_HPP
+#define GEOMETRYRENDERER_HPP
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include "Geometry.hpp"
+#include "MemoryStats.hpp"
+
+class GeometryRenderer {
+public:
+	GeometryRenderer() = default;
+	GeometryRenderer(const Geometry &geo, bool dynamic=false);
+	GeometryRenderer(GeometryRenderer &&geo);
+	GeometryRenderer &operator=(GeometryRenderer &&geo);
+	void draw() const;
+	void drawInstanced(int instances) const;
+	GLuint vertexArray() const { return VAO; }
+	GLuint positionsVBO() const { return VBO_pos; }
+	GLuint normalsVBO() const { return VBO_norms; }
+	GLuint texCoordsVBO() const { return VBO_tcs; }
+	
+	// serial of the program whose attributes were last bound to this vao by 
+	// Shader::setBuffers (not its id, gl may reuse the ids of reloaded programs)
+	unsigned &attribsSerial() const { return attribs_serial; }
+	
+	void updateTexCoords(const std::vector<glm::vec2> &vtc, bool realloc=false, bool dynamic=false);
+	void updatePositions(const std::vector<glm::vec3> &vp, bool realloc=false, bool dynamic=false);
+	void updateNormals(const std::vector<glm::vec3> &vn, bool realloc=false, bool dynamic=false);
+	void updateElements(const std::vector<int> &ve, bool realloc=false, bool dynamic=false);
+	
+	~GeometryRenderer();
+private:
+	GeometryRenderer(const GeometryRenderer &) = delete;
+	GeometryRenderer &operator=(const GeometryRenderer &) = default;
+	void freeResources();
+	GLuint VAO=0, VBO_pos=0, VBO_tcs=0, VBO_norms=0, EBO=0;
+	TrackedBytes mem_pos{memory_stats::cBuffers}, mem_tcs{memory_stats::cBuffers}, 
+		mem_norms{memory_stats::cBuffers}, mem_ebo{memory_stats::cBuffers};
+	int count = 0;
+	mutable unsigned attribs_serial = 0;
+};
+
+// Per instance transforms for instanced draws (see Shader::setBuffers). Every
+// instance has its model matrix and the normal matrix for it, computed here once
+// instead of in the vertex shader.
+class InstanceBuffer {
+public:
+	struct Instance { glm::mat4 model; glm::mat3 normal; };
+	
+	InstanceBuffer() = default;
+	InstanceBuffer(InstanceBuffer &&other);
+	InstanceBuffer &operator=(InstanceBuffer &&other);
+	
+	void update(const std::vector<glm::mat4> &models);
+	int count() const { return instances_count; }
+	GLuint VBO() const { return vbo; }
+	
+	~InstanceBuffer();
+private:
+	InstanceBuffer(const InstanceBuffer &) = delete;
+	InstanceBuffer &operator=(const InstanceBuffer &) = default;
+	GLuint vbo = 0;
+	TrackedBytes mem{memory_stats::cBuffers};
+	int instances_count = 0, capacity = 0;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "HeadlessContext.hpp"
+#include "Debug.hpp"
+
+#ifdef _WIN32
+
+HeadlessContext::HeadlessContext() {
+	cg_error("Headless rendering is only available on Linux (EGL)");
+}
+HeadlessContext::~HeadlessContext() { }
+std::string HeadlessContext::renderer() const { return ""; }
+
+#else
+
+#include <cstring>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include "GLExtensions.hpp"
+
+static bool hasEGLExtension(EGLDisplay display, const char *name) {
+	const char *list = eglQueryString(display,EGL_EXTENSIONS);
+	if (not list) return false;
+	size_t len = std::strlen(name);
+	for(const char *p=std::strstr(list,name); p; p=std::strstr(p+len,name))
+		if ((p==list or p[-1]==' ') and (p[len]==' ' or p[len]=='\0')) return true;
+	return false;
+}
+
+static EGLDisplay getDisplay() {
+	// surfaceless first (no display server at all), then whatever is the default
+	if (hasEGLExtension(EGL_NO_DISPLAY,"EGL_MESA_platform_surfaceless")) {
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay) {
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,EGL_DEFAULT_DISPLAY,nullptr);
+			EGLint major, minor;
+			if (display!=EGL_NO_DISPLAY and eglInitialize(display,&major,&minor)) return display;
+		}
+	}
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display!=EGL_NO_DISPLAY and eglInitialize(display,&major,&minor)) return display;
+	return EGL_NO_DISPLAY;
+}
+
+HeadlessContext::HeadlessContext() {
+	EGLDisplay egl_display = getDisplay();
+	cg_assert(egl_display!=EGL_NO_DISPLAY,"Failed to initialize EGL");
+	display = egl_display;
+	EGLBoolean bound = eglBindAPI(EGL_OPENGL_API);
+	cg_assert(bound,"EGL can not create OpenGL contexts");
+	
+	bool surfaceless = hasEGLExtension(egl_display,"EGL_KHR_surfaceless_context");
+	const EGLint config_attribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = nullptr;
+	EGLint count = 0;
+	if (not eglChooseConfig(egl_display,config_attribs,&config,1,&count) or count==0) {
+		cg_assert(surfaceless,"No suitable EGL config");
+		config = nullptr; // EGL_KHR_no_config_context, or it will just fail below
+	}
+	
+	const EGLint context_attribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLContext egl_context = eglCreateContext(egl_display,config,EGL_NO_CONTEXT,context_attribs);
+	cg_assert(egl_context!=EGL_NO_CONTEXT,"Failed to create EGL context");
+	context = egl_context;
+	
+	EGLSurface egl_surface = EGL_NO_SURFACE;
+	if (not surfaceless) { // a tiny pbuffer, only so that the context can be made current
+		const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		egl_surface = eglCreatePbufferSurface(egl_display,config,pbuffer_attribs);
+		cg_assert(egl_surface!=EGL_NO_SURFACE,"Failed to create EGL pbuffer");
+		surface = egl_surface;
+	}
+	EGLBoolean current = eglMakeCurrent(egl_display,egl_surface,egl_surface,egl_context);
+	cg_assert(current,"Failed to make the EGL context current");
+	
+	if (not gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+		cg_error("Failed to initialize GLAD");
+	setGLProcLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+	cg_info("OpenGL (headless): "+renderer());
+}
+
+HeadlessContext::~HeadlessContext() {
+	if (not display) return;
+	eglMakeCurrent(display,EGL_NO_SURFACE,EGL_NO_SURFACE,EGL_NO_CONTEXT);
+	if (surface) eglDestroySurface(display,surface);
+	if (context) eglDestroyContext(display,context);
+	eglTerminate(display);
+}
+
+std::string HeadlessContext::renderer() const {
+	std::string ret;
+	for(GLenum e : {GL_VENDOR,GL_RENDERER,GL_VERSION}) {
+		const GLubyte *str = glGetString(e);
+		if (not ret.empty()) ret += ", ";
+		ret += str ? reinterpret_cast<const char*>(str) : "?";
+	}
+	return ret;
+}
+
+#endif
+
@@ -0,0 +1,25 @@
+#ifndef HEADLESSCONTEXT_HPP
+#define HEADLESSCONTEXT_HPP
+
+#include <string>
+
+// OpenGL 3.3 core context without window or display, through EGL (surfaceless 
+// platform if the driver has it, so it works on llvmpipe with no X server). It
+// has no default framebuffer, render into a Framebuffer. Only one at a time, and
+// not together with a Window. Linux only.
+class HeadlessContext {
+public:
+	HeadlessContext();
+	~HeadlessContext();
+	
+	HeadlessContext(const HeadlessContext &other) = delete;
+	HeadlessContext &operator=(const HeadlessContext &other) = delete;
+	
+	std::string renderer() const; // "vendor, renderer, version"
+	
+private:
+	void *display = nullptr, *context = nullptr, *surface = nullptr;
+};
+
+#endif
+
@@ -0,0 +1,121 @@
+#include <utility>
+#include "MappedFile.hpp"
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &fname) {
+	HANDLE file = CreateFileA(fname.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+	if (file==INVALID_HANDLE_VALUE) return;
+	LARGE_INTEGER fsize;
+	if (not GetFileSizeEx(file,&fsize) or fsize.QuadPart==0) { CloseHandle(file); return; }
+	HANDLE mapping = CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+	if (not mapping) { CloseHandle(file); return; }
+	ptr = static_cast<const unsigned char*>(MapViewOfFile(mapping,FILE_MAP_READ,0,0,0));
+	if (not ptr) { CloseHandle(mapping); CloseHandle(file); return; }
+	len = fsize.QuadPart; file_handle = file; map_handle = mapping;
+}
+
+MappedFile::MappedFile(const std::string &fname, size_t size) {
+	if (size==0) return;
+	HANDLE file = CreateFileA(fname.c_str(),GENERIC_READ|GENERIC_WRITE,FILE_SHARE_READ|FILE_SHARE_WRITE,nullptr,OPEN_ALWAYS,FILE_ATTRIBUTE_NORMAL,nullptr);
+	if (file==INVALID_HANDLE_VALUE) return;
+	// sets the size here, the mapping could only grow it
+	LARGE_INTEGER fsize; fsize.QuadPart = size;
+	if (not SetFilePointerEx(file,fsize,nullptr,FILE_BEGIN) or not SetEndOfFile(file)) { CloseHandle(file); return; }
+	HANDLE mapping = CreateFileMappingA(file,nullptr,PAGE_READWRITE,0,0,nullptr);
+	if (not mapping) { CloseHandle(file); return; }
+	ptr = static_cast<const unsigned char*>(MapViewOfFile(mapping,FILE_MAP_WRITE,0,0,0));
+	if (not ptr) { CloseHandle(mapping); CloseHandle(file); return; }
+	len = size; file_handle = file; map_handle = mapping; writable = true;
+}
+
+bool MappedFile::flush() {
+	if (not writable) return false;
+	return FlushViewOfFile(ptr,0) and FlushFileBuffers(file_handle);
+}
+
+void MappedFile::close() {
+	if (not ptr) return;
+	UnmapViewOfFile(ptr);
+	CloseHandle(map_handle);
+	if (writable and final_size) {
+		LARGE_INTEGER fsize; fsize.QuadPart = final_size;
+		if (SetFilePointerEx(file_handle,fsize,nullptr,FILE_BEGIN)) SetEndOfFile(file_handle);
+	}
+	CloseHandle(file_handle);
+	ptr = nullptr; len = final_size = 0; writable = false; map_handle = file_handle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &fname) {
+	int fd = open(fname.c_str(),O_RDONLY);
+	if (fd==-1) return;
+	struct stat st;
+	if (fstat(fd,&st)==0 and st.st_size>0) {
+		void *p = mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if (p!=MAP_FAILED) { ptr = static_cast<const unsigned char*>(p); len = st.st_size; }
+	}
+	::close(fd); // the mapping keeps its own reference to the file
+}
+
+MappedFile::MappedFile(const std::string &fname, size_t size) {
+	if (size==0) return;
+	int file = open(fname.c_str(),O_RDWR|O_CREAT,0644);
+	if (file==-1) return;
+	if (ftruncate(file,size)==0) {
+		void *p = mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,file,0);
+		if (p!=MAP_FAILED) { ptr = static_cast<const unsigned char*>(p); len = size; writable = true; fd = file; return; }
+	}
+	::close(file);
+}
+
+bool MappedFile::flush() {
+	if (not writable) return false;
+	return msync(const_cast<unsigned char*>(ptr),len,MS_SYNC)==0;
+}
+
+void MappedFile::close() {
+	if (not ptr) return;
+	munmap(const_cast<unsigned char*>(ptr),len);
+	if (fd!=-1) {
+		if (final_size) { int r = ftruncate(fd,final_size); (void)r; } // if it fails the file just keeps the mapped size
+		::close(fd);
+	}
+	ptr = nullptr; len = final_size = 0; writable = false; fd = -1;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) {
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+	if (this==&other) return *this;
+	close();
+	std::swap(ptr,other.ptr);
+	std::swap(len,other.len);
+	std::swap(final_size,other.final_size);
+	std::swap(writable,other.writable);
+#ifdef _WIN32
+	std::swap(file_handle,other.file_handle);
+	std::swap(map_handle,other.map_handle);
+#else
+	std::swap(fd,other.fd);
+#endif
+	return *this;
+}
+
@@ -0,0 +1,49 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// Memory mapping of a whole file, pages are loaded on demand by the os. Either
+// read-only, or read-write and shared with the file (writes reach the disk 
+// whenever the os wants, or on flush).
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const std::string &fname); // read-only
+	// read-write, creates the file if it's missing and sets its size first (an
+	// extended file reads as zeros, and on most file systems takes no space
+	// until written)
+	MappedFile(const std::string &fname, size_t size);
+	~MappedFile();
+	
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+	
+	const unsigned char *data() const { return ptr; }
+	unsigned char *writableData() { return writable ? const_cast<unsigned char*>(ptr) : nullptr; }
+	size_t size() const { return len; }
+	bool isOk() const { return ptr!=nullptr; }
+	bool isWritable() const { return writable; }
+	
+	bool flush(); // read-write only, writes the modified pages now
+	// size to leave the file with when closing a read-write mapping (e.g. to drop
+	// an unused tail), 0 leaves it as mapped
+	void setFinalSize(size_t size) { final_size = size; }
+	
+private:
+	MappedFile(const MappedFile &other) = delete;
+	MappedFile &operator=(const MappedFile &other) = delete;
+	void close();
+	const unsigned char *ptr = nullptr;
+	size_t len = 0, final_size = 0;
+	bool writable = false;
+#ifdef _WIN32
+	void *file_handle = nullptr, *map_handle = nullptr;
+#else
+	int fd = -1; // only kept open for read-write mappings (for final_size)
+#endif
+};
+
+#endif
+
@@ -0,0 +1,62 @@
+#include <atomic>
+#include <iomanip>
+#include "MemoryStats.hpp"
+
+namespace memory_stats {
+
+	namespace {
+		std::atomic<long long> current_bytes[cCount];
+		std::atomic<long long> peak_bytes[cCount];
+	}
+
+	const char *name(Category c) {
+		static const char *names[cCount] = { "Noise maps", "Geometry", "Buffers (VBO/EBO)", "Textures", "ImGui" };
+		return names[c];
+	}
+
+	bool isGpu(Category c) {
+		return c==cBuffers or c==cTextures;
+	}
+
+	void add(Category c, long long bytes) {
+		long long now = (current_bytes[c] += bytes);
+		long long peak = peak_bytes[c].load();
+		while (now>peak and not peak_bytes[c].compare_exchange_weak(peak,now)) { }
+	}
+
+	long long current(Category c) {
+		return current_bytes[c];
+	}
+
+	long long peak(Category c) {
+		return peak_bytes[c];
+	}
+
+	void report(std::ostream &out) {
+		auto flags = out.flags(); auto precision = out.precision();
+		out << std::fixed << std::setprecision(2);
+		for(int i=0;i<cCount;++i) {
+			Category c = static_cast<Category>(i);
+			out << std::left << std::setw(20) << name(c) << std::right << (isGpu(c)?" gpu ":" cpu ")
+				<< std::setw(10) << current(c)/(1024.0*1024.0) << " MB (peak "
+				<< peak(c)/(1024.0*1024.0) << " MB)\n";
+		}
+		out.flags(flags); out.precision(precision);
+	}
+
+}
+
+TrackedBytes &TrackedBytes::operator=(TrackedBytes &&other) {
+	if (this==&other) return *this;
+	size_t b = other.bytes;
+	other.set(0);
+	set(b);
+	return *this;
+}
+
+void TrackedBytes::set(size_t new_bytes) {
+	if (new_bytes==bytes) return;
+	memory_stats::add(category,static_cast<long long>(new_bytes)-static_cast<long long>(bytes));
+	bytes = new_bytes;
+}
+
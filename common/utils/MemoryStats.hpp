@@ -0,0 +1,70 @@
+#ifndef MEMORYSTATS_HPP
+#define MEMORYSTATS_HPP
+
+#include <cstddef>
+#include <new>
+#include <ostream>
+
+// Bytes in use (and the high-water mark) per subsystem. Counters are atomic, they
+// can be updated from loader threads. Memory gets here through TrackingAllocator
+// (for containers) or TrackedBytes (for objects that know what they hold, like gl
+// buffers and textures).
+namespace memory_stats {
+
+	enum Category { cNoiseMaps, cGeometry, cBuffers, cTextures, cImGui, cCount };
+
+	const char *name(Category c);
+	bool isGpu(Category c); // gl buffers and textures
+
+	void add(Category c, long long bytes); // negative to release
+	long long current(Category c);
+	long long peak(Category c);
+
+	// one line per category, current and peak, in MB
+	void report(std::ostream &out);
+}
+
+// std allocator that counts what it holds in category C
+template<typename T, memory_stats::Category C>
+class TrackingAllocator {
+public:
+	using value_type = T;
+	template<typename U> struct rebind { using other = TrackingAllocator<U,C>; };
+	TrackingAllocator() = default;
+	template<typename U> TrackingAllocator(const TrackingAllocator<U,C> &) { }
+	T *allocate(size_t n) {
+		T *p = static_cast<T*>(::operator new(n*sizeof(T)));
+		memory_stats::add(C,n*sizeof(T));
+		return p;
+	}
+	void deallocate(T *p, size_t n) {
+		memory_stats::add(C,-static_cast<long long>(n*sizeof(T)));
+		::operator delete(p);
+	}
+	template<typename U> bool operator==(const TrackingAllocator<U,C> &) const { return true; }
+	template<typename U> bool operator!=(const TrackingAllocator<U,C> &) const { return false; }
+};
+
+// A byte count held in a category while this object lives: copies count again,
+// moves transfer it. Meant to be a member of the object that owns the memory.
+class TrackedBytes {
+public:
+	TrackedBytes(memory_stats::Category c) : category(c) { }
+	TrackedBytes(const TrackedBytes &other) : category(other.category) { set(other.bytes); }
+	TrackedBytes(TrackedBytes &&other) : category(other.category) { size_t b = other.bytes; other.set(0); set(b); }
+	TrackedBytes &operator=(const TrackedBytes &other) { set(other.bytes); return *this; }
+	TrackedBytes &operator=(TrackedBytes &&other);
+	~TrackedBytes() { set(0); }
+	void set(size_t new_bytes);
+	size_t get() const { return bytes; }
+private:
+	memory_stats::Category category;
+	size_t bytes = 0;
+};
+
+// bytes held by a vector (its capacity, not its size)
+template<typename V>
+size_t heldBytes(const V &v) { return v.capacity()*sizeof(typename V::value_type); }
+
+#endif
+
@@ -1,3 +1,12 @@
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#ifdef _WIN32
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <sys/stat.h>
+#endif
 #include "Misc.hpp"
 #include "Debug.hpp"
 
@@ -21,14 +30,72 @@ void fixEOL(std::string &s) {
 		s.erase(s.size()-1);
 }
 
+long long getModificationTime(const std::string &filename) {
+	// with sub-second resolution, so a second save right after a reload is noticed
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (not GetFileAttributesExA(filename.c_str(),GetFileExInfoStandard,&data)) return -1;
+	return (static_cast<long long>(data.ftLastWriteTime.dwHighDateTime)<<32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(filename.c_str(),&st)!=0) return -1;
+#	ifdef __APPLE__
+	return st.st_mtimespec.tv_sec*1000000000LL + st.st_mtimespec.tv_nsec;
+#	else
+	return st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+#	endif
+#endif
+}
+
+// Both functions go over v as a flat array of floats, 4 points (12 floats) per 
+// step into 12 independent lanes (lane k holds coordinate k%3), so the compiler
+// can keep them in vector registers instead of doing a scalar min/max per point.
+static_assert(sizeof(glm::vec3)==3*sizeof(float),"glm::vec3 must be tightly packed");
+
 std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v) {
 	cg_assert(not v.empty(),"Cannot generate Bounding Box for an empty vector");
-	glm::vec3 pmin = v[0], pmax = v[0];
-	for(glm::vec3 p : v) {
-		for(int j=0;j<3;++j) {
-			pmin[j] = std::min(pmin[j],p[j]);
-			pmax[j] = std::max(pmax[j],p[j]);
+	const float *f = &v[0].x;
+	size_t n = v.size()*3, n12 = n-n%12;
+	float lmin[12], lmax[12];
+	for(int k=0;k<12;++k) lmin[k] = lmax[k] = f[k%3];
+	for(size_t i=0;i<n12;i+=12) {
+		for(int k=0;k<12;++k) {
+			float x = f[i+k];
+			lmin[k] = x<lmin[k] ? x : lmin[k];
+			lmax[k] = lmax[k]<x ? x : lmax[k];
 		}
 	}
+	glm::vec3 pmin = v[0], pmax = v[0];
+	for(int k=0;k<12;++k) {
+		pmin[k%3] = std::min(pmin[k%3],lmin[k]);
+		pmax[k%3] = std::max(pmax[k%3],lmax[k]);
+	}
+	for(size_t i=n12;i<n;++i) {
+		pmin[i%3] = std::min(pmin[i%3],f[i]);
+		pmax[i%3] = std::max(pmax[i%3],f[i]);
+	}
 	return {pmin,pmax};
 }
+
+void centerAndResize(std::vector<glm::vec3> &v) {
+	// get global bb
+	glm::vec3 pmin, pmax;
+	std::tie(pmin,pmax) = getBoundingBox(v);
+	
+	// center on 0,0,0 and scale to fit in [-1;+1]^3, in the same pass
+	glm::vec3 center = (pmax+pmin)/2.f;
+	float dmax = 0.f;
+	for(int j=0;j<3;++j)
+		dmax = std::max(dmax, (pmax[j]-pmin[j])/2);
+	if (dmax==0.f) dmax = 1.f; // a single point, just center it
+	float lcenter[12];
+	for(int k=0;k<12;++k) lcenter[k] = center[k%3];
+	float *f = &v[0].x;
+	size_t n = v.size()*3, n12 = n-n%12;
+	for(size_t i=0;i<n12;i+=12)
+		for(int k=0;k<12;++k)
+			f[i+k] = (f[i+k]-lcenter[k])/dmax;
+	for(size_t i=n12;i<n;++i)
+		f[i] = (f[i]-center[i%3])/dmax;
+}
+
@@ -11,7 +11,14 @@ void fixEOL(std::string &s);
 
 bool startsWith(const std::string str, const char *con);
 
+// last modification time of a file, or -1 if it does not exist; only good for
+// comparing with another one (nanoseconds since epoch, 100ns ticks on windows)
+long long getModificationTime(const std::string &filename);
+
 std::pair<glm::vec3,glm::vec3> getBoundingBox(const std::vector<glm::vec3> &v);
 
+// moves v so its bounding box is centered at 0,0,0 and fits in [-1;+1]^3
+void centerAndResize(std::vector<glm::vec3> &v);
+
 #endif
 
@@ -1,49 +1,103 @@
-#include <tuple>
-#include <cmath>
 #include <algorithm>
+#include <chrono>
+#include <exception>
+#include <sstream>
 #include "Model.hpp"
 #include "Debug.hpp"
 #include "ObjMesh.hpp"
 #include "Misc.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
 
-Model Model::loadSingle(const std::string &name, int flags) {
+static double secondsSince(std::chrono::steady_clock::time_point t0) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+// times (if not null) gets the geometry, normals and textures stages added
+static ModelData toModelData(const ObjMesh &obj, const ObjMesh::Part &part, int flags, ModelLoadTimes *times=nullptr) {
+	ModelLoadTimes local;
+	if (not times) times = &local;
+	ModelData data;
+	auto t0 = std::chrono::steady_clock::now();
+	{
+		cg_profile("toGeometry");
+		data.geometry = toGeometry(obj,part);
+	}
+	times->geometry += secondsSince(t0);
+	t0 = std::chrono::steady_clock::now();
+	if (flags&Model::fRegenerateNormals or data.geometry.normals.empty()) {
+		cg_profile("generateNormals");
+		data.geometry.generateNormals();
+	}
+	times->normals += secondsSince(t0);
+	t0 = std::chrono::steady_clock::now();
+	data.material = part.material;
+	if (flags&Model::fNoTextures) data.material.texture.clear();
+	if (not data.material.texture.empty()) {
+		cg_profile("loadTextureCached");
+		data.texture = loadTextureCached(data.material.texture);
+	}
+	times->textures += secondsSince(t0);
+	return data;
+}
+
+ModelData Model::loadDataSingle(const std::string &name, int flags) {
 	ObjMesh obj = readObj("models/"+name+".obj");
 	if (!(flags&fDontFit)) centerAndResize(obj.positions);
-	Geometry geometry = toGeometry(obj,0);
-	if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-	if (flags&fNoTextures) obj.parts[0].material.texture.clear();
-	return Model(std::move(geometry), obj.parts[0].material, flags&fKeepGeometry);
+	return toModelData(obj,obj.parts[0],flags);
 }
 
-std::vector<Model> Model::load(const std::string &name, int flags) {
-	auto obj = readObj("models/"+name+".obj");
-	if (!(flags&fDontFit)) centerAndResize(obj.positions);
+std::vector<ModelData> Model::loadData(const std::string &name, int flags, ModelLoadTimes *times) {
+	cg_profile("Model::loadData");
+	auto t0 = std::chrono::steady_clock::now();
+	ModelLoadTimes t;
+	ObjMesh obj;
+	{
+		cg_profile("readObj");
+		obj = readObj("models/"+name+".obj");
+	}
+	t.read = secondsSince(t0);
+	if (!(flags&fDontFit)) {
+		cg_profile("centerAndResize");
+		auto t1 = std::chrono::steady_clock::now();
+		centerAndResize(obj.positions);
+		t.fit = secondsSince(t1);
+	}
 	
-	std::vector<Model> vret; vret.reserve(obj.parts.size());
-	for (auto &part : obj.parts) {
-		Geometry geometry = toGeometry(obj,part);
-		if (flags&fRegenerateNormals or geometry.normals.empty()) geometry.generateNormals();
-		if (flags&fNoTextures) part.material.texture.clear();
-		vret.emplace_back(std::move(geometry), part.material, flags&fKeepGeometry);
+	// every part is independent (they only read obj), each one goes to a worker
+	t.parts = obj.parts.size();
+	std::vector<ModelData> vret(obj.parts.size());
+	std::vector<ModelLoadTimes> parts_times(obj.parts.size());
+	std::vector<std::exception_ptr> errors(obj.parts.size());
+	ThreadPool::shared().parallelFor(obj.parts.size(),1,[&](int i) {
+		try { vret[i] = toModelData(obj,obj.parts[i],flags,&parts_times[i]); }
+		catch(...) { errors[i] = std::current_exception(); } // parallelFor's func must not throw
+	});
+	for(std::exception_ptr &e : errors) 
+		if (e) std::rethrow_exception(e);
+	for(const ModelLoadTimes &pt : parts_times) {
+		t.geometry += pt.geometry; t.normals += pt.normals; t.textures += pt.textures;
 	}
+	t.total = secondsSince(t0);
+	
+	std::ostringstream info;
+	info << "Loaded " << name << ": " << t.parts << " parts in " << t.total*1000 << " ms (read " << t.read*1000
+		 << ", fit " << t.fit*1000 << ", geometry " << t.geometry*1000 << ", normals " << t.normals*1000 
+		 << ", textures " << t.textures*1000 << ")";
+	cg_info(info.str());
+	if (times) *times = t;
 	return vret;
 }
 
-void centerAndResize(std::vector<glm::vec3> &v) {
-	// get global bb
-	glm::vec3 pmin, pmax;
-	std::tie(pmin,pmax) = getBoundingBox(v);
-	
-	// center on 0,0,0
-	glm::vec3 center = (pmax+pmin)/2.f;
-	for(glm::vec3 &p : v) 
-		p -= center;
-	
-	// scale to fit in [-1;+1]^3
-	float dmax = std::fabs(pmin.x);
-	for(int j=0;j<3;++j)
-		dmax = std::max(dmax, (pmax[j]-pmin[j])/2);
-	for(glm::vec3 &p : v)
-		p /= dmax;
+Model Model::loadSingle(const std::string &name, int flags) {
+	return Model(loadDataSingle(name,flags), flags&fKeepGeometry);
+}
+
+std::vector<Model> Model::load(const std::string &name, int flags) {
+	auto vdata = loadData(name,flags);
+	std::vector<Model> vret; vret.reserve(vdata.size());
+	for (auto &data : vdata)
+		vret.emplace_back(std::move(data), flags&fKeepGeometry);
+	return vret;
 }
 
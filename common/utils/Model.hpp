@@ -1,9 +1,26 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 #include <vector>
-#include "Geometry.hpp"
+#include "GeometryRenderer.hpp"
 #include "Material.hpp"
 #include "Texture.hpp"
+#include "TextureData.hpp"
+
+// cpu-side data for one part of a model (no gl involved, can be loaded from any thread)
+struct ModelData {
+	Geometry geometry;
+	Material material;
+	TextureData texture;
+};
+
+// where the time of Model::loadData went, in seconds (the per-part stages are
+// summed over the parts, that run in parallel, so they can add up to more than total)
+struct ModelLoadTimes {
+	double read = 0, fit = 0;                  // readObj, centerAndResize
+	double geometry = 0, normals = 0, textures = 0; // toGeometry, generateNormals, loadTextureCached
+	double total = 0;
+	int parts = 0;
+};
 
 // auxiliar struct for loading all model-related data
 struct Model {
@@ -25,14 +42,21 @@ struct Model {
 	{
 		if (keep_geometry) geometry = std::move(g);
 	}
+	Model(ModelData &&d, bool keep_geometry=false) 
+		: buffers(d.geometry), material(d.material), 
+		  texture(d.texture.isOk() ? Texture(d.texture) : Texture())
+	{
+		if (keep_geometry) geometry = std::move(d.geometry);
+	}
 	
 	enum Flags { fNone=0, fDontFit=1, fKeepGeometry=2, 
 				 fRegenerateNormals=4, fDynamic=8, fNoTextures=16 };
 	static std::vector<Model> load(const std::string &name, int flags = 0);
 	static Model loadSingle(const std::string &name, int flags = 0);
+	// parts are converted in parallel (ThreadPool::shared), times is optional
+	static std::vector<ModelData> loadData(const std::string &name, int flags = 0, ModelLoadTimes *times = nullptr);
+	static ModelData loadDataSingle(const std::string &name, int flags = 0);
 };
 
-void centerAndResize(std::vector<glm::vec3> &v);
-
 #endif
 
@@ -1,10 +1,13 @@
+#include <exception>
 #include <fstream>
+#include <iterator>
 #include <map>
 #include <algorithm>
 #include <glm/glm.hpp>
 #include "ObjMesh.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
+#include "ThreadPool.hpp"
 #include <unordered_map>
 
 namespace {
@@ -80,72 +83,153 @@ std::map<std::string,Material> loadMaterialsLib(const std::string &path, const s
 
 }
 
+namespace {
+
+ObjMesh::Element readFace(const std::string &line) {
+	ObjMesh::Element e; 
+	int is = 2, in = 0, l = line.size();
+	while(is<l) {
+		cg_assert(in<4,"Face with more than 4 vertexes are not supported yet");
+		e.pos[in] = readInt(line,is)-1;
+		if (line[is]=='/') {
+			if (line[++is]=='/') {
+				e.tcs[in] = -1;
+				e.norms[in] = readInt(line,++is)-1;
+			} else {
+				e.tcs[in] = readInt(line,is)-1;
+				if (line[is]=='/') {
+					e.norms[in] = readInt(line,++is)-1;
+				} else {
+					e.norms[in] = -1;
+				}
+			}
+		} else {
+			e.tcs[in] = -1;
+			e.norms[in] = -1;
+		}
+		++in;
+	}
+	cg_assert(in>2,"Face with less than 3 vertexes");
+	if (in==3) e.pos[3] = e.norms[3] = e.tcs[3] = -1;
+	return e;
+}
+
+// What a piece of the file has, parsed on its own: the data lines go straight
+// to the arrays, and records keep the order of faces and commands (o, usemtl...)
+// so the parts can be built afterwards as if the file was read line by line.
+struct ObjChunk {
+	enum RecordType { rData, rFaces, rCommand, rError };
+	struct Record {
+		RecordType type;
+		int count; // lines of data or faces in a row
+		std::string line; // the command
+	};
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> tex_coords;
+	std::vector<ObjMesh::Element> faces;
+	std::vector<Record> records;
+	std::exception_ptr error; // the line that threw ends the chunk (rError)
+	
+	void parse(const std::string &text, size_t begin, size_t end) {
+		try {
+			while(begin<end) {
+				size_t eol = std::min(text.find('\n',begin),end);
+				std::string line = text.substr(begin,eol-begin);
+				begin = eol+1;
+				if (line.empty() or line[0]=='#') continue;
+				if (startsWith(line,"v ")) {
+					positions.push_back(readVec3(line,2)); add(rData);
+				} else if (startsWith(line,"vn ")) {
+					normals.push_back(readVec3(line,3)); add(rData);
+				} else if (startsWith(line,"vt ")) {
+					tex_coords.push_back(readVec2(line,3)); add(rData);
+				} else if (startsWith(line,"f ")) {
+					faces.push_back(readFace(line)); add(rFaces);
+				} else {
+					records.push_back({rCommand,1,line});
+				}
+			}
+		} catch(...) {
+			error = std::current_exception();
+			records.push_back({rError,0,""});
+		}
+	}
+	
+private:
+	void add(RecordType type) {
+		if (records.empty() or records.back().type!=type) records.push_back({type,0,""});
+		++records.back().count;
+	}
+};
+
+}
+
 ObjMesh readObj(const std::string &full_path) {
 	cg_info( "Reading obj file: " + full_path + "..." );
 	std::string path = extractFolder(full_path);
 	std::ifstream file(full_path);
 	cg_assert(file.is_open(),"Could not open obj file");
+	std::string text((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
+	
+	// cut in pieces of about 256KB at line ends, and parse them in parallel
+	const size_t chunk_size = 256*1024;
+	std::vector<size_t> cuts = {0};
+	while(cuts.back()<text.size()) {
+		size_t next = cuts.back()+chunk_size;
+		next = next>=text.size() ? text.size() : std::min(text.find('\n',next),text.size()-1)+1;
+		cuts.push_back(next);
+	}
+	std::vector<ObjChunk> chunks(cuts.size()-1);
+	ThreadPool::shared().parallelFor(chunks.size(),1,[&](int i){
+		chunks[i].parse(text,cuts[i],cuts[i+1]);
+	});
 	
 	ObjMesh meshes;
-	ObjMesh::Part *current_part = nullptr;
+	size_t total_positions = 0, total_normals = 0, total_tex_coords = 0;
+	for(const ObjChunk &c : chunks) {
+		total_positions += c.positions.size();
+		total_normals += c.normals.size();
+		total_tex_coords += c.tex_coords.size();
+	}
+	meshes.positions.reserve(total_positions);
+	meshes.normals.reserve(total_normals);
+	meshes.tex_coords.reserve(total_tex_coords);
+	
+	// then put the pieces together in order
+	int current_part = -1;
 	std::map<std::string,Material> materials_lib;
 	std::string current_name;
-	
-	for(std::string line; std::getline(file,line); ) {
-		if (line.empty() or line[0]=='#') continue;
-		if (startsWith(line,"o ")) {
-			meshes.parts.push_back({}); 
-			current_part = &meshes.parts.back();
-			current_name = current_part->name = line.substr(2);
-		} else if (startsWith(line,"mtllib ")) {
-			materials_lib = loadMaterialsLib(path,line.substr(7));
-		} else {
-			if (not current_part) {
-				meshes.parts.push_back({});
-				current_part = &meshes.parts.back();
-			}
-			if (startsWith(line,"v ")) {
-				meshes.positions.push_back(readVec3(line,2));
-			} else if (startsWith(line,"vn ")) {
-				meshes.normals.push_back(readVec3(line,3));
-			} else if (startsWith(line,"vt ")) {
-				meshes.tex_coords.push_back(readVec2(line,3));
-			} else if (startsWith(line,"f ")) {
-				ObjMesh::Element e; 
-				int is = 2, in = 0, l = line.size();
-				while(is<l) {
-					cg_assert(in<4,"Face with more than 4 vertexes are not supported yet");
-					e.pos[in] = readInt(line,is)-1;
-					if (line[is]=='/') {
-						if (line[++is]=='/') {
-							e.tcs[in] = -1;
-							e.norms[in] = readInt(line,++is)-1;
-						} else {
-							e.tcs[in] = readInt(line,is)-1;
-							if (line[is]=='/') {
-								e.norms[in] = readInt(line,++is)-1;
-							} else {
-								e.norms[in] = -1;
-							}
-						}
-					} else {
-						e.tcs[in] = -1;
-						e.norms[in] = -1;
+	auto newPart = [&]() {
+		meshes.parts.push_back({}); 
+		current_part = meshes.parts.size()-1;
+	};
+	for(const ObjChunk &c : chunks) {
+		meshes.positions.insert(meshes.positions.end(),c.positions.begin(),c.positions.end());
+		meshes.normals.insert(meshes.normals.end(),c.normals.begin(),c.normals.end());
+		meshes.tex_coords.insert(meshes.tex_coords.end(),c.tex_coords.begin(),c.tex_coords.end());
+		auto face = c.faces.begin();
+		for(const ObjChunk::Record &r : c.records) {
+			if (r.type==ObjChunk::rError) std::rethrow_exception(c.error);
+			const std::string &line = r.line;
+			if (r.type==ObjChunk::rCommand and startsWith(line,"o ")) {
+				newPart();
+				current_name = meshes.parts.back().name = line.substr(2);
+			} else if (r.type==ObjChunk::rCommand and startsWith(line,"mtllib ")) {
+				materials_lib = loadMaterialsLib(path,line.substr(7));
+			} else {
+				if (current_part==-1) newPart();
+				ObjMesh::Part &part = meshes.parts[current_part];
+				if (r.type==ObjChunk::rFaces) {
+					part.elements.insert(part.elements.end(),face,face+r.count);
+					face += r.count;
+				} else if (r.type==ObjChunk::rCommand and startsWith(line,"usemtl ")) {
+					if (not part.elements.empty()) newPart();
+					ObjMesh::Part &named = meshes.parts[current_part];
+					named.name = current_name+":"+line.substr(7);
+					if  (line.substr(7)!="None") {
+						cg_assert(materials_lib.count(line.substr(7)),"Material not found: "+line.substr(7));
+						named.material = materials_lib[line.substr(7)];
 					}
-					++in;
-				}
-				cg_assert(in>2,"Face with less than 3 vertexes");
-				if (in==3) e.pos[3] = e.norms[3] = e.tcs[3] = -1;
-				current_part->elements.push_back(e);
-			} else if (startsWith(line,"usemtl ")) {
-				if (not current_part->elements.empty()) {
-					meshes.parts.push_back({}); 
-					current_part = &meshes.parts.back();
-				}
-				current_part->name = current_name+":"+line.substr(7);
-				if  (line.substr(7)!="None") {
-					cg_assert(materials_lib.count(line.substr(7)),"Material not found: "+line.substr(7));
-					current_part->material = materials_lib[line.substr(7)];
 				}
 			}
 		}
@@ -200,6 +284,7 @@ Geometry toGeometry(const ObjMesh &obj, const ObjMesh::Part &part) {
 		if (e.pos[3]==-1) continue;
 		addVertex(e,0); addVertex(e,2); addVertex(e,3);
 	}
+	g.trackMemory();
 	return g;
 }
 
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+#include "PngWriter.hpp"
+#include "Debug.hpp"
+
+namespace {
+	
+	uint32_t crc32(const unsigned char *data, size_t len, uint32_t crc=0) {
+		static const std::vector<uint32_t> table = [](){
+			std::vector<uint32_t> t(256);
+			for(uint32_t n=0;n<256;++n) {
+				uint32_t c = n;
+				for(int k=0;k<8;++k) c = (c&1) ? 0xEDB88320u^(c>>1) : c>>1;
+				t[n] = c;
+			}
+			return t;
+		}();
+		crc = ~crc;
+		for(size_t i=0;i<len;++i) crc = table[(crc^data[i])&0xFF]^(crc>>8);
+		return ~crc;
+	}
+	
+	void putU32(std::vector<unsigned char> &v, uint32_t x) {
+		v.push_back(x>>24); v.push_back(x>>16); v.push_back(x>>8); v.push_back(x);
+	}
+	
+	void writeChunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data) {
+		std::vector<unsigned char> chunk;
+		putU32(chunk,data.size());
+		chunk.insert(chunk.end(),type,type+4);
+		chunk.insert(chunk.end(),data.begin(),data.end());
+		putU32(chunk,crc32(chunk.data()+4,chunk.size()-4));
+		file.write(reinterpret_cast<const char*>(chunk.data()),chunk.size());
+	}
+	
+}
+
+bool savePNG(const std::string &fname, int width, int height, int channels, int bit_depth, const void *data) {
+	cg_assert(channels>=1 and channels<=4 and (bit_depth==8 or bit_depth==16),"Unsupported png format");
+	static const unsigned char color_types[] = { 0, 4, 2, 6 };
+	
+	// raw scanlines: filter type 0 (none) + samples in big endian
+	size_t bytes_per_row = size_t(width)*channels*(bit_depth/8);
+	std::vector<unsigned char> raw;
+	raw.reserve((bytes_per_row+1)*height);
+	for(int y=0;y<height;++y) {
+		raw.push_back(0);
+		if (bit_depth==8) {
+			const unsigned char *row = static_cast<const unsigned char*>(data)+y*bytes_per_row;
+			raw.insert(raw.end(),row,row+bytes_per_row);
+		} else {
+			const uint16_t *row = static_cast<const uint16_t*>(data)+size_t(y)*width*channels;
+			for(size_t i=0;i<size_t(width)*channels;++i) { raw.push_back(row[i]>>8); raw.push_back(row[i]&0xFF); }
+		}
+	}
+	
+	// zlib stream with stored blocks (at most 65535 bytes each) + adler32
+	std::vector<unsigned char> idat = { 0x78, 0x01 };
+	uint32_t a = 1, b = 0;
+	for(size_t pos=0; pos<raw.size() or pos==0; ) {
+		size_t len = std::min<size_t>(65535,raw.size()-pos);
+		bool last = pos+len==raw.size();
+		idat.push_back(last?1:0);
+		idat.push_back(len&0xFF); idat.push_back(len>>8);
+		idat.push_back(~len&0xFF); idat.push_back((~len>>8)&0xFF);
+		for(size_t i=pos;i<pos+len;++i) { a = (a+raw[i])%65521; b = (b+a)%65521; }
+		idat.insert(idat.end(),raw.begin()+pos,raw.begin()+pos+len);
+		pos += len;
+		if (last) break;
+	}
+	putU32(idat,(b<<16)|a);
+	
+	std::vector<unsigned char> ihdr;
+	putU32(ihdr,width); putU32(ihdr,height);
+	ihdr.push_back(bit_depth); ihdr.push_back(color_types[channels-1]);
+	ihdr.push_back(0); ihdr.push_back(0); ihdr.push_back(0); // deflate, adaptive filters, no interlace
+	
+	std::ofstream file(fname,std::ios::binary|std::ios::trunc);
+	if (not file.is_open()) return false;
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature),8);
+	writeChunk(file,"IHDR",ihdr);
+	writeChunk(file,"IDAT",idat);
+	writeChunk(file,"IEND",{});
+	return file.good();
+}
+
@@ -0,0 +1,13 @@
+#ifndef PNGWRITER_HPP
+#define PNGWRITER_HPP
+
+#include <string>
+
+// Writes a png with 1 (gray), 2 (gray+alpha), 3 (rgb) or 4 (rgba) channels of 8
+// or 16 bits (16 bits samples in native uint16_t, converted to png's big endian
+// here), rows from the top. Pixel data is stored without compression (deflate 
+// "stored" blocks), so this is fast and simple but files are big.
+bool savePNG(const std::string &fname, int width, int height, int channels, int bit_depth, const void *data);
+
+#endif
+
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <imgui.h>
+#include "Profiler.hpp"
+#include "Debug.hpp"
+
+namespace {
+
+	struct OpenScope { const char *name; double start; };
+	thread_local std::vector<OpenScope> cpu_stack; // per thread, so depth is per thread too
+
+	std::string jsonEscape(const char *s) {
+		std::string ret;
+		for(;*s;++s) {
+			if (*s=='"' or *s=='\\') ret += '\\';
+			ret += *s;
+		}
+		return ret;
+	}
+
+	ImU32 colorFor(const char *name) { // stable color for each scope name
+		unsigned h = 2166136261u;
+		for(const char *c=name;*c;++c) h = (h^static_cast<unsigned char>(*c))*16777619u;
+		return IM_COL32(80+h%120,80+(h>>8)%120,80+(h>>16)%120,255);
+	}
+
+}
+
+Profiler &Profiler::get() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler(int capacity) : t0(std::chrono::steady_clock::now()), ring(capacity) {
+	current.number = 0;
+}
+
+Profiler::~Profiler() {
+	// the context may be gone by now, queries die with it
+}
+
+double Profiler::now() const {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+int Profiler::threadIndex() {
+	static std::atomic<int> count{0};
+	thread_local int index = count++;
+	return index;
+}
+
+void Profiler::beginCpu(const char *name) {
+	if (not recording()) return;
+	cpu_stack.push_back({name,now()});
+}
+
+void Profiler::endCpu() {
+	if (cpu_stack.empty()) return; // may have been enabled inside a scope
+	Event e { cpu_stack.back().name, cpu_stack.back().start, now(), int(cpu_stack.size())-1, threadIndex() };
+	cpu_stack.pop_back();
+	std::lock_guard<std::mutex> lock(mutex);
+	current.events.push_back(e);
+}
+
+GLuint Profiler::newQuery() {
+	if (free_queries.empty()) {
+		GLuint q; glGenQueries(1,&q);
+		return q;
+	}
+	GLuint q = free_queries.back();
+	free_queries.pop_back();
+	return q;
+}
+
+void Profiler::calibrateGpuClock() {
+	// a timestamp query is relative to some unknown gpu time, this maps it to ours
+	GLint64 gpu_ns = 0;
+	glGetInteger64v(GL_TIMESTAMP,&gpu_ns);
+	double t = now();
+	gpu_offset = t - gpu_ns*1e-9;
+	last_calibration = t;
+}
+
+void Profiler::beginGpu(const char *name) {
+	if (not recording()) return;
+	if (last_calibration<0 or now()-last_calibration>1.0) calibrateGpuClock(); // clocks drift
+	std::lock_guard<std::mutex> lock(mutex);
+	gpu_stack.push_back(current.events.size());
+	current.events.push_back({name,0.0,0.0,int(gpu_stack.size())-1,-1});
+	current.query_events.push_back(current.events.size()-1);
+	GLuint q = newQuery();
+	glQueryCounter(q,GL_TIMESTAMP);
+	current.queries.push_back(q);
+	current.queries.push_back(0); // end, filled by endGpu
+}
+
+void Profiler::endGpu() {
+	if (gpu_stack.empty()) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t ev = gpu_stack.back();
+	gpu_stack.pop_back();
+	auto it = std::find(current.query_events.begin(),current.query_events.end(),ev);
+	cg_assert(it!=current.query_events.end(),"Unmatched gpu profiler scope");
+	GLuint q = newQuery();
+	glQueryCounter(q,GL_TIMESTAMP);
+	current.queries[2*(it-current.query_events.begin())+1] = q;
+}
+
+void Profiler::readQueries(Frame &f, bool wait) {
+	if (f.queries.empty()) return;
+	if (not wait) { // the last one is the last to finish
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(f.queries.back(),GL_QUERY_RESULT_AVAILABLE,&available);
+		if (not available) return;
+	}
+	for(size_t i=0;i<f.query_events.size();++i) {
+		GLuint64 begin_ns = 0, end_ns = 0;
+		glGetQueryObjectui64v(f.queries[2*i],GL_QUERY_RESULT,&begin_ns);
+		glGetQueryObjectui64v(f.queries[2*i+1],GL_QUERY_RESULT,&end_ns);
+		Event &e = f.events[f.query_events[i]];
+		e.start = begin_ns*1e-9 + gpu_offset;
+		e.end = end_ns*1e-9 + gpu_offset;
+	}
+	free_queries.insert(free_queries.end(),f.queries.begin(),f.queries.end());
+	f.queries.clear();
+	f.query_events.clear();
+}
+
+void Profiler::newFrame() {
+	double t = now();
+	for(Frame &f : ring) readQueries(f,false);
+	std::lock_guard<std::mutex> lock(mutex);
+	cg_assert(gpu_stack.empty(),"Gpu profiler scope open at the end of a frame");
+	current.end = t;
+	long long number = current.number+1;
+	if (recording() and current.number>0) { // the first one started in the middle of the frame
+		Frame &slot = ring[ring_next];
+		readQueries(slot,true); // very unlikely to block, it is many frames old
+		std::swap(slot,current);
+		ring_next = (ring_next+1)%ring.size();
+		ring_count = std::min<int>(ring_count+1,ring.size());
+	} else
+		readQueries(current,true);
+	current.events.clear();
+	current.number = number;
+	current.start = t;
+}
+
+int Profiler::framesCount() const {
+	return ring_count;
+}
+
+const Profiler::Frame &Profiler::frame(int i) const {
+	return ring[(ring_next-ring_count+i+ring.size())%ring.size()];
+}
+
+void Profiler::drawImGui(const char *title) {
+	if (not ImGui::Begin(title)) { ImGui::End(); return; }
+	bool enable = enabled, pause = paused;
+	if (ImGui::Checkbox("Enabled",&enable)) enabled = enable;
+	ImGui::SameLine();
+	if (ImGui::Checkbox("Pause",&pause)) paused = pause;
+	ImGui::SameLine();
+	static std::string export_message;
+	if (ImGui::Button("Export trace")) {
+		export_message = exportChromeTrace("profile_trace.json")
+			? "Saved to profile_trace.json" : "Could not write profile_trace.json";
+	}
+	if (not export_message.empty()) { ImGui::SameLine(); ImGui::TextUnformatted(export_message.c_str()); }
+
+	int n = framesCount();
+	if (n==0) { ImGui::End(); return; }
+	std::vector<float> times(n);
+	for(int i=0;i<n;++i) times[i] = frame(i).duration()*1000.f;
+	ImGui::PlotHistogram("##frames",times.data(),n,0,"frame ms",0.f,
+						 *std::max_element(times.begin(),times.end()),ImVec2(0,60));
+	if (selected>=n) selected = -1;
+	ImGui::SliderInt("Frame (-1 = last)",&selected,-1,n-1);
+	const Frame &f = frame(selected==-1?n-1:selected);
+	ImGui::Text("Frame %lld: %.2f ms",f.number,f.duration()*1000.0);
+
+	// timeline: one row per depth for each thread, gpu rows at the end
+	double t_begin = f.start, t_end = f.end;
+	std::map<int,int> rows; // thread -> max depth
+	for(const Event &e : f.events) {
+		if (e.end<=e.start) continue; // gpu result not there yet
+		t_begin = std::min(t_begin,e.start); t_end = std::max(t_end,e.end);
+		int key = e.thread==-1 ? 1<<30 : e.thread;
+		rows[key] = std::max(rows[key],e.depth+1);
+	}
+	std::map<int,int> first_row;
+	int total_rows = 0;
+	for(auto &r : rows) { first_row[r.first] = total_rows; total_rows += r.second; }
+
+	const float row_h = ImGui::GetTextLineHeightWithSpacing();
+	ImVec2 pos = ImGui::GetCursorScreenPos();
+	float width = std::max(ImGui::GetContentRegionAvail().x,100.f);
+	ImGui::InvisibleButton("##timeline",ImVec2(width,std::max(total_rows,1)*row_h));
+	ImDrawList *draw = ImGui::GetWindowDrawList();
+	double scale = width/std::max(t_end-t_begin,1e-9);
+	for(const Event &e : f.events) {
+		if (e.end<=e.start) continue;
+		int row = first_row[e.thread==-1 ? 1<<30 : e.thread] + e.depth;
+		ImVec2 a(pos.x+float((e.start-t_begin)*scale), pos.y+row*row_h);
+		ImVec2 b(std::max(a.x+1.f,pos.x+float((e.end-t_begin)*scale)), a.y+row_h-1.f);
+		draw->AddRectFilled(a,b,e.thread==-1 ? IM_COL32(200,90,60,255) : colorFor(e.name));
+		if (b.x-a.x>ImGui::CalcTextSize(e.name).x+4)
+			draw->AddText(ImVec2(a.x+2,a.y),IM_COL32(255,255,255,255),e.name);
+		if (ImGui::IsMouseHoveringRect(a,b))
+			ImGui::SetTooltip("%s%s: %.3f ms",e.thread==-1?"[gpu] ":"",e.name,(e.end-e.start)*1000.0);
+	}
+
+	// totals per scope name in this frame
+	std::map<std::string,std::pair<double,double>> totals; // cpu, gpu
+	for(const Event &e : f.events) {
+		if (e.end<=e.start) continue;
+		(e.thread==-1 ? totals[e.name].second : totals[e.name].first) += (e.end-e.start)*1000.0;
+	}
+	ImGui::Columns(3);
+	ImGui::Text("Scope"); ImGui::NextColumn(); ImGui::Text("CPU ms"); ImGui::NextColumn(); ImGui::Text("GPU ms"); ImGui::NextColumn();
+	for(auto &t : totals) {
+		ImGui::TextUnformatted(t.first.c_str()); ImGui::NextColumn();
+		ImGui::Text("%.3f",t.second.first); ImGui::NextColumn();
+		ImGui::Text("%.3f",t.second.second); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::End();
+}
+
+bool Profiler::exportChromeTrace(const std::string &fname) const {
+	std::ofstream file(fname);
+	if (not file.is_open()) return false;
+	file << std::fixed << std::setprecision(3); // microseconds, the default would go to 1e+08 after 100 s
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+	auto write = [&](const char *name, const char *cat, double start, double end, int tid, long long frame) {
+		file << (first?"":",\n") << "{\"name\":\"" << jsonEscape(name) << "\",\"cat\":\"" << cat
+			 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+			 << ",\"ts\":" << start*1e6 << ",\"dur\":" << (end-start)*1e6
+			 << ",\"args\":{\"frame\":" << frame << "}}";
+		first = false;
+	};
+	std::lock_guard<std::mutex> lock(mutex);
+	for(int i=0;i<ring_count;++i) {
+		const Frame &f = frame(i);
+		write("frame","frame",f.start,f.end,1000,f.number);
+		for(const Event &e : f.events) {
+			if (e.end<=e.start) continue;
+			write(e.name,e.thread==-1?"gpu":"cpu",e.start,e.end,e.thread==-1?1001:e.thread,f.number);
+		}
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"threads\":\"0..n cpu threads, 1000 frames, 1001 gpu\"}}\n";
+	return file.good();
+}
+
@@ -0,0 +1,98 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// Frame profiler: nested cpu scopes (from any thread) and gpu scopes (timestamp
+// queries, only in the thread with the main context). The last frames are kept in
+// a ring buffer, gpu results are read a few frames later when they are ready.
+// Use it through the cg_profile/cg_profile_gpu macros.
+class Profiler {
+public:
+	static Profiler &get();
+
+	struct Event {
+		const char *name; // must be a literal (or live as long as the profiler)
+		double start, end; // seconds since the profiler was created
+		int depth, thread; // thread -1 is the gpu
+	};
+	struct Frame {
+		long long number = -1;
+		double start = 0, end = 0;
+		std::vector<Event> events;
+		std::vector<GLuint> queries; // two per gpu event, not read yet
+		std::vector<size_t> query_events;
+		double duration() const { return end-start; }
+	};
+
+	void newFrame(); // closes the current frame, and reads finished gpu queries
+
+	void beginCpu(const char *name);
+	void endCpu();
+	void beginGpu(const char *name);
+	void endGpu();
+
+	bool recording() const { return enabled and not paused; }
+	bool isEnabled() const { return enabled; }
+	void setEnabled(bool enable) { enabled = enable; }
+
+	// finished frames, oldest first (i<framesCount())
+	int framesCount() const;
+	const Frame &frame(int i) const;
+
+	// window with frame times and the timeline of one frame
+	void drawImGui(const char *title = "Profiler");
+
+	// all frames in the ring, for chrome://tracing or ui.perfetto.dev
+	bool exportChromeTrace(const std::string &fname) const;
+
+	~Profiler();
+private:
+	Profiler(int capacity = 240);
+	Profiler(const Profiler &) = delete;
+	Profiler &operator=(const Profiler &) = delete;
+
+	double now() const;
+	int threadIndex();
+	GLuint newQuery();
+	void readQueries(Frame &f, bool wait);
+	void calibrateGpuClock();
+
+	std::chrono::steady_clock::time_point t0;
+	mutable std::mutex mutex; // for cpu events from other threads
+	std::vector<Frame> ring;
+	int ring_next = 0, ring_count = 0;
+	Frame current;
+	std::vector<GLuint> free_queries;
+	std::vector<size_t> gpu_stack;
+	double gpu_offset = 0, last_calibration = -1;
+	std::atomic<bool> enabled{true}, paused{false}; // set from the ui, read by the workers
+	int selected = -1; // in the imgui panel
+};
+
+class ProfileScope {
+public:
+	ProfileScope(const char *name) { Profiler::get().beginCpu(name); }
+	~ProfileScope() { Profiler::get().endCpu(); }
+};
+
+class GpuProfileScope {
+public:
+	GpuProfileScope(const char *name) { Profiler::get().beginCpu(name); Profiler::get().beginGpu(name); }
+	~GpuProfileScope() { Profiler::get().endGpu(); Profiler::get().endCpu(); }
+};
+
+#define cg_profile__cat2(a,b) a##b
+#define cg_profile__cat(a,b) cg_profile__cat2(a,b)
+// times the rest of the enclosing block
+#define cg_profile(name) ProfileScope cg_profile__cat(cg_profile_scope_,__LINE__)(name)
+// same, and also the gl commands issued in it
+#define cg_profile_gpu(name) GpuProfileScope cg_profile__cat(cg_profile_scope_,__LINE__)(name)
+
+#endif
+
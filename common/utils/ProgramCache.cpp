@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "ProgramCache.hpp"
+#include "GLExtensions.hpp"
+
+namespace {
+	
+	const char file_magic[4] = {'C','G','P','B'};
+	const uint32_t file_version = 1;
+	
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t format;
+		uint32_t length;
+	};
+	
+	uint64_t hashBytes(const char *str, size_t len, uint64_t h=14695981039346656037ull) { // 64 bits fnv-1a
+		for(size_t i=0;i<len;++i) h = (h^static_cast<unsigned char>(str[i]))*1099511628211ull;
+		return h;
+	}
+	
+	uint64_t hashString(const std::string &str, uint64_t h) {
+		h = hashBytes(str.data(),str.size(),h);
+		return hashBytes("",1,h); // separator, so "ab"+"c" != "a"+"bc"
+	}
+	
+	std::string fileName(const std::string &path) {
+		auto p = path.find_last_of("/\\");
+		return p==std::string::npos ? path : path.substr(p+1);
+	}
+	
+}
+
+uint64_t programCacheKey(const std::string &vertex_source, const std::string &fragment_source) {
+	static const uint64_t driver_hash = [](){
+		uint64_t h = hashBytes("",0);
+		for(GLenum e : {GL_VENDOR,GL_RENDERER,GL_VERSION}) {
+			const GLubyte *str = glGetString(e);
+			h = hashString(str ? reinterpret_cast<const char*>(str) : "",h);
+		}
+		return h;
+	}();
+	return hashString(fragment_source,hashString(vertex_source,driver_hash));
+}
+
+std::string programBinaryName(const std::string &vertex_fname, const std::string &fragment_fname,
+							  const std::vector<std::string> &defines) 
+{
+	std::string name = vertex_fname+"+"+fileName(fragment_fname);
+	for(const std::string &d : defines) name += "+"+d;
+	return name+".cgprog";
+}
+
+void prepareProgramBinary(GLuint program_id) {
+	const GLExtensionFunctions &ext = glExtensionFunctions();
+	if (ext.hasProgramBinary() and ext.programParameteri)
+		ext.programParameteri(program_id,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+}
+
+bool loadProgramBinary(GLuint program_id, const std::string &fname, uint64_t key) {
+	const GLExtensionFunctions &ext = glExtensionFunctions();
+	if (not ext.hasProgramBinary()) return false;
+	
+	std::ifstream file(fname,std::ios::binary);
+	if (not file.is_open()) return false;
+	FileHeader header;
+	if (not file.read(reinterpret_cast<char*>(&header),sizeof(header))) return false;
+	if (not std::equal(file_magic,file_magic+4,header.magic) or header.version!=file_version 
+		or header.key!=key or header.length==0) return false;
+	std::vector<char> binary(header.length);
+	if (not file.read(binary.data(),binary.size())) return false;
+	
+	ext.programBinary(program_id,header.format,binary.data(),binary.size());
+	GLint result = GL_FALSE;
+	glGetProgramiv(program_id,GL_LINK_STATUS,&result);
+	return result==GL_TRUE;
+}
+
+bool saveProgramBinary(GLuint program_id, const std::string &fname, uint64_t key) {
+	const GLExtensionFunctions &ext = glExtensionFunctions();
+	if (not ext.hasProgramBinary()) return false;
+	
+	GLint length = 0;
+	glGetProgramiv(program_id,GL_PROGRAM_BINARY_LENGTH,&length);
+	if (length<=0) return false;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	ext.getProgramBinary(program_id,length,&length,&format,binary.data());
+	if (length<=0) return false;
+	
+	FileHeader header;
+	std::copy(file_magic,file_magic+4,header.magic);
+	header.version = file_version;
+	header.key = key;
+	header.format = format;
+	header.length = length;
+	
+	// same as baked textures: temporary file + rename, never a partial file
+	std::string tmp_name = fname+"."+std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))+".tmp";
+	{
+		std::ofstream file(tmp_name,std::ios::binary|std::ios::trunc);
+		if (not file.is_open()) return false;
+		file.write(reinterpret_cast<const char*>(&header),sizeof(header));
+		file.write(binary.data(),length);
+		if (not file.good()) { file.close(); std::remove(tmp_name.c_str()); return false; }
+	}
+	if (std::rename(tmp_name.c_str(),fname.c_str())!=0) {
+		std::remove(fname.c_str()); // windows does not replace existing files
+		if (std::rename(tmp_name.c_str(),fname.c_str())!=0) { std::remove(tmp_name.c_str()); return false; }
+	}
+	return true;
+}
+
@@ -0,0 +1,95 @@
+#include "ShaderLibrary.hpp"
+#include "Debug.hpp"
+#include "Misc.hpp"
+
+Shader &ShaderLibrary::add(const std::string &vertex_fname, const std::string &fragment_fname, const std::vector<std::string> &defines) {
+	programs.push_back({std::unique_ptr<Shader>(new Shader()),vertex_fname,fragment_fname,defines});
+	return *programs.back().shader;
+}
+
+bool ShaderLibrary::getSource(const std::string &fname, std::string &source) {
+	auto it = files.find(fname);
+	if (it!=files.end()) { source = it->second.source; return it->second.ok; }
+	// stored even if it fails, so poll keeps watching it (and its includes)
+	File file;
+	file.mtime = getModificationTime(fname);
+	file.ok = preprocessShader(fname,[&](const std::string &include, std::string &included) {
+		file.includes.push_back(include);
+		return getSource(include,included);
+	},file.source);
+	File &stored = files[fname] = std::move(file);
+	source = stored.source;
+	return stored.ok;
+}
+
+void ShaderLibrary::loadAll() {
+	std::vector<Shader::Source> sources;
+	for(Program &p : programs) 
+		if (p.shader->getProgramId()==0)
+			sources.push_back({p.shader.get(),p.vertex_fname,p.fragment_fname,p.defines});
+	bool ok = Shader::tryLoadAll(sources,[&](const std::string &fname, std::string &source) { return getSource(fname,source); });
+	cg_assert(ok,"Failed to load shader programs");
+	last_poll = std::chrono::steady_clock::now();
+}
+
+bool ShaderLibrary::isDirty(const std::string &fname, const std::set<std::string> &changed, std::map<std::string,bool> &memo) const {
+	auto m = memo.find(fname);
+	if (m!=memo.end()) return m->second;
+	bool dirty = changed.count(fname);
+	memo[fname] = dirty; // in case of include cycles
+	auto it = files.find(fname);
+	if (not dirty and it!=files.end()) {
+		for(const std::string &include : it->second.includes)
+			if (isDirty(include,changed,memo)) { dirty = true; break; }
+	}
+	return memo[fname] = dirty;
+}
+
+int ShaderLibrary::poll(double interval) {
+	auto now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<double>(now-last_poll).count()<interval) return 0;
+	last_poll = now;
+	
+	std::set<std::string> changed;
+	for(const auto &p : files) {
+		long long mtime = getModificationTime(p.first);
+		if (mtime==-1 and p.second.mtime!=-1) return 0; // probably being saved right now, try again later
+		if (mtime!=p.second.mtime) changed.insert(p.first);
+	}
+	if (changed.empty()) return 0;
+	
+	// everything that includes a changed file must be preprocessed again
+	std::map<std::string,bool> memo;
+	std::vector<Program*> affected;
+	for(Program &p : programs)
+		if (isDirty(p.vertex_fname,changed,memo) or isDirty(p.fragment_fname,changed,memo))
+			affected.push_back(&p);
+	for(const auto &m : memo) 
+		if (m.second) files.erase(m.first);
+	for(const std::string &fname : changed) // e.g. an include that was missing and no one reaches now
+		files.erase(fname);
+	
+	int count = 0;
+	for(Program *p : affected) {
+		cg_info("Reloading shaders: " + p->vertex_fname + " " + p->fragment_fname);
+		Shader shader;
+		if (Shader::tryLoadAll({{&shader,p->vertex_fname,p->fragment_fname,p->defines}},
+							   [&](const std::string &fname, std::string &source) { return getSource(fname,source); })) 
+		{
+			*p->shader = std::move(shader);
+			++count;
+		} else
+			cg_info("Keeping the previous version of the program");
+	}
+	return count;
+}
+
+std::vector<std::string> ShaderLibrary::includedBy(const std::string &fname) const {
+	std::vector<std::string> ret;
+	for(const auto &p : files) {
+		for(const std::string &include : p.second.includes)
+			if (include==fname) { ret.push_back(p.first); break; }
+	}
+	return ret;
+}
+
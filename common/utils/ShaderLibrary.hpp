@@ -0,0 +1,48 @@
+#ifndef SHADERLIBRARY_HPP
+#define SHADERLIBRARY_HPP
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Shaders.hpp"
+
+// Owns a set of programs and watches their files. Preprocessed sources are cached
+// per file, together with the include graph, so when a file changes only the 
+// programs that (directly or not) depend on it are rebuilt. A rebuilt program 
+// replaces the old one only if it compiles and links, otherwise the old one stays.
+class ShaderLibrary {
+public:
+	// the returned reference is valid as long as the library
+	Shader &add(const std::string &vertex_fname, const std::string &fragment_fname, 
+				const std::vector<std::string> &defines = {});
+	Shader &add(const std::string &fname, const std::vector<std::string> &defines = {}) { 
+		return add(fname+".vert",fname+".frag",defines); 
+	}
+	
+	// first load of everything added so far, in one batch (see Shader::loadAll)
+	void loadAll();
+	
+	// checks modification times (at most every interval seconds) and rebuilds 
+	// whatever needs it, returns the number of programs replaced
+	int poll(double interval = 0.5);
+	
+	// files that include that one, directly
+	std::vector<std::string> includedBy(const std::string &fname) const;
+	
+private:
+	struct Program { std::unique_ptr<Shader> shader; std::string vertex_fname, fragment_fname; std::vector<std::string> defines; };
+	struct File { long long mtime; bool ok; std::string source; std::vector<std::string> includes; }; // mtime -1 if missing
+	
+	bool getSource(const std::string &fname, std::string &source);
+	bool isDirty(const std::string &fname, const std::set<std::string> &changed, std::map<std::string,bool> &memo) const;
+	
+	std::vector<Program> programs;
+	std::map<std::string,File> files;
+	std::chrono::steady_clock::time_point last_poll;
+};
+
+#endif
+
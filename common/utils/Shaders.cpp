@@ -1,15 +1,22 @@
+#include <chrono>
+#include <cstddef>
 #include <string>
 #include <fstream>
 #include <vector>
 #include <iostream>
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 #include "Shaders.hpp"
 #include "Debug.hpp"
 #include "Misc.hpp"
+#include "GLState.hpp"
+#include "UniformBlocks.hpp"
+#include "GLExtensions.hpp"
+#include "ProgramCache.hpp"
 
-static std::string getShaderSource(std::string file_path) {
+bool preprocessShader(const std::string &file_path, const std::function<bool(const std::string&,std::string&)> &include, std::string &source) {
 	std::ifstream fs(file_path,std::ios::binary);
-	cg_assert(fs.is_open(),"Could not open "+std::string(file_path));
+	if (not fs.is_open()) { std::cerr << "Could not open " << file_path << std::endl; return false; }
 	
 	std::string folder = extractFolder(file_path);
 	std::string full_content;
@@ -20,37 +27,64 @@ static std::string getShaderSource(std::string file_path) {
 			line.erase(0,p+1);
 			p = line.find('\"');
 			line.erase(p);
-			line = getShaderSource(folder+line);
+			std::string included;
+			if (not include(folder+line,included)) {
+				std::cerr << "Could not include " << folder+line << " in " << file_path << std::endl;
+				return false;
+			}
+			line = std::move(included);
 		}
 		full_content += line + '\n';
 	}
 	
-	return full_content;
+	source = std::move(full_content);
+	return true;
 }
 
-static GLuint loadAndCompile(GLenum shader_type, const std::string &file_path) {
-	GLuint shader_id = glCreateShader(shader_type);
-	
-	std::string shader_code = getShaderSource(file_path);
-	
-	cg_info("Compiling shader: " + file_path + "...");
-	const char *shader_code_ptr = shader_code.c_str();
-	glShaderSource(shader_id,1,&shader_code_ptr,nullptr);
-	glCompileShader(shader_id);
-	
-	GLint result = GL_FALSE, log_len = 0;
-	glGetShaderiv(shader_id,GL_COMPILE_STATUS,&result);
-	glGetShaderiv(shader_id,GL_INFO_LOG_LENGTH,&log_len);
+bool getShaderSource(const std::string &file_path, std::string &source) {
+	return preprocessShader(file_path,getShaderSource,source);
+}
+
+std::string addDefines(const std::string &source, const std::vector<std::string> &defines) {
+	if (defines.empty()) return source;
+	std::string lines;
+	for(const std::string &d : defines) lines += "#define " + d + "\n";
+	size_t p = source.find("version"); // may be "#version" or "# version"
+	p = p==std::string::npos ? 0 : source.find('\n',p);
+	if (p==std::string::npos) return source + "\n" + lines;
+	return source.substr(0,p+1) + lines + source.substr(p+1);
+}
+
+// prints the info log of a shader or program, if any
+static void printInfoLog(GLuint id, bool is_program) {
+	GLint log_len = 0;
+	if (is_program) glGetProgramiv(id,GL_INFO_LOG_LENGTH,&log_len);
+	else            glGetShaderiv(id,GL_INFO_LOG_LENGTH,&log_len);
 	if (log_len) {
 		std::vector<char> log(log_len);
-		glGetShaderInfoLog(shader_id,log_len,nullptr,log.data());
+		if (is_program) glGetProgramInfoLog(id,log_len,nullptr,log.data());
+		else            glGetShaderInfoLog(id,log_len,nullptr,log.data());
 		std::cerr << log.data() << std::endl;
 	}
-	cg_assert(result==GL_TRUE,"Failed to compile shader "+std::string(file_path));
-	
+}
+
+// only submits the work, the result is checked later (see Shader::loadAll)
+static GLuint submitCompile(GLenum shader_type, const std::string &shader_code) {
+	GLuint shader_id = glCreateShader(shader_type);
+	const char *shader_code_ptr = shader_code.c_str();
+	glShaderSource(shader_id,1,&shader_code_ptr,nullptr);
+	glCompileShader(shader_id);
 	return shader_id;
 }
 
+static bool checkCompile(GLuint shader_id, const std::string &file_path) {
+	GLint result = GL_FALSE;
+	glGetShaderiv(shader_id,GL_COMPILE_STATUS,&result);
+	printInfoLog(shader_id,false);
+	if (result!=GL_TRUE) std::cerr << "Failed to compile shader " << file_path << std::endl;
+	return result==GL_TRUE;
+}
+
 Shader::Shader (const std::string &vertex_fname, const std::string &fragment_fname) {
 	load(vertex_fname,fragment_fname);
 }
@@ -65,37 +99,186 @@ Shader::Shader(Shader &&other) {
 }
 
 Shader &Shader::operator=(Shader &&other) {
+	if (this==&other) return *this;
+	if (program_id!=0) { // replaced (ShaderLibrary does this on reloads)
+		GLState::current().forgetProgram(program_id);
+		glDeleteProgram(program_id);
+	}
 	*this = static_cast<const Shader&>(other);
 	other = static_cast<const Shader&>(Shader());
 	return *this;
 }
 
 void Shader::load(const std::string &vertex_fname, const std::string &fragment_fname) {
-	cg_assert(program_id==0,"Shader already loaded");
-	GLuint vertex_id = loadAndCompile(GL_VERTEX_SHADER,vertex_fname);
-	GLuint fragment_id = loadAndCompile(GL_FRAGMENT_SHADER,fragment_fname);
-	
-	cg_info( "Linking shader program..." );
-	program_id = glCreateProgram();
-	glAttachShader(program_id,vertex_id);
-	glAttachShader(program_id,fragment_id);
-	glLinkProgram(program_id);
-	
-	GLint result = GL_FALSE, log_len = 0;
-	glGetProgramiv(program_id,GL_LINK_STATUS,&result);
-	glGetProgramiv(program_id,GL_INFO_LOG_LENGTH,&log_len);
-	if (log_len) {
-		std::vector<char> log(log_len);
-		glGetProgramInfoLog(program_id,log_len,nullptr,log.data());
-		std::cerr << log.data() << std::endl;
+	loadAll({{this,vertex_fname,fragment_fname}});
+}
+
+void Shader::loadAll(const std::vector<Source> &sources) {
+	bool ok = tryLoadAll(sources);
+	cg_assert(ok,"Failed to load shader programs");
+}
+
+bool Shader::tryLoadAll(const std::vector<Source> &sources, const SourceProvider &get_source) {
+	static unsigned last_serial = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	const GLExtensionFunctions &ext = glExtensionFunctions();
+	
+	struct Job {
+		const Source *src;
+		std::string vertex_code, fragment_code, binary_fname;
+		uint64_t key;
+		GLuint vertex_id = 0, fragment_id = 0;
+	};
+	std::vector<Job> jobs;
+	
+	// try the binary cache first
+	int cached = 0;
+	bool all_ok = true;
+	const SourceProvider &read_source = get_source ? get_source : SourceProvider(getShaderSource);
+	for(const Source &src : sources) {
+		cg_assert(src.shader and src.shader->program_id==0,"Shader already loaded");
+		Job job;
+		job.src = &src;
+		// a missing file (or include) leaves this one unloaded, like a compile error
+		if (not read_source(src.vertex_fname,job.vertex_code) or not read_source(src.fragment_fname,job.fragment_code)) {
+			std::cerr << "Failed to read shader program " << src.vertex_fname << " " << src.fragment_fname << std::endl;
+			all_ok = false;
+			continue;
+		}
+		job.vertex_code = addDefines(job.vertex_code, src.defines);
+		job.fragment_code = addDefines(job.fragment_code, src.defines);
+		job.key = programCacheKey(job.vertex_code,job.fragment_code);
+		job.binary_fname = programBinaryName(src.vertex_fname,src.fragment_fname,src.defines);
+		GLuint program_id = glCreateProgram();
+		if (loadProgramBinary(program_id,job.binary_fname,job.key)) {
+			cg_info("Shader program loaded from cache: " + job.binary_fname);
+			src.shader->program_id = program_id;
+			++cached;
+		} else {
+			glDeleteProgram(program_id); // a failed glProgramBinary may leave it in a bad state
+			jobs.push_back(std::move(job));
+		}
+	}
+	
+	// submit every compile and link before asking for any result, so the driver
+	// does not have to finish one before getting the next
+	if (not jobs.empty() and ext.hasParallelCompile())
+		ext.maxShaderCompilerThreads(0xFFFFFFFF); // as many as the driver wants
+	for(Job &job : jobs) {
+		cg_info("Compiling shaders: " + job.src->vertex_fname + " " + job.src->fragment_fname + "...");
+		job.vertex_id = submitCompile(GL_VERTEX_SHADER,job.vertex_code);
+		job.fragment_id = submitCompile(GL_FRAGMENT_SHADER,job.fragment_code);
+	}
+	for(Job &job : jobs) {
+		GLuint program_id = job.src->shader->program_id = glCreateProgram();
+		glAttachShader(program_id,job.vertex_id);
+		glAttachShader(program_id,job.fragment_id);
+		prepareProgramBinary(program_id);
+		glLinkProgram(program_id);
+	}
+	
+	for(Job &job : jobs) {
+		GLuint &program_id = job.src->shader->program_id;
+		GLint result = GL_FALSE;
+		glGetProgramiv(program_id,GL_LINK_STATUS,&result);
+		if (result!=GL_TRUE) { // compile errors are more useful than the link error
+			checkCompile(job.vertex_id,job.src->vertex_fname);
+			checkCompile(job.fragment_id,job.src->fragment_fname);
+		}
+		printInfoLog(program_id,true);
+		
+		glDetachShader(program_id,job.vertex_id);
+		glDetachShader(program_id,job.fragment_id);
+		glDeleteShader(job.vertex_id);
+		glDeleteShader(job.fragment_id);
+		
+		if (result!=GL_TRUE) {
+			std::cerr << "Failed to link shader program" << std::endl;
+			glDeleteProgram(program_id);
+			program_id = 0;
+			all_ok = false;
+		} else if (ext.hasProgramBinary() and not saveProgramBinary(program_id,job.binary_fname,job.key))
+			cg_info("Could not save shader program cache " + job.binary_fname);
+	}
+	
+	int ready = 0;
+	for(const Source &src : sources) {
+		if (src.shader->program_id==0) continue;
+		++ready;
+		uniform_blocks::bindProgramBlocks(src.shader->program_id);
+		src.shader->reflect();
+		src.shader->serial = ++last_serial;
 	}
-	cg_assert(result==GL_TRUE,"Failed to link shader program");
 	
-	glDetachShader(program_id,vertex_id);
-	glDetachShader(program_id,fragment_id);
+	auto t1 = std::chrono::steady_clock::now();
+	cg_info( std::to_string(ready) + " of " + std::to_string(sources.size()) + " shader programs ready (" + std::to_string(cached) + " from cache) in "
+			 + std::to_string(std::chrono::duration<double,std::milli>(t1-t0).count()) + " ms" );
+	return all_ok;
+}
+
+namespace {
+	
+	struct ActiveName { std::string name; GLint location; };
+	
+	// builds the table for Shader::lookup
+	template<typename Table>
+	Table buildTable(const std::vector<ActiveName> &names) {
+		size_t size = 4;
+		while (size<names.size()*2) size *= 2;
+		Table table(size,{0u,-1});
+		for(const ActiveName &n : names) {
+			unsigned h = hashName(n.name.c_str());
+			size_t i = h&(size-1);
+			while(table[i].location!=-1) {
+				cg_assert(table[i].hash!=h,"Hash collision for shader name "+n.name);
+				i = (i+1)&(size-1);
+			}
+			table[i] = {h,n.location};
+		}
+		return table;
+	}
 	
-	glDeleteShader(vertex_id);
-	glDeleteShader(fragment_id);
+}
+
+GLint Shader::lookup(const Table &table, unsigned hash) {
+	if (table.empty()) return -1;
+	size_t mask = table.size()-1;
+	for(size_t i=hash&mask; ; i=(i+1)&mask) { // there is always an empty slot to stop at
+		if (table[i].location==-1) return -1;
+		if (table[i].hash==hash) return table[i].location;
+	}
+}
+
+void Shader::reflect() {
+	GLint count = 0, max_len = 0;
+	std::vector<ActiveName> names;
+	
+	glGetProgramiv(program_id,GL_ACTIVE_UNIFORMS,&count);
+	glGetProgramiv(program_id,GL_ACTIVE_UNIFORM_MAX_LENGTH,&max_len);
+	std::vector<char> buffer(max_len+1);
+	for(GLint i=0;i<count;++i) {
+		GLint size; GLenum type;
+		glGetActiveUniform(program_id,i,buffer.size(),nullptr,&size,&type,buffer.data());
+		std::string name = buffer.data();
+		GLint location = glGetUniformLocation(program_id,name.c_str());
+		if (location==-1) continue; // in a uniform block
+		if (name.size()>3 and name.compare(name.size()-3,3,"[0]")==0) 
+			name.erase(name.size()-3); // arrays can be found by their plain names
+		names.push_back({name,location});
+	}
+	uniforms = buildTable<Table>(names);
+	
+	names.clear();
+	glGetProgramiv(program_id,GL_ACTIVE_ATTRIBUTES,&count);
+	glGetProgramiv(program_id,GL_ACTIVE_ATTRIBUTE_MAX_LENGTH,&max_len);
+	buffer.resize(max_len+1);
+	for(GLint i=0;i<count;++i) {
+		GLint size; GLenum type;
+		glGetActiveAttrib(program_id,i,buffer.size(),nullptr,&size,&type,buffer.data());
+		GLint location = glGetAttribLocation(program_id,buffer.data());
+		if (location!=-1) names.push_back({buffer.data(),location});
+	}
+	attribs = buildTable<Table>(names);
 }
 
 void Shader::load(const std::string &fname) {
@@ -105,7 +288,7 @@ void Shader::load(const std::string &fname) {
 
 bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool required) {
 	glBindBuffer(GL_ARRAY_BUFFER,id); /// todo: no va type?
-	GLint loc = glGetAttribLocation(program_id, name); 
+	GLint loc = attribLocation(name);
 	if (loc==-1 and (not required)) return false;
 	cg_assert(loc!=-1,"Shader does not have required attribute");
 	glVertexAttribPointer(loc, size, type, GL_FALSE, 0, 0);
@@ -113,100 +296,164 @@ bool Shader::setBuffer (const char *name, GLuint id, GLenum type, int size, bool
 	return true;
 }
 
-void Shader::setBuffers (const GeometryRenderer & geo) {
-	glBindVertexArray(geo.vertexArray());
+void Shader::setBuffers (const GeometryRenderer & geo, const InstanceBuffer *instances) {
+	GLState::current().bindVertexArray(geo.vertexArray());
+	if (geo.attribsSerial()==serial) { // the vao already remembers the per vertex attributes
+		// but not the instances, the same geometry may be drawn with another buffer
+		if (instances) setInstanceBuffer(instances);
+		return;
+	}
+	geo.attribsSerial() = serial;
 	
 	{ // positions
 		glBindBuffer(GL_ARRAY_BUFFER,geo.positionsVBO());
-		GLint loc_pos = glGetAttribLocation(program_id, "vertexPosition"); 
+		GLint loc_pos = attribLocation(cg_name("vertexPosition"));
 		cg_assert(loc_pos!=-1,"Shader does not have vertexPosition attribute");
 		glVertexAttribPointer(loc_pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glVertexAttribDivisor(loc_pos, 0); // the same vao may have been used for instances
 		glEnableVertexAttribArray(loc_pos);
 	}
 	
-	GLint loc_norm = glGetAttribLocation(program_id, "vertexNormal"); 
+	GLint loc_norm = attribLocation(cg_name("vertexNormal"));
 	if (loc_norm!=-1) { // normals
 		cg_assert(geo.normalsVBO()!=0,"Geometry does not have normals");
 		glBindBuffer(GL_ARRAY_BUFFER,geo.normalsVBO());
 		glVertexAttribPointer(loc_norm, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		glVertexAttribDivisor(loc_norm, 0);
 		glEnableVertexAttribArray(loc_norm);
 	}
 	
-	GLint loc_tc = glGetAttribLocation(program_id, "vertexTexCoords"); 
+	GLint loc_tc = attribLocation(cg_name("vertexTexCoords"));
 	if (loc_tc!=-1) { // texture coords
 		glBindBuffer(GL_ARRAY_BUFFER,geo.texCoordsVBO());
 		cg_assert(geo.texCoordsVBO()!=0,"Geometry does not have texture coordinates");
 		glVertexAttribPointer(loc_tc, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glVertexAttribDivisor(loc_tc, 0);
 		glEnableVertexAttribArray(loc_tc);
 	}
 	
+	setInstanceBuffer(instances);
+}
+
+void Shader::setInstanceBuffer(const InstanceBuffer *instances) {
+	GLint loc_inst = attribLocation(cg_name("instanceMatrix"));
+	if (loc_inst!=-1) { // per instance matrixes, one column per location
+		cg_assert(instances and instances->VBO()!=0,"Instanced shader without instances");
+		glBindBuffer(GL_ARRAY_BUFFER,instances->VBO());
+		using Instance = InstanceBuffer::Instance;
+		for(int i=0;i<4;++i) {
+			glVertexAttribPointer(loc_inst+i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), 
+								  reinterpret_cast<void*>(offsetof(Instance,model)+i*sizeof(glm::vec4)));
+			glVertexAttribDivisor(loc_inst+i, 1);
+			glEnableVertexAttribArray(loc_inst+i);
+		}
+		GLint loc_inst_norm = attribLocation(cg_name("instanceNormalMatrix"));
+		for(int i=0;loc_inst_norm!=-1 and i<3;++i) {
+			glVertexAttribPointer(loc_inst_norm+i, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), 
+								  reinterpret_cast<void*>(offsetof(Instance,normal)+i*sizeof(glm::vec3)));
+			glVertexAttribDivisor(loc_inst_norm+i, 1);
+			glEnableVertexAttribArray(loc_inst_norm+i);
+		}
+	}
 }
 
 bool Shader::setUniform(const char *name, float v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
+	return setUniform(uniformLocation(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::vec3 &v) {
+	return setUniform(uniformLocation(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::vec4 &v) {
+	return setUniform(uniformLocation(name),v);
+}
+
+bool Shader::setUniform(const char *name, const glm::mat4 &m) {
+	return setUniform(uniformLocation(name),m);
+}
+
+bool Shader::setUniform(GLint pos, float v) {
 	if (pos==-1) return false;
 	glUniform1f(pos,v);
 	return true;
 }
 
-bool Shader::setUniform(const char *name, const glm::vec3 &v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
+bool Shader::setUniform(GLint pos, const glm::vec3 &v) {
 	if (pos==-1) return false;
 	glUniform3f(pos,v.x,v.y,v.z);
 	return true;
 }
 
-bool Shader::setUniform(const char *name, const glm::vec4 &v) {
-	GLint pos = glGetUniformLocation(program_id, name); 
+bool Shader::setUniform(GLint pos, const glm::vec4 &v) {
 	if (pos==-1) return false;
 	glUniform4f(pos,v.x,v.y,v.z,v.w);
 	return true;
 }
 
-bool Shader::setUniform(const char *name, const glm::mat4 &m) {
-	GLint pos = glGetUniformLocation(program_id, name); 
+bool Shader::setUniform(GLint pos, const glm::mat3 &m) {
+	if (pos==-1) return false;
+	glUniformMatrix3fv(pos, 1, GL_FALSE, &m[0][0]);
+	return true;
+}
+
+bool Shader::setUniform(GLint pos, const glm::mat4 &m) {
 	if (pos==-1) return false;
 	glUniformMatrix4fv(pos, 1, GL_FALSE, &m[0][0]);
 	return true;
 }
 
 void Shader::setMaterial (const Material &mat) {
-	setUniform("diffuseColor", mat.kd);
-	setUniform("specularColor", mat.ks);
-	setUniform("ambientColor", mat.ka);
-	setUniform("emissionColor", mat.ke);
-	setUniform("opacity", mat.opacity);
-	setUniform("shininess", 15555);
+	setUniform(uniformLocation(cg_name("diffuseColor")), mat.kd);
+	setUniform(uniformLocation(cg_name("specularColor")), mat.ks);
+	setUniform(uniformLocation(cg_name("ambientColor")), mat.ka);
+	setUniform(uniformLocation(cg_name("emissionColor")), mat.ke);
+	setUniform(uniformLocation(cg_name("opacity")), mat.opacity);
+	setUniform(uniformLocation(cg_name("shininess")), 15555);
 }
 
 Shader::~Shader ( ) {
-	if (program_id!=0) glDeleteProgram(program_id);
+	if (program_id==0) return;
+	GLState::current().forgetProgram(program_id);
+	glDeleteProgram(program_id);
 }
 
 void Shader::use() const {
 	cg_assert(program_id!=0,"Shader not initialized");
-	glUseProgram(program_id);
+	GLState::current().useProgram(program_id);
+}
+
+void Shader::setModelMatrix (const glm::mat4 &model) {
+	setUniform(uniformLocation(cg_name("modelMatrix")),model);
+	const uniform_blocks::Camera &camera = uniform_blocks::camera();
+	glm::mat4 model_view = camera.viewMatrix * model;
+	setUniform(uniformLocation(cg_name("modelViewMatrix")),model_view);
+	setUniform(uniformLocation(cg_name("mvpMatrix")),camera.projectionMatrix*model_view);
+	GLint loc_normal = uniformLocation(cg_name("normalMatrix"));
+	if (loc_normal!=-1) setUniform(loc_normal,glm::transpose(glm::inverse(glm::mat3(model_view))));
 }
 
 void Shader::setMatrixes (const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection) {
-	setUniform("modelMatrix",model);
-	setUniform("viewMatrix",view);
-	setUniform("projectionMatrix",projection);
+	uniform_blocks::setCamera(view,projection);
+	setModelMatrix(model);
+	// for programs that still use plain uniforms instead of the Camera block
+	setUniform(uniformLocation(cg_name("viewMatrix")),view);
+	setUniform(uniformLocation(cg_name("projectionMatrix")),projection);
 }
 
 void Shader::setLight (const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
-	setUniform("lightPosition",lightPosition);
-	setUniform("lightColor",lightColor);
-	setUniform("ambientStrength",ambientStrength);
+	uniform_blocks::setLight(lightPosition,lightColor,ambientStrength);
+	// for programs that still use plain uniforms instead of the Lights block
+	setUniform(uniformLocation(cg_name("lightPosition")),lightPosition);
+	setUniform(uniformLocation(cg_name("lightColor")),lightColor);
+	setUniform(uniformLocation(cg_name("ambientStrength")),ambientStrength);
 }
 
 void Shader::setLightX(int i, const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength) {
-	static char cs_lp[] = "lightPositionX";
-	static char cs_lc[] = "lightColorX";
-	static char cs_as[] = "ambientStrengthX";
-	cs_lp[13] = cs_lc[10] = cs_as[15] = '0'+i;
-	setUniform(cs_lp,lightPosition);
-	setUniform(cs_lc,lightColor);
-	setUniform(cs_as,ambientStrength);
+	cg_assert(i>=0 and i<=9,"Invalid light number");
+	const char digit[2] = { char('0'+i), '\0' }; // hashes can be continued, no need to build the names
+	setUniform(uniformLocation(hashName(digit,cg_name("lightPosition"))),lightPosition);
+	setUniform(uniformLocation(hashName(digit,cg_name("lightColor"))),lightColor);
+	setUniform(uniformLocation(hashName(digit,cg_name("ambientStrength"))),ambientStrength);
 }
 
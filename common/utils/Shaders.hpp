@@ -1,10 +1,22 @@
 #ifndef SHADERS_H
 #define SHADERS_H
+#include <functional>
 #include <string>
+#include <type_traits>
+#include <vector>
 #include <glad/glad.h>
+#include <glm/ext/matrix_float3x3.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
 #include "Material.hpp"
-#include "Geometry.hpp"
+#include "GeometryRenderer.hpp"
+
+// fnv-1a hash of a uniform or attribute name (h allows continuing a previous hash)
+constexpr unsigned hashName(const char *name, unsigned h=2166136261u) {
+	return *name ? hashName(name+1,(h^static_cast<unsigned char>(*name))*16777619u) : h;
+}
+
+// same, but forced to be evaluated at compile time (for string literals)
+#define cg_name(literal) (std::integral_constant<unsigned,hashName(literal)>::value)
 
 class Shader {
 public:
@@ -18,9 +30,27 @@ public:
 	void load(const std::string &fname);
 	void load(const std::string &vertex_fname, const std::string &fragment_fname);
 	
+	// Loads several programs at once: linked programs are taken from the binary cache
+	// (see ProgramCache.hpp) and, for the rest, every compile and link is submitted 
+	// before checking any result so the driver can work on them in parallel.
+	// Defines are injected right after #version in both stages, that's how variants
+	// of the same files are made (e.g. {"INSTANCED"} for InstanceBuffer draws).
+	struct Source { Shader *shader; std::string vertex_fname, fragment_fname; std::vector<std::string> defines = {}; };
+	static void loadAll(const std::vector<Source> &sources);
+	
+	// Same, but a program that fails to read, compile or link is left unloaded (with
+	// its errors printed) instead of stopping, returns false if any failed. Sources
+	// are read through get_source (getShaderSource by default), false if it can't.
+	using SourceProvider = std::function<bool(const std::string &fname, std::string &source)>;
+	static bool tryLoadAll(const std::vector<Source> &sources, const SourceProvider &get_source = {});
+	
 	bool setBuffer (const char *name, GLuint buffer_id, GLenum type, int size, bool required=true);
-	void setBuffers(const GeometryRenderer &geo);
+	void setBuffers(const GeometryRenderer &geo, const InstanceBuffer *instances = nullptr);
 	void setMaterial(const Material &mat);
+	// view, projection and light go to the shared uniform blocks (see UniformBlocks.hpp),
+	// so per draw only the model matrix needs to be set; modelView, mvp and normal
+	// matrixes are derived from it here, once per draw, for the shaders that use them
+	void setModelMatrix(const glm::mat4 &model);
 	void setMatrixes(const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection);
 	void setLight(const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength);
 	void setLightX(int i,const glm::vec4 &lightPosition, const glm::vec3 &lightColor, float ambientStrength);
@@ -30,15 +60,51 @@ public:
 	bool setUniform(const char *name, const glm::vec4 &v);
 	bool setUniform(const char *name, const glm::mat4 &v);
 	
+	// Every active uniform and attribute is reflected after linking, so these are
+	// just table lookups. The returned location is -1 if the program does not use 
+	// that name, and setUniform(location,...) does nothing in that case.
+	GLint uniformLocation(unsigned name_hash) const { return lookup(uniforms,name_hash); }
+	GLint attribLocation(unsigned name_hash) const { return lookup(attribs,name_hash); }
+	GLint uniformLocation(const char *name) const { return uniformLocation(hashName(name)); }
+	GLint attribLocation(const char *name) const { return attribLocation(hashName(name)); }
+	
+	bool setUniform(GLint location, float v);
+	bool setUniform(GLint location, const glm::vec3 &v);
+	bool setUniform(GLint location, const glm::vec4 &v);
+	bool setUniform(GLint location, const glm::mat3 &v);
+	bool setUniform(GLint location, const glm::mat4 &v);
+	
 	GLuint getProgramId() const { return program_id; }
+	// unique for each successful load, unlike the id
+	unsigned getSerial() const { return serial; }
 	
 	void use() const;
 	~Shader();
 private:
 	Shader &operator=(const Shader &) = default;
+	
+	// open addressing hash table (power of two size, linear probing) name_hash -> location
+	struct Entry { unsigned hash; GLint location; };
+	using Table = std::vector<Entry>;
+	static GLint lookup(const Table &table, unsigned hash);
+	void reflect();
+	void setInstanceBuffer(const InstanceBuffer *instances); // part of setBuffers
+	
 	GLuint program_id = 0;
+	unsigned serial = 0;
+	Table uniforms, attribs;
 };
 
+// reads a shader file, replacing each #include "file" line by what include(path of
+// file) gives; false (with the error printed) if the file or an include can't be read
+bool preprocessShader(const std::string &file_path, const std::function<bool(const std::string&,std::string&)> &include, std::string &source);
+
+// reads a shader file with all of its includes resolved (recursively)
+bool getShaderSource(const std::string &file_path, std::string &source);
+
+// inserts a #define line for each name after the #version line
+std::string addDefines(const std::string &source, const std::vector<std::string> &defines);
+
 GLuint loadShader(GLenum shader_type, const std::string &file_path);
 
 GLuint loadShaders(const std::string &vertex_path, const std::string &fragment_path);
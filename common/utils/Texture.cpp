@@ -1,37 +1,120 @@
+#include <algorithm>
+#include <future>
 #include <stb_image.h>
 #include "Texture.hpp"
+#include "TextureData.hpp"
+#include "GLExtensions.hpp"
+#include "ThreadPool.hpp"
+#include "GLState.hpp"
 #include "Debug.hpp"
 
-Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t) {
+void Image::freeImageData(void *p) {
+	stbi_image_free(p);
+}
+
+Image loadImage(const std::string &fname, bool flip_vertically) {
+	// stbi_set_flip_vertically_on_load is a global setting shared by all threads, 
+	// so images are always decoded as stored and flipped here if needed
+	Image img;
+	img.data.reset(stbi_load(fname.c_str(), &img.width, &img.height, &img.channels, 0));
+	cg_assert(img.data,"Could not load texture "+fname);
+	if (flip_vertically) {
+		size_t row = size_t(img.width)*img.channels;
+		unsigned char *top = img.data.get(), *bottom = top+row*(img.height-1);
+		for( ; top<bottom; top+=row, bottom-=row)
+			std::swap_ranges(top,top+row,bottom);
+	}
+	return img;
+}
+
+std::vector<Image> loadImages(const std::vector<std::string> &fnames, bool flip_vertically, ThreadPool *pool) {
+	if (not pool) pool = &ThreadPool::shared();
+	std::vector<std::future<Image>> futures;
+	futures.reserve(fnames.size());
+	for(const std::string &fname : fnames)
+		futures.push_back(pool->submit([fname,flip_vertically](){ return loadImage(fname,flip_vertically); }));
+	std::vector<Image> images;
+	images.reserve(fnames.size());
+	for(auto &f : futures) 
+		images.push_back(f.get());
+	return images;
+}
+
+Texture::Texture (const std::string &fname, bool repeat_s, bool repeat_t) 
+	: Texture(loadTextureCached(fname),repeat_s,repeat_t)
+{
+	
+}
+
+Texture::Texture (const Image &img, bool repeat_s, bool repeat_t) {
+	cg_assert(img.isOk(),"Invalid image");
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id); 
+	GLState::current().bindTexture(0, GL_TEXTURE_2D, id);
 	// set the texture wrapping parameters
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// set texture wrapping to GL_REPEAT (default wrapping method)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	// set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	// load image, create texture and generate mipmaps
-	stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
-	// The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
-	unsigned char *data = stbi_load(fname.c_str(), &width, &height, &channels, 0);
-	cg_assert(data,"Could not load texture");
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, channels==3?GL_RGB:GL_RGBA, GL_UNSIGNED_BYTE, data);
+	// create texture and generate mipmaps
+	width = img.width; height = img.height; channels = img.channels;
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, channels==3?GL_RGB:GL_RGBA, GL_UNSIGNED_BYTE, img.data.get());
 	glGenerateMipmap(GL_TEXTURE_2D);
-	stbi_image_free(data);
+	mem.set(size_t(width)*height*4*4/3); // rgba, plus a third for the mips
+	this->repeat_s = repeat_s; this->repeat_t = repeat_t; mipmapped = true;
+}
+
+Texture::Texture (const TextureData &data, bool repeat_s, bool repeat_t) {
+	cg_assert(data.isOk(),"Invalid texture data");
+	if (data.compressed and not hasGLExtension("GL_EXT_texture_compression_s3tc")) {
+		*this = Texture(data.decompressed(),repeat_s,repeat_t);
+		return;
+	}
+	glGenTextures(1, &id);
+	GLState::current().bindTexture(0, GL_TEXTURE_2D, id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	mipmapped = data.levels.size()>1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped?GL_LINEAR_MIPMAP_LINEAR:GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// mip levels are already generated, just upload them (rows are tightly packed)
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	size_t bytes = 0;
+	for(size_t i=0;i<data.levels.size();++i) {
+		const TextureData::Level &l = data.levels[i];
+		bytes += l.size;
+		if (data.compressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, data.internal_format, l.width, l.height, 0, l.size, l.data);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, data.internal_format, l.width, l.height, 0, data.format, data.type, l.data);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, data.levels.size()-1);
+	if (data.channels<3) { // grey or grey+alpha, shaders expect rgba
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, data.channels==2 ? GL_GREEN : GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+	width = data.width; height = data.height; channels = data.channels;
+	mem.set(bytes);
 	this->repeat_s = repeat_s; this->repeat_t = repeat_t;
 }
 
 Texture::~Texture ( ) {
+	freeResources();
+}
+
+void Texture::freeResources() {
+	if (id==0) return;
+	GLState::current().forgetTexture(id);
 	glDeleteTextures(1,&id);
+	id = 0;
 }
 
 void Texture::bind (int number) const {
 	cg_assert(id!=0,"texture not initialized");
-	glActiveTexture(GL_TEXTURE0+number);
-	glBindTexture(GL_TEXTURE_2D, id);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, repeat_s?GL_REPEAT:GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, repeat_t?GL_REPEAT:GL_CLAMP_TO_BORDER);
+	GLState &state = GLState::current();
+	state.bindTexture(number, GL_TEXTURE_2D, id);
+	state.bindSampler(number, state.sampler(repeat_s,repeat_t,mipmapped)); // wrapping modes live in shared sampler objects
 }
 
 Texture::Texture (Texture &&t) {
@@ -40,8 +123,22 @@ Texture::Texture (Texture &&t) {
 }
 
 Texture & Texture::operator=(Texture &&t) {
+	freeResources();
 	*this = static_cast<const Texture &>(t);
 	t = static_cast<const Texture &>(Texture{});
 	return *this;
 }
 
+std::vector<Texture> loadTextures(const std::vector<TextureRequest> &requests, ThreadPool *pool) {
+	if (not pool) pool = &ThreadPool::shared();
+	std::vector<std::future<TextureData>> futures;
+	futures.reserve(requests.size());
+	for(const TextureRequest &req : requests)
+		futures.push_back(pool->submit([fname=req.fname](){ return loadTextureCached(fname); }));
+	std::vector<Texture> textures;
+	textures.reserve(requests.size());
+	for(size_t i=0;i<requests.size();++i)
+		textures.emplace_back(futures[i].get(),requests[i].repeat_s,requests[i].repeat_t);
+	return textures;
+}
+
@@ -1,13 +1,35 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <glad/glad.h>
+#include "MemoryStats.hpp"
+
+// decoded image, as returned by stb_image (no gl involved, can be loaded from any thread)
+struct Image {
+	int width=-1, height=-1, channels=-1;
+	std::unique_ptr<unsigned char[],void(*)(void*)> data{nullptr,&freeImageData};
+	bool isOk() const { return channels!=-1; }
+	static void freeImageData(void *p);
+};
+
+Image loadImage(const std::string &fname, bool flip_vertically=true);
+
+class ThreadPool;
+
+// decodes all the images in parallel (nullptr => ThreadPool::shared())
+std::vector<Image> loadImages(const std::vector<std::string> &fnames, bool flip_vertically=true, ThreadPool *pool=nullptr);
+
+struct TextureData;
 
 class Texture {
 public:
 	Texture() = default;
 	Texture(const std::string &fname, bool repeat_s=true, bool repeat_t=true);
+	Texture(const Image &img, bool repeat_s=true, bool repeat_t=true);
+	Texture(const TextureData &data, bool repeat_s=true, bool repeat_t=true);
 	Texture(Texture &&t);
 	Texture &operator=(Texture &&t);
 	~Texture();
@@ -15,10 +37,21 @@ public:
 	bool isOk() const { return channels!=-1; }
 private:
 	Texture &operator=(const Texture &t) = default;
+	void freeResources();
 	GLuint id = 0;
 	int width=-1, height=-1, channels=-1;
+	bool repeat_s=true, repeat_t=true, mipmapped=false;
+	TrackedBytes mem{memory_stats::cTextures}; // all mip levels, as uploaded
+};
+
+struct TextureRequest {
+	std::string fname;
 	bool repeat_s=true, repeat_t=true;
 };
 
+// decodes (or maps the baked versions of) all the images in parallel, and uploads 
+// them in order from the calling thread as soon as each one is ready
+std::vector<Texture> loadTextures(const std::vector<TextureRequest> &requests, ThreadPool *pool=nullptr);
+
 #endif
 
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include "TextureData.hpp"
+#include "Texture.hpp"
+#include "GLExtensions.hpp"
+#include "Debug.hpp"
+#include "Misc.hpp"
+
+namespace {
+
+// file layout: FileHeader, FileLevel[levels], and then each level's data (16-byte aligned)
+struct FileHeader {
+	char magic[4];
+	uint32_t version, width, height, channels, levels;
+	uint32_t internal_format, format, type, compressed;
+};
+struct FileLevel {
+	uint32_t width, height;
+	uint64_t offset, size;
+};
+const char file_magic[4] = {'C','G','T','X'};
+const uint32_t file_version = 1;
+
+size_t alignTo16(size_t n) { return (n+15)&~size_t(15); }
+
+// --- bc1 (dxt1) ---
+
+uint16_t toRGB565(const int c[3]) {
+	return uint16_t(((c[0]*31+127)/255)<<11 | ((c[1]*63+127)/255)<<5 | ((c[2]*31+127)/255));
+}
+
+void fromRGB565(uint16_t v, int c[3]) {
+	c[0] = ((v>>11)&31)*255/31; c[1] = ((v>>5)&63)*255/63; c[2] = (v&31)*255/31;
+}
+
+void bc1Palette(uint16_t c0, uint16_t c1, int pal[4][3]) {
+	fromRGB565(c0,pal[0]); fromRGB565(c1,pal[1]);
+	for(int j=0;j<3;++j) {
+		if (c0>c1) {
+			pal[2][j] = (2*pal[0][j]+pal[1][j])/3;
+			pal[3][j] = (pal[0][j]+2*pal[1][j])/3;
+		} else {
+			pal[2][j] = (pal[0][j]+pal[1][j])/2;
+			pal[3][j] = 0;
+		}
+	}
+}
+
+// block is 4x4 rgb pixels, row by row; uses the color bounding box as endpoints
+void encodeBC1Block(const unsigned char block[16*3], unsigned char out[8]) {
+	int mn[3] = {255,255,255}, mx[3] = {0,0,0};
+	for(int i=0;i<16;++i) { 
+		for(int j=0;j<3;++j) {
+			mn[j] = std::min(mn[j],int(block[i*3+j]));
+			mx[j] = std::max(mx[j],int(block[i*3+j]));
+		}
+	}
+	for(int j=0;j<3;++j) { // inset the box a little, extremes are usually outliers
+		int inset = (mx[j]-mn[j])>>4;
+		mn[j] += inset; mx[j] -= inset;
+	}
+	uint16_t c0 = toRGB565(mx), c1 = toRGB565(mn);
+	if (c0<c1) std::swap(c0,c1);
+	uint32_t indices = 0;
+	if (c0!=c1) {
+		int pal[4][3]; bc1Palette(c0,c1,pal);
+		for(int i=0;i<16;++i) {
+			int best = 0, best_dist = 1<<30;
+			for(int k=0;k<4;++k) {
+				int dist = 0;
+				for(int j=0;j<3;++j) { int d = int(block[i*3+j])-pal[k][j]; dist += d*d; }
+				if (dist<best_dist) { best_dist = dist; best = k; }
+			}
+			indices |= uint32_t(best)<<(2*i);
+		}
+	}
+	out[0] = c0&0xFF; out[1] = c0>>8; out[2] = c1&0xFF; out[3] = c1>>8;
+	for(int k=0;k<4;++k) out[4+k] = (indices>>(8*k))&0xFF;
+}
+
+size_t bc1Size(int w, int h) { return size_t((w+3)/4)*((h+3)/4)*8; }
+
+void encodeBC1(const unsigned char *rgb, int w, int h, unsigned char *out) {
+	unsigned char block[16*3];
+	for(int by=0;by<h;by+=4) {
+		for(int bx=0;bx<w;bx+=4) {
+			for(int y=0;y<4;++y) {
+				for(int x=0;x<4;++x) { // repeat border pixels on partial blocks
+					const unsigned char *p = rgb+(size_t(std::min(by+y,h-1))*w+std::min(bx+x,w-1))*3;
+					std::copy(p,p+3,block+(y*4+x)*3);
+				}
+			}
+			encodeBC1Block(block,out);
+			out += 8;
+		}
+	}
+}
+
+void decodeBC1(const unsigned char *in, int w, int h, unsigned char *rgb) {
+	for(int by=0;by<h;by+=4) {
+		for(int bx=0;bx<w;bx+=4) {
+			uint16_t c0 = in[0]|(in[1]<<8), c1 = in[2]|(in[3]<<8);
+			uint32_t indices = in[4]|(in[5]<<8)|(in[6]<<16)|(uint32_t(in[7])<<24);
+			int pal[4][3]; bc1Palette(c0,c1,pal);
+			for(int y=0;y<4 and by+y<h;++y) {
+				for(int x=0;x<4 and bx+x<w;++x) {
+					const int *c = pal[(indices>>(2*(y*4+x)))&3];
+					unsigned char *p = rgb+(size_t(by+y)*w+bx+x)*3;
+					for(int j=0;j<3;++j) p[j] = c[j];
+				}
+			}
+			in += 8;
+		}
+	}
+}
+
+// --- mip levels ---
+
+// 2x2 box filter, the last row/column is repeated for odd sizes
+void downsample(const unsigned char *src, int w, int h, int ch, unsigned char *dst) {
+	int dw = std::max(1,w/2), dh = std::max(1,h/2);
+	for(int y=0;y<dh;++y) {
+		int y0 = std::min(2*y,h-1), y1 = std::min(2*y+1,h-1);
+		for(int x=0;x<dw;++x) {
+			int x0 = std::min(2*x,w-1), x1 = std::min(2*x+1,w-1);
+			for(int j=0;j<ch;++j) {
+				int sum = src[(size_t(y0)*w+x0)*ch+j] + src[(size_t(y0)*w+x1)*ch+j]
+						+ src[(size_t(y1)*w+x0)*ch+j] + src[(size_t(y1)*w+x1)*ch+j];
+				dst[(size_t(y)*dw+x)*ch+j] = (sum+2)/4;
+			}
+		}
+	}
+}
+
+void setFormats(TextureData &data) {
+	static const GLenum internal_formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	data.internal_format = data.compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : internal_formats[data.channels-1];
+	data.format = formats[data.channels-1];
+	data.type = GL_UNSIGNED_BYTE;
+}
+
+} // namespace
+
+TextureData bakeTexture(const Image &img, bool compress) {
+	cg_assert(img.isOk() and img.channels>=1 and img.channels<=4,"Invalid image");
+	TextureData data;
+	data.width = img.width; data.height = img.height; data.channels = img.channels;
+	data.compressed = compress and img.channels==3;
+	setFormats(data);
+	
+	// uncompressed chain first, all levels in one buffer
+	std::vector<size_t> offsets;
+	size_t total = 0;
+	for(int w=img.width, h=img.height; ; w=std::max(1,w/2), h=std::max(1,h/2)) {
+		offsets.push_back(total);
+		total += size_t(w)*h*img.channels;
+		if (w==1 and h==1) break;
+	}
+	std::vector<unsigned char> raw(total);
+	std::copy(img.data.get(),img.data.get()+size_t(img.width)*img.height*img.channels,raw.begin());
+	int w = img.width, h = img.height;
+	for(size_t i=1;i<offsets.size();++i) {
+		downsample(raw.data()+offsets[i-1],w,h,img.channels,raw.data()+offsets[i]);
+		w = std::max(1,w/2); h = std::max(1,h/2);
+	}
+	
+	if (not data.compressed) {
+		data.memory = std::move(raw);
+	} else {
+		size_t ctotal = 0;
+		for(int w=img.width, h=img.height; ; w=std::max(1,w/2), h=std::max(1,h/2)) {
+			ctotal += bc1Size(w,h);
+			if (w==1 and h==1) break;
+		}
+		data.memory.resize(ctotal);
+		size_t coffset = 0; w = img.width; h = img.height;
+		for(size_t i=0;i<offsets.size();++i) {
+			encodeBC1(raw.data()+offsets[i],w,h,data.memory.data()+coffset);
+			offsets[i] = coffset;
+			coffset += bc1Size(w,h);
+			w = std::max(1,w/2); h = std::max(1,h/2);
+		}
+	}
+	
+	w = img.width; h = img.height;
+	for(size_t i=0;i<offsets.size();++i) {
+		size_t size = data.compressed ? bc1Size(w,h) : size_t(w)*h*img.channels;
+		data.levels.push_back({w,h,data.memory.data()+offsets[i],size});
+		w = std::max(1,w/2); h = std::max(1,h/2);
+	}
+	return data;
+}
+
+TextureData TextureData::decompressed() const {
+	if (not compressed) cg_error("Texture data is not compressed");
+	TextureData ret;
+	ret.width = width; ret.height = height; ret.channels = 3;
+	setFormats(ret);
+	size_t total = 0;
+	for(const Level &l : levels) total += size_t(l.width)*l.height*3;
+	ret.memory.resize(total);
+	size_t offset = 0;
+	for(const Level &l : levels) {
+		decodeBC1(l.data,l.width,l.height,ret.memory.data()+offset);
+		ret.levels.push_back({l.width,l.height,ret.memory.data()+offset,size_t(l.width)*l.height*3});
+		offset += size_t(l.width)*l.height*3;
+	}
+	return ret;
+}
+
+bool saveTextureData(const TextureData &data, const std::string &fname) {
+	cg_assert(data.isOk(),"Invalid texture data");
+	FileHeader header;
+	std::copy(file_magic,file_magic+4,header.magic);
+	header.version = file_version;
+	header.width = data.width; header.height = data.height; header.channels = data.channels;
+	header.levels = data.levels.size();
+	header.internal_format = data.internal_format; header.format = data.format; header.type = data.type;
+	header.compressed = data.compressed;
+	
+	std::vector<FileLevel> levels(data.levels.size());
+	size_t offset = alignTo16(sizeof(FileHeader)+levels.size()*sizeof(FileLevel));
+	for(size_t i=0;i<levels.size();++i) {
+		levels[i] = { uint32_t(data.levels[i].width), uint32_t(data.levels[i].height), offset, data.levels[i].size };
+		offset = alignTo16(offset+data.levels[i].size);
+	}
+	
+	// write to a temporary file and rename it, so concurrent loaders never see a partial file
+	std::string tmp_name = fname+"."+std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))+".tmp";
+	{
+		std::ofstream file(tmp_name,std::ios::binary|std::ios::trunc);
+		if (not file.is_open()) return false;
+		file.write(reinterpret_cast<const char*>(&header),sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()),levels.size()*sizeof(FileLevel));
+		for(size_t i=0;i<levels.size();++i) {
+			file.seekp(levels[i].offset);
+			file.write(reinterpret_cast<const char*>(data.levels[i].data),data.levels[i].size);
+		}
+		if (not file.good()) { file.close(); std::remove(tmp_name.c_str()); return false; }
+	}
+	if (std::rename(tmp_name.c_str(),fname.c_str())!=0) {
+		std::remove(fname.c_str()); // windows does not replace existing files
+		if (std::rename(tmp_name.c_str(),fname.c_str())!=0) { std::remove(tmp_name.c_str()); return false; }
+	}
+	return true;
+}
+
+TextureData loadTextureData(const std::string &fname) {
+	TextureData data;
+	MappedFile file(fname);
+	if (not file.isOk() or file.size()<sizeof(FileHeader)) return data;
+	FileHeader header;
+	std::memcpy(&header,file.data(),sizeof(header));
+	if (not std::equal(file_magic,file_magic+4,header.magic) or header.version!=file_version) return data;
+	// everything is checked against what bakeTexture would have written for that 
+	// size, so a stale or corrupt file is baked again instead of reaching gl
+	if (header.channels<1 or header.channels>4 or (header.compressed and header.channels!=3)) return data;
+	if (header.width<1 or header.height<1 or header.width>(1u<<16) or header.height>(1u<<16)) return data;
+	if (header.levels<1 or header.levels>32) return data;
+	if (file.size()<sizeof(FileHeader)+size_t(header.levels)*sizeof(FileLevel)) return data;
+	data.width = header.width; data.height = header.height; data.channels = header.channels;
+	data.compressed = header.compressed;
+	setFormats(data);
+	if (header.internal_format!=data.internal_format or header.format!=data.format or header.type!=data.type) return TextureData();
+	
+	int w = data.width, h = data.height;
+	for(uint32_t i=0;i<header.levels;++i) {
+		FileLevel level;
+		std::memcpy(&level,file.data()+sizeof(FileHeader)+i*sizeof(FileLevel),sizeof(level));
+		size_t expected = data.compressed ? bc1Size(w,h) : size_t(w)*h*data.channels;
+		bool past_chain = i>0 and data.levels.back().width==1 and data.levels.back().height==1;
+		if (past_chain or level.width!=uint32_t(w) or level.height!=uint32_t(h) or level.size!=expected
+			or level.offset>file.size() or level.size>file.size()-level.offset) 
+			return TextureData();
+		data.levels.push_back({w,h,file.data()+level.offset,size_t(level.size)});
+		w = std::max(1,w/2); h = std::max(1,h/2);
+	}
+	data.file = std::move(file);
+	return data;
+}
+
+std::string bakedTextureName(const std::string &image_fname) {
+	return image_fname+".cgtex";
+}
+
+TextureData loadTextureCached(const std::string &image_fname, bool compress) {
+	std::string baked_fname = bakedTextureName(image_fname);
+	long long baked_time = getModificationTime(baked_fname);
+	if (baked_time!=-1 and baked_time>=getModificationTime(image_fname)) {
+		TextureData data = loadTextureData(baked_fname);
+		if (data.isOk()) return data;
+		cg_info("Invalid baked texture, baking it again: "+baked_fname);
+	}
+	cg_info("Baking texture: "+image_fname+"...");
+	TextureData data = bakeTexture(loadImage(image_fname),compress);
+	if (not saveTextureData(data,baked_fname))
+		cg_info("Could not save baked texture "+baked_fname);
+	return data;
+}
+
@@ -0,0 +1,48 @@
+#ifndef TEXTUREDATA_HPP
+#define TEXTUREDATA_HPP
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include "MappedFile.hpp"
+
+struct Image;
+
+// A texture with all of its mip levels already in the final gpu format, ready to 
+// be uploaded level by level. It is either built in memory from an Image, or 
+// memory-mapped from a baked file (so loading it does not decode anything).
+struct TextureData {
+	struct Level {
+		int width, height;
+		const unsigned char *data;
+		size_t size;
+	};
+	int width=-1, height=-1, channels=-1;
+	GLenum internal_format = 0, format = 0, type = GL_UNSIGNED_BYTE;
+	bool compressed = false; // bc1 (dxt1) blocks, only for rgb images
+	std::vector<Level> levels;
+	
+	bool isOk() const { return not levels.empty(); }
+	TextureData decompressed() const; // for drivers without s3tc support
+	
+	// storage for levels' data, only one of them is used
+	MappedFile file;
+	std::vector<unsigned char> memory;
+};
+
+// generates all mip levels (and optionally compresses them)
+TextureData bakeTexture(const Image &img, bool compress=false);
+
+bool saveTextureData(const TextureData &data, const std::string &fname);
+TextureData loadTextureData(const std::string &fname); // !isOk() if missing or invalid
+
+// name of the baked file that loadTextureCached uses for an image file
+std::string bakedTextureName(const std::string &image_fname);
+
+// loads the baked version of an image, baking and saving it first if it is
+// missing or older than the image (an existing baked file is used as is, 
+// even if it was baked with a different compress option)
+TextureData loadTextureCached(const std::string &image_fname, bool compress=false);
+
+#endif
+
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <chrono>
+#include "ThreadPool.hpp"
+#include "Debug.hpp"
+
+namespace {
+	// the pool (if any) the current thread works for, and its index there
+	thread_local const ThreadPool *current_pool = nullptr;
+	thread_local int current_index = -1;
+	int shared_threads = 0;
+	std::atomic<bool> shared_created{false};
+}
+
+long long ThreadPool::nowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadPool::ThreadPool(int nthreads) {
+	if (nthreads<=0) nthreads = std::max(1,int(std::thread::hardware_concurrency()));
+	stats_start = nowNs();
+	for(int i=0;i<nthreads;++i)
+		workers.emplace_back(new Worker());
+	threads.reserve(nthreads);
+	for(int i=0;i<nthreads;++i)
+		threads.emplace_back([this,i](){ workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+	for(std::thread &t : threads) t.join();
+}
+
+int ThreadPool::currentWorker() const {
+	return current_pool==this ? current_index : -1;
+}
+
+void ThreadPool::enqueue(Task task) {
+	int self = currentWorker();
+	if (self>=0) {
+		std::lock_guard<std::mutex> lock(workers[self]->mtx);
+		workers[self]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (self<0) injected.push_back(std::move(task));
+		++queued;
+	}
+	cv.notify_one();
+}
+
+bool ThreadPool::tryRunOne(int self) {
+	Task task;
+	bool stolen = false;
+	if (self>=0) { // own tasks, newest first
+		Worker &w = *workers[self];
+		std::lock_guard<std::mutex> lock(w.mtx);
+		if (not w.tasks.empty()) { task = std::move(w.tasks.back()); w.tasks.pop_back(); }
+	}
+	if (not task) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (not injected.empty()) { task = std::move(injected.front()); injected.pop_front(); }
+	}
+	for(int k=1;k<=size() and not task;++k) { // the oldest from someone else
+		int victim = (std::max(self,0)+k)%size();
+		if (victim==self) continue;
+		Worker &w = *workers[victim];
+		std::lock_guard<std::mutex> lock(w.mtx);
+		if (not w.tasks.empty()) { task = std::move(w.tasks.front()); w.tasks.pop_front(); stolen = true; }
+	}
+	if (not task) return false;
+	--queued;
+	long long t0 = nowNs();
+	task();
+	if (self>=0) {
+		Worker &w = *workers[self];
+		++w.tasks_run;
+		if (stolen) ++w.stolen;
+		w.busy_ns += nowNs()-t0;
+	}
+	return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+	current_pool = this;
+	current_index = index;
+	while(true) {
+		if (tryRunOne(index)) continue;
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait(lock,[this](){ return stopping or queued>0; });
+		if (stopping and queued<=0) return; // and nothing left to do
+	}
+}
+
+int ThreadPool::runMainThreadTasks(double budget_seconds) {
+	auto t0 = std::chrono::steady_clock::now();
+	int count = 0;
+	while(true) {
+		Task task;
+		{
+			std::lock_guard<std::mutex> lock(main_mtx);
+			if (main_tasks.empty()) break;
+			task = std::move(main_tasks.front());
+			main_tasks.pop_front();
+		}
+		task();
+		++count;
+		if (std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count()>=budget_seconds) break;
+	}
+	return count;
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::stats() const {
+	double elapsed = (nowNs()-stats_start)*1e-9;
+	std::vector<WorkerStats> v(workers.size());
+	for(size_t i=0;i<workers.size();++i) {
+		v[i].tasks = workers[i]->tasks_run;
+		v[i].stolen = workers[i]->stolen;
+		v[i].busy = workers[i]->busy_ns*1e-9;
+		v[i].elapsed = elapsed;
+	}
+	return v;
+}
+
+void ThreadPool::resetStats() {
+	for(auto &w : workers) { w->tasks_run = 0; w->stolen = 0; w->busy_ns = 0; }
+	stats_start = nowNs();
+}
+
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool pool(shared_threads);
+	shared_created = true;
+	return pool;
+}
+
+void ThreadPool::configureShared(int nthreads) {
+	cg_assert(not shared_created,"ThreadPool::configureShared called after the shared pool was created");
+	shared_threads = nthreads;
+}
+
+struct TaskGraph::State {
+	std::unique_ptr<std::atomic<int>[]> pending; // unfinished dependencies of each task
+	std::unique_ptr<std::atomic<bool>[]> skip;   // some dependency failed
+	std::atomic<int> remaining{0};
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::deque<Id> main_ready;
+	std::exception_ptr error;
+};
+
+TaskGraph::Id TaskGraph::add(std::function<void()> func, std::initializer_list<Id> deps, bool main_thread) {
+	Id id = nodes.size();
+	nodes.emplace_back();
+	nodes[id].func = std::move(func);
+	nodes[id].main_thread = main_thread;
+	for(Id d : deps) {
+		cg_assert(d>=0 and d<id,"A task can only depend on tasks added before it");
+		nodes[d].dependents.push_back(id);
+		++nodes[id].deps_count;
+	}
+	return id;
+}
+
+void TaskGraph::launch(const std::shared_ptr<State> &state, ThreadPool &pool, Id id) {
+	if (nodes[id].main_thread) {
+		std::lock_guard<std::mutex> lock(state->mtx);
+		state->main_ready.push_back(id);
+		state->cv.notify_all();
+	} else 
+		pool.enqueue([this,state,&pool,id](){ execute(state,pool,id); });
+}
+
+void TaskGraph::execute(const std::shared_ptr<State> &state, ThreadPool &pool, Id id) {
+	bool ok = not state->skip[id];
+	if (ok) {
+		try { nodes[id].func(); }
+		catch(...) {
+			std::lock_guard<std::mutex> lock(state->mtx);
+			if (not state->error) state->error = std::current_exception();
+			ok = false;
+		}
+	}
+	for(Id d : nodes[id].dependents) {
+		if (not ok) state->skip[d] = true;
+		if (--state->pending[d]==0) launch(state,pool,d);
+	}
+	if (--state->remaining==0) {
+		std::lock_guard<std::mutex> lock(state->mtx);
+		state->cv.notify_all();
+	}
+}
+
+void TaskGraph::run(ThreadPool &pool) {
+	if (nodes.empty()) return;
+	auto state = std::make_shared<State>();
+	state->pending.reset(new std::atomic<int>[nodes.size()]);
+	state->skip.reset(new std::atomic<bool>[nodes.size()]);
+	for(size_t i=0;i<nodes.size();++i) { state->pending[i] = nodes[i].deps_count; state->skip[i] = false; }
+	state->remaining = nodes.size();
+	for(Id i=0;i<size();++i)
+		if (nodes[i].deps_count==0) launch(state,pool,i);
+	// run the main thread tasks as they get ready, until everything finished
+	std::unique_lock<std::mutex> lock(state->mtx);
+	while(true) {
+		state->cv.wait(lock,[&](){ return not state->main_ready.empty() or state->remaining==0; });
+		if (state->main_ready.empty()) break;
+		Id id = state->main_ready.front();
+		state->main_ready.pop_front();
+		lock.unlock();
+		execute(state,pool,id);
+		lock.lock();
+	}
+	if (state->error) std::rethrow_exception(state->error);
+}
@@ -0,0 +1,159 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker has its own deque, tasks submitted from a
+// worker go to the back of its own deque (and it takes them from there, newest
+// first, while they're still in cache), tasks from other threads go to a shared
+// queue, and an idle worker steals the oldest task from the others. Meant to be
+// a single one for every subsystem (see shared()), so nested parallelism (e.g. a
+// parallelFor inside a task) doesn't oversubscribe the cores.
+class ThreadPool {
+public:
+	ThreadPool(int nthreads=0); // 0 => one per hardware thread
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &other) = delete;
+	ThreadPool &operator=(const ThreadPool &other) = delete;
+
+	template<typename F>
+	auto submit(F &&func) -> std::future<decltype(func())>;
+
+	// Calls func(i) for every i in [0,n), in chunks of at least min_chunk indexes
+	// (the grain) spread over the workers. The calling thread takes chunks too and
+	// then waits only for the ones already taken, so it's fine to call it from a
+	// task running in this same pool (e.g. a model loaded by AssetLoader). func
+	// must not throw.
+	template<typename F>
+	void parallelFor(int n, int min_chunk, const F &func);
+
+	// Main thread affinity (e.g. for gl calls from a worker): these tasks are queued
+	// until the main thread calls runMainThreadTasks (once per frame, through
+	// AssetLoader::processUploads, in the demo).
+	template<typename F>
+	auto submitToMainThread(F &&func) -> std::future<decltype(func())>;
+	// runs queued main thread tasks until the budget is exhausted, returns how many
+	int runMainThreadTasks(double budget_seconds=1e30);
+
+	int size() const { return workers.size(); }
+
+	// utilisation of each worker since the pool was created (or resetStats)
+	struct WorkerStats {
+		long long tasks = 0;  // run by this worker
+		long long stolen = 0; // of those, taken from another worker's deque
+		double busy = 0;      // seconds running tasks
+		double elapsed = 0;   // seconds since the start of the stats
+		double utilisation() const { return elapsed>0 ? busy/elapsed : 0; }
+	};
+	std::vector<WorkerStats> stats() const;
+	void resetStats();
+
+	// process-wide pool, created on first use; call configureShared before that
+	// to use other than one worker per hardware thread
+	static ThreadPool &shared();
+	static void configureShared(int nthreads);
+
+private:
+	using Task = std::function<void()>;
+	struct Worker {
+		std::mutex mtx;
+		std::deque<Task> tasks;
+		std::atomic<long long> tasks_run{0}, stolen{0}, busy_ns{0};
+	};
+	void enqueue(Task task);
+	bool tryRunOne(int self); // self is -1 for threads that aren't workers of this pool
+	int currentWorker() const;
+	void workerLoop(int index);
+	static long long nowNs();
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+	std::deque<Task> injected; // from non worker threads
+	std::deque<Task> main_tasks;
+	std::mutex mtx, main_mtx;
+	std::condition_variable cv;
+	std::atomic<int> queued{0}; // tasks waiting in any deque
+	std::atomic<long long> stats_start{0};
+	bool stopping = false;
+
+	friend class TaskGraph;
+};
+
+// Tasks with dependencies, run on a ThreadPool: a task starts once every task it
+// depends on has finished, so the independent ones run at the same time. Ids are
+// given in order and a task can only depend on earlier ones (no cycles). Tasks
+// added with main_thread run in the thread that calls run (gl work), the rest on
+// the workers. If a task throws, the ones depending on it are skipped and run
+// rethrows the first exception once the rest finished.
+class TaskGraph {
+public:
+	using Id = int;
+	Id add(std::function<void()> func, std::initializer_list<Id> deps = {}, bool main_thread = false);
+	void run(ThreadPool &pool = ThreadPool::shared()); // blocks until every task finished
+	int size() const { return nodes.size(); }
+private:
+	struct State;
+	void launch(const std::shared_ptr<State> &state, ThreadPool &pool, Id id);
+	void execute(const std::shared_ptr<State> &state, ThreadPool &pool, Id id);
+	struct Node {
+		std::function<void()> func;
+		std::vector<Id> dependents;
+		int deps_count = 0;
+		bool main_thread = false;
+	};
+	std::vector<Node> nodes;
+};
+
+template<typename F>
+auto ThreadPool::submit(F &&func) -> std::future<decltype(func())> {
+	using R = decltype(func());
+	// std::function needs a copyable target, packaged_task is move-only
+	auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+	std::future<R> ret = task->get_future();
+	enqueue([task](){ (*task)(); });
+	return ret;
+}
+
+template<typename F>
+auto ThreadPool::submitToMainThread(F &&func) -> std::future<decltype(func())> {
+	using R = decltype(func());
+	auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+	std::future<R> ret = task->get_future();
+	std::lock_guard<std::mutex> lock(main_mtx);
+	main_tasks.push_back([task](){ (*task)(); });
+	return ret;
+}
+
+template<typename F>
+void ThreadPool::parallelFor(int n, int min_chunk, const F &func) {
+	int chunks = std::min((n+std::max(min_chunk,1)-1)/std::max(min_chunk,1),4*size());
+	if (chunks<=1) { for(int i=0;i<n;++i) func(i); return; }
+	struct State { std::atomic<int> next{0}, done{0}; std::mutex mtx; std::condition_variable cv; };
+	auto state = std::make_shared<State>();
+	// a worker that starts after every chunk was taken returns without touching func
+	auto work = [state,n,chunks,&func]() {
+		for(int c; (c = state->next++)<chunks; ) {
+			int first = int(static_cast<long long>(n)*c/chunks), last = int(static_cast<long long>(n)*(c+1)/chunks);
+			for(int i=first;i<last;++i) func(i);
+			if (++state->done==chunks) { std::lock_guard<std::mutex> lock(state->mtx); state->cv.notify_all(); }
+		}
+	};
+	for(int i=std::min(chunks-1,size());i>0;--i) enqueue(work);
+	work();
+	std::unique_lock<std::mutex> lock(state->mtx);
+	state->cv.wait(lock,[&](){ return state->done==chunks; });
+}
+
+#endif
+
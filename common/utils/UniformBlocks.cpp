@@ -0,0 +1,79 @@
+#include <cstring>
+#include "UniformBlocks.hpp"
+
+namespace uniform_blocks {
+	
+static_assert(sizeof(Camera)==2*64,"Camera does not match its std140 layout");
+static_assert(sizeof(Lights)==3*16,"Lights does not match its std140 layout");
+
+namespace {
+	
+	template<typename Block, Binding binding>
+	struct Buffer {
+		Block data;
+		GLuint ubo = 0;
+		bool uploaded = false;
+		void upload(const Block &new_data) {
+			if (uploaded and std::memcmp(&new_data,&data,sizeof(Block))==0) return;
+			if (ubo==0) {
+				glGenBuffers(1,&ubo);
+				glBindBuffer(GL_UNIFORM_BUFFER,ubo);
+				glBufferData(GL_UNIFORM_BUFFER,sizeof(Block),nullptr,GL_DYNAMIC_DRAW);
+				glBindBufferBase(GL_UNIFORM_BUFFER,binding,ubo);
+			} else
+				glBindBuffer(GL_UNIFORM_BUFFER,ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER,0,sizeof(Block),&new_data);
+			data = new_data;
+			uploaded = true;
+		}
+	};
+	
+	Buffer<Camera,bCamera> camera_buffer;
+	Buffer<Lights,bLights> lights_buffer;
+	glm::vec4 light_position = {0.f,0.f,1.f,0.f};
+	glm::vec3 light_color = {1.f,1.f,1.f};
+	float light_ambient = 0.f;
+	
+	void updateLights() {
+		Lights l;
+		l.lightPosition = light_position;
+		l.lightVSPosition = camera_buffer.data.viewMatrix * light_position;
+		l.lightColor = light_color;
+		l.ambientStrength = light_ambient;
+		lights_buffer.upload(l);
+	}
+	
+}
+
+void setCamera(const glm::mat4 &view, const glm::mat4 &projection) {
+	Camera c;
+	c.viewMatrix = view;
+	c.projectionMatrix = projection;
+	camera_buffer.upload(c);
+	if (lights_buffer.uploaded) updateLights(); // view space position depends on the camera
+}
+
+void setLight(const glm::vec4 &position, const glm::vec3 &color, float ambient_strength) {
+	light_position = position;
+	light_color = color;
+	light_ambient = ambient_strength;
+	updateLights();
+}
+
+const Camera &camera() {
+	return camera_buffer.data;
+}
+
+const Lights &lights() {
+	return lights_buffer.data;
+}
+
+void bindProgramBlocks(GLuint program_id) {
+	GLuint index = glGetUniformBlockIndex(program_id,"Camera");
+	if (index!=GL_INVALID_INDEX) glUniformBlockBinding(program_id,index,bCamera);
+	index = glGetUniformBlockIndex(program_id,"Lights");
+	if (index!=GL_INVALID_INDEX) glUniformBlockBinding(program_id,index,bLights);
+}
+
+} // namespace uniform_blocks
+
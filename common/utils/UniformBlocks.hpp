@@ -0,0 +1,41 @@
+#ifndef UNIFORMBLOCKS_HPP
+#define UNIFORMBLOCKS_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Uniform blocks shared by every program (see shaders/funcs/uniformBlocks.glsl).
+// They are written once per frame and bound to fixed binding points, Shader::load
+// connects the blocks of each program to those binding points.
+namespace uniform_blocks {
+	
+enum Binding { bCamera=0, bLights=1 };
+
+// std140 layouts, must match the glsl declarations
+struct Camera {
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+};
+
+struct Lights {
+	glm::vec4 lightPosition;
+	glm::vec4 lightVSPosition; // in view space
+	glm::vec3 lightColor;
+	float ambientStrength;
+};
+
+// both skip the upload if nothing changed
+void setCamera(const glm::mat4 &view, const glm::mat4 &projection);
+void setLight(const glm::vec4 &position, const glm::vec3 &color, float ambient_strength);
+
+// last values written
+const Camera &camera();
+const Lights &lights();
+
+// connects a program's blocks (if it has them) to their binding points
+void bindProgramBlocks(GLuint program_id);
+
+} // namespace uniform_blocks
+
+#endif
+
@@ -1,8 +1,11 @@
+#include <cstdlib>
 #include <stdexcept>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 #include "Window.hpp"
 #include "Debug.hpp"
+#include "GLExtensions.hpp"
+#include "MemoryStats.hpp"
 #include <iomanip>
 #include <sstream>
 
@@ -35,6 +38,7 @@ Window::Window (int w, int h, const std::string & title, int flags, GLFWwindow *
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT,GL_TRUE); // mac-os bug?
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	if (flags&fAntialiasing) glfwWindowHint(GLFW_SAMPLES,4); // antialiasing
+	glfwWindowHint(GLFW_VISIBLE,(flags&fHidden)?GLFW_FALSE:GLFW_TRUE); // hidden windows are just for sharing contexts
 	
 	glfwMakeContextCurrent(nullptr);
 	win_ptr = glfwCreateWindow(w,h,title.c_str(),nullptr,share_context_with);
@@ -43,6 +47,7 @@ Window::Window (int w, int h, const std::string & title, int flags, GLFWwindow *
 	
 	if (windows_count==0 and (not gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)))
 		cg_error("Failed to initialize GLAD")
+	if (windows_count==0) setGLProcLoader((GLADloadproc)glfwGetProcAddress);
 		
 	if (windows_count==0)
 		cg_info(std::string("OpenGL version: ")+reinterpret_cast<const char*>(glGetString(GL_VERSION)));
@@ -66,9 +71,28 @@ Window::Window (int w, int h, const std::string & title, int flags, GLFWwindow *
 	++windows_count;
 }
 
+namespace {
+	// imgui's heap goes through these so it shows up in memory_stats, the size is
+	// kept before each block (16 bytes, to keep malloc's alignment)
+	void *imguiAlloc(size_t size, void *) {
+		char *p = static_cast<char*>(malloc(size+16));
+		if (!p) return nullptr;
+		*reinterpret_cast<size_t*>(p) = size;
+		memory_stats::add(memory_stats::cImGui,size);
+		return p+16;
+	}
+	void imguiFree(void *ptr, void *) {
+		if (!ptr) return;
+		char *p = static_cast<char*>(ptr)-16;
+		memory_stats::add(memory_stats::cImGui,-static_cast<long long>(*reinterpret_cast<size_t*>(p)));
+		free(p);
+	}
+}
+
 ImGuiContext * Window::EnableImgui ( ) {
 	cg_assert(!imgui_context,"ImGui already initialized for this window");
 	IMGUI_CHECKVERSION();
+	ImGui::SetAllocatorFunctions(&imguiAlloc,&imguiFree);
 	imgui_context = ImGui::CreateContext();
 	ImGui::SetCurrentContext(imgui_context); // si no es el 1er context, el create no lo define como current
 	ImGui_ImplGlfw_InitForOpenGL(win_ptr,true);
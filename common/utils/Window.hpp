@@ -11,7 +11,7 @@
 class Window {
 public:
 	
-	enum Flags { fNone=0, fAntialiasing=2, fBlend=4, fDepth=8 };
+	enum Flags { fNone=0, fAntialiasing=2, fBlend=4, fDepth=8, fHidden=16 };
 	static int fDefaults; // = fAntialiasing|fDepth;
 	
 	Window() = default;
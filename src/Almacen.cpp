@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "Almacen.hpp"
+using namespace std;
+
+namespace {
+	const char magia[8] = {'C','G','T','I','L','E','S','1'};
+	const uint32_t versionArchivo = 2; // la 1 guardaba tambien niveles reducidos
+	const size_t tamanioCabecera = 4096; // la cabecera ocupa una pagina, el indice empieza alineado
+
+	uint32_t mezclar(uint32_t h) {
+		h ^= h>>16; h *= 0x85ebca6bu;
+		h ^= h>>13; h *= 0xc2b2ae35u;
+		h ^= h>>16;
+		return h;
+	}
+
+	// los enteros de la diferencia con la prediccion, de a 7 bits (el de arriba dice si sigue)
+	void escribirVarint(vector<unsigned char> &v, uint32_t n) {
+		while(n>=0x80) { v.push_back(uint8_t(n|0x80)); n >>= 7; }
+		v.push_back(uint8_t(n));
+	}
+
+	bool leerVarint(const unsigned char *&p, const unsigned char *fin, uint32_t &n) {
+		n = 0;
+		for(int corrimiento=0;corrimiento<32;corrimiento+=7) {
+			if(p==fin) return false;
+			uint8_t b = *p++;
+			n |= uint32_t(b&0x7f)<<corrimiento;
+			if(!(b&0x80)) return true;
+		}
+		return false;
+	}
+
+	// prediccion de la muestra (a,b) con las ya decodificadas: izquierda+arriba-diagonal
+	inline int predecir(const vector<int> &q, int n, int a, int b) {
+		if(a>0 && b>0) return q[a*n+b-1]+q[(a-1)*n+b]-q[(a-1)*n+b-1];
+		if(b>0) return q[a*n+b-1];
+		if(a>0) return q[(a-1)*n+b];
+		return 0;
+	}
+
+	// minimo y escala, y las diferencias; alturas es de n x n
+	void codificar(vector<unsigned char> &v, const float *alturas, int n) {
+		float minimo = *min_element(alturas,alturas+n*n);
+		float maximo = *max_element(alturas,alturas+n*n);
+		float escala = (maximo-minimo)/65535.f;
+		vector<int> q(n*n);
+		for(int i=0;i<n*n;i++)
+			q[i] = escala>0.f ? min(max(int(lround((alturas[i]-minimo)/escala)),0),65535) : 0;
+		size_t inicio = v.size();
+		v.resize(inicio+2*sizeof(float));
+		memcpy(&v[inicio],&minimo,sizeof(float));
+		memcpy(&v[inicio+sizeof(float)],&escala,sizeof(float));
+		for(int a=0;a<n;a++) {
+			for(int b=0;b<n;b++) {
+				int r = q[a*n+b]-predecir(q,n,a,b);
+				escribirVarint(v,(uint32_t(r)<<1)^uint32_t(r>>31)); // zigzag: los chicos en pocos bytes
+			}
+		}
+	}
+
+	bool decodificar(const unsigned char *p, const unsigned char *fin, int n, float *alturas) {
+		if(fin-p<ptrdiff_t(2*sizeof(float))) return false;
+		float minimo, escala;
+		memcpy(&minimo,p,sizeof(float));
+		memcpy(&escala,p+sizeof(float),sizeof(float));
+		p += 2*sizeof(float);
+		vector<int> q(n*n);
+		for(int a=0;a<n;a++) {
+			for(int b=0;b<n;b++) {
+				uint32_t z;
+				if(!leerVarint(p,fin,z)) return false;
+				int r = int(z>>1)^-int(z&1);
+				q[a*n+b] = predecir(q,n,a,b)+r;
+				alturas[a*n+b] = minimo+q[a*n+b]*escala;
+			}
+		}
+		return true;
+	}
+}
+
+// Todo lo que se modifica desde varios hilos es atomico y esta alineado; el
+// resto se escribe al crear el archivo.
+struct AlmacenDeParcelas::Cabecera {
+	char magia[8];
+	uint32_t version;
+	int32_t lado;
+	int32_t tamanioMapa, numeroDeOctavas, freq, amp, seed; // el ruido (sin el nivel del mar)
+	float persistency, lacunarity;
+	uint32_t entradas; // del indice, potencia de 2
+	uint64_t inicioDatos, capacidad;
+	std::atomic<uint64_t> fin; // hasta donde hay datos
+	std::atomic<int64_t> parcelas, bytesSinComprimir;
+};
+
+struct AlmacenDeParcelas::Entrada {
+	std::atomic<uint32_t> estado; // eLibre, eEscribiendo, eLista o eDescartada (no hubo lugar para los datos)
+	int32_t x, z;
+	uint32_t bytes;
+	uint64_t posicion; // desde el principio del archivo
+};
+
+enum { eLibre = 0, eEscribiendo = 1, eLista = 2, eDescartada = 3 };
+
+AlmacenDeParcelas::Cabecera *AlmacenDeParcelas::cabecera() const {
+	return reinterpret_cast<Cabecera*>(const_cast<unsigned char*>(archivo.data()));
+}
+
+AlmacenDeParcelas::Entrada *AlmacenDeParcelas::indice() const {
+	return reinterpret_cast<Entrada*>(const_cast<unsigned char*>(archivo.data())+tamanioCabecera);
+}
+
+bool AlmacenDeParcelas::abrir(const string &nombre, const ParametrosTerreno &p, int lado, size_t capacidad, int entradas) {
+	static_assert(sizeof(Cabecera)<=tamanioCabecera,"La cabecera no entra en su pagina");
+	static_assert(sizeof(std::atomic<uint64_t>)==sizeof(uint64_t) && sizeof(std::atomic<uint32_t>)==sizeof(uint32_t),
+				  "Los atomicos no tienen el tamanio de lo que guardan");
+	cerrar();
+	if(lado<1) return false;
+	ladoParcela = lado;
+	uint32_t potencia = 1;
+	while(potencia<uint32_t(max(entradas,1))) potencia *= 2;
+	uint64_t inicioDatos = tamanioCabecera+uint64_t(potencia)*sizeof(Entrada);
+	capacidad = max<size_t>(capacidad,inicioDatos+(size_t(1)<<20));
+
+	archivo = MappedFile(nombre,capacidad);
+	if(!archivo.isOk()) return false;
+
+	Cabecera *c = cabecera();
+	bool igual = equal(magia,magia+8,c->magia) && c->version==versionArchivo && c->lado==lado
+		&& c->tamanioMapa==p.tamanioMapa && c->numeroDeOctavas==p.numeroDeOctavas && c->freq==p.freq && c->amp==p.amp
+		&& c->seed==p.seed && c->persistency==p.persistency && c->lacunarity==p.lacunarity
+		&& c->entradas==potencia && c->inicioDatos==inicioDatos && c->fin>=inicioDatos && c->fin<=capacidad;
+	if(!igual) {
+		// otro mundo, otra version, o nuevo: se empieza de cero
+		memset(archivo.writableData(),0,inicioDatos);
+		copy(magia,magia+8,c->magia);
+		c->version = versionArchivo;
+		c->lado = lado;
+		c->tamanioMapa = p.tamanioMapa; c->numeroDeOctavas = p.numeroDeOctavas; c->freq = p.freq; c->amp = p.amp;
+		c->seed = p.seed; c->persistency = p.persistency; c->lacunarity = p.lacunarity;
+		c->entradas = potencia;
+		c->inicioDatos = inicioDatos;
+		c->fin = inicioDatos;
+	}
+	c->capacidad = capacidad;
+	return true;
+}
+
+void AlmacenDeParcelas::cerrar() {
+	if(!abierto()) return;
+	archivo.setFinalSize(cabecera()->fin); // lo que sobra del mapeo no se guarda
+	archivo = MappedFile();
+}
+
+const AlmacenDeParcelas::Entrada *AlmacenDeParcelas::buscar(int x, int z) const {
+	if(!abierto()) return nullptr;
+	const Cabecera *c = cabecera();
+	const Entrada *tabla = indice();
+	uint32_t mascara = c->entradas-1;
+	uint32_t j = mezclar(uint32_t(x)*0x9e3779b1u^mezclar(uint32_t(z)))&mascara;
+	for(uint32_t i=0;i<c->entradas;i++,j=(j+1)&mascara) {
+		uint32_t estado = tabla[j].estado.load(memory_order_acquire);
+		if(estado==eLibre) return nullptr;
+		// las que se estan escribiendo (o descartadas) se saltean: a lo sumo se genera de nuevo
+		if(estado==eLista && tabla[j].x==x && tabla[j].z==z) return &tabla[j];
+	}
+	return nullptr;
+}
+
+bool AlmacenDeParcelas::guardar(int x, int z, const float *alturas) {
+	if(!abierto()) return false;
+	// primero se codifica aparte
+	int n = muestras();
+	vector<unsigned char> datos;
+	codificar(datos,alturas,n);
+	datos.resize((datos.size()+7)&~size_t(7)); // para que la siguiente empiece alineada
+	Cabecera *c = cabecera();
+	if(c->fin.load()+datos.size()>c->capacidad) return false; // lleno, sin gastar una entrada
+
+	// despues la entrada del indice, antes que el lugar para los datos: si el
+	// indice esta lleno (o ya estaba guardada) no se gasta espacio del archivo
+	Entrada *tabla = indice(), *e = nullptr;
+	uint32_t mascara = c->entradas-1;
+	uint32_t j = mezclar(uint32_t(x)*0x9e3779b1u^mezclar(uint32_t(z)))&mascara;
+	for(uint32_t i=0;i<c->entradas && !e;i++,j=(j+1)&mascara) {
+		uint32_t estado = eLibre;
+		if(tabla[j].estado.compare_exchange_strong(estado,eEscribiendo)) e = &tabla[j];
+		else if(estado==eLista && tabla[j].x==x && tabla[j].z==z) return true; // otro hilo la guardo antes
+	}
+	if(!e) return false; // indice lleno
+
+	// el lugar para los datos, sin pasarse de la capacidad
+	uint64_t posicion = c->fin.load();
+	do {
+		if(posicion+datos.size()>c->capacidad) {
+			// otro hilo tomo lo que quedaba; la entrada no se puede liberar (alguna
+			// guardada despues pudo haberla salteado), queda descartada
+			e->estado.store(eDescartada,memory_order_release);
+			return false;
+		}
+	} while(!c->fin.compare_exchange_weak(posicion,posicion+datos.size()));
+	memcpy(archivo.writableData()+posicion,datos.data(),datos.size());
+
+	// se publica (eLista) cuando ya esta todo escrito
+	e->x = x; e->z = z;
+	e->bytes = datos.size();
+	e->posicion = posicion;
+	e->estado.store(eLista,memory_order_release);
+	++c->parcelas;
+	c->bytesSinComprimir += int64_t(n)*n*sizeof(float);
+	return true;
+}
+
+bool AlmacenDeParcelas::leer(int x, int z, float *alturas) const {
+	const Entrada *e = buscar(x,z);
+	if(!e) return false;
+	if(e->posicion+e->bytes>cabecera()->fin) return false;
+	const unsigned char *datos = archivo.data()+e->posicion;
+	return decodificar(datos,datos+e->bytes,muestras(),alturas);
+}
+
+AlmacenDeParcelas::Estadisticas AlmacenDeParcelas::estadisticas() const {
+	Estadisticas e;
+	if(!abierto()) return e;
+	const Cabecera *c = cabecera();
+	e.parcelas = c->parcelas;
+	e.bytes = c->fin-c->inicioDatos;
+	e.bytesSinComprimir = c->bytesSinComprimir;
+	return e;
+}
+
+string AlmacenDeParcelas::nombreArchivo(const string &prefijo, const ParametrosTerreno &p) {
+	// fnv-1a de los parametros que cambian las alturas
+	uint64_t h = 1469598103934665603ull;
+	auto agregar = [&](const void *v, size_t n) {
+		for(size_t i=0;i<n;i++) { h ^= static_cast<const unsigned char*>(v)[i]; h *= 1099511628211ull; }
+	};
+	agregar(&p.tamanioMapa,sizeof(int)); agregar(&p.numeroDeOctavas,sizeof(int));
+	agregar(&p.freq,sizeof(int)); agregar(&p.amp,sizeof(int)); agregar(&p.seed,sizeof(int));
+	agregar(&p.persistency,sizeof(float)); agregar(&p.lacunarity,sizeof(float));
+	char hex[17];
+	snprintf(hex,sizeof(hex),"%016llx",static_cast<unsigned long long>(h));
+	return prefijo+hex+".cgtiles";
+}
+
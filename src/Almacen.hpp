@@ -0,0 +1,71 @@
+#ifndef ALMACEN_HPP
+#define ALMACEN_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+#include "Terreno.hpp"
+
+// Parcelas del mundo ya generadas (las alturas, sin restar el nivel del mar), en
+// un solo archivo mapeado en memoria, para no volver a generarlas al pasar de
+// nuevo por el mismo lugar ni al abrir otra vez el mismo mundo.
+//
+// El archivo tiene una cabecera (los parametros del ruido, para no mezclar
+// mundos), un indice de tamanio fijo (tabla hash con direccionamiento abierto) y
+// despues los datos, uno atras de otro. Leer es buscar en el indice y decodificar
+// directo desde el mapeo, sin cargar nada antes: el costo es el de los fallos de
+// pagina. Guardar se puede hacer desde varios hilos a la vez: la entrada del
+// indice y despues el lugar para los datos se toman con operaciones atomicas
+// sobre el mapeo.
+//
+// Se guarda solo la resolucion completa (el mundo dibuja todas las parcelas con
+// la misma malla). Cada parcela se cuantiza a 16 bits entre su minimo y su
+// maximo (error menor a (max-min)/131070) y eso se codifica sin perdida: la
+// diferencia con la prediccion de sus vecinos ya decodificados, en 1 a 3 bytes.
+class AlmacenDeParcelas {
+public:
+	AlmacenDeParcelas() = default;
+	~AlmacenDeParcelas() { cerrar(); }
+
+	// abre o crea el archivo para parcelas de lado x lado cuadrados de ese ruido;
+	// si ya existia con otros parametros (o esta roto) se empieza de nuevo.
+	// capacidad es el maximo de bytes del archivo, entradas el de parcelas
+	bool abrir(const std::string &archivo, const ParametrosTerreno &p, int lado,
+			   size_t capacidad = size_t(256)<<20, int entradas = 1<<16);
+	void cerrar(); // deja el archivo del tamanio justo
+	bool abierto() const { return archivo.isOk(); }
+
+	int lado() const { return ladoParcela; }
+	int muestras() const { return ladoParcela+1; } // por lado
+
+	// las alturas van con x primero: alturas[a*(lado+1)+b] es la muestra (a,b).
+	// guardar se puede llamar desde varios hilos; false si no hay mas lugar
+	bool guardar(int x, int z, const float *alturas);
+	// alturas debe tener lugar para muestras()^2; false si no esta
+	bool leer(int x, int z, float *alturas) const;
+	bool contiene(int x, int z) const { return buscar(x,z)!=nullptr; }
+
+	struct Estadisticas {
+		long long parcelas = 0;
+		long long bytes = 0, bytesSinComprimir = 0; // de los datos, sin la cabecera ni el indice
+	};
+	Estadisticas estadisticas() const;
+
+	// nombre de archivo para un mundo: prefijo mas una huella de los parametros del
+	// ruido (el nivel del mar no cambia las alturas guardadas)
+	static std::string nombreArchivo(const std::string &prefijo, const ParametrosTerreno &p);
+
+private:
+	struct Cabecera;
+	struct Entrada;
+	Cabecera *cabecera() const;
+	Entrada *indice() const;
+	const Entrada *buscar(int x, int z) const;
+
+	MappedFile archivo;
+	int ladoParcela = 0;
+};
+
+#endif
+
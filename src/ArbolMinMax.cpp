@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "ArbolMinMax.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+void ArbolMinMax::construir(const MapaDeRuido &m) {
+	mapa = &m;
+	celdas = int(m.size())-1;
+	lados.clear();
+	niveles.clear();
+	if(celdas<1) return;
+	for(int n=celdas;;n=(n+1)/2) {
+		lados.push_back(n);
+		niveles.emplace_back(size_t(n)*n);
+		if(n==1) break;
+	}
+	// cada nivel depende solo del anterior: en paralelo por filas dentro de cada uno
+	for(size_t k=0;k<niveles.size();k++) {
+		int n = lados[k];
+		ThreadPool::shared().parallelFor(n,max(1,4096/n),[&](int i){
+			for(int j=0;j<n;j++) recalcularNodo(k,i,j);
+		});
+	}
+}
+
+void ArbolMinMax::actualizar(const MapaDeRuido &m, int x0, int z0, int x1, int z1) {
+	if(int(m.size())-1!=celdas || vacio()) { construir(m); return; }
+	mapa = &m;
+	// una muestra cambia las (hasta) 4 celdas que la tienen de esquina
+	int i0 = max(x0-1,0), j0 = max(z0-1,0);
+	int i1 = min(x1,celdas-1), j1 = min(z1,celdas-1);
+	for(size_t k=0;k<niveles.size() && i0<=i1 && j0<=j1;k++) {
+		for(int i=i0;i<=i1;i++)
+			for(int j=j0;j<=j1;j++)
+				recalcularNodo(k,i,j);
+		i0>>=1; j0>>=1; i1>>=1; j1>>=1;
+	}
+}
+
+void ArbolMinMax::recalcularNodo(int nivel, int i, int j) {
+	glm::vec2 r;
+	if(nivel==0) {
+		const MapaDeRuido &m = *mapa;
+		float a = m[i][j], b = m[i+1][j], c = m[i][j+1], d = m[i+1][j+1];
+		r = glm::vec2(min(min(a,b),min(c,d)),max(max(a,b),max(c,d)));
+	} else {
+		int n = lados[nivel-1];
+		const vector<glm::vec2> &hijos = niveles[nivel-1];
+		r = glm::vec2(numeric_limits<float>::max(),-numeric_limits<float>::max());
+		for(int a=2*i;a<=2*i+1 && a<n;a++) {
+			for(int b=2*j;b<=2*j+1 && b<n;b++) {
+				r.x = min(r.x,hijos[a*n+b].x);
+				r.y = max(r.y,hijos[a*n+b].y);
+			}
+		}
+	}
+	niveles[nivel][i*lados[nivel]+j] = r;
+}
+
+void ArbolMinMax::rangoEnNodo(int nivel, int i, int j, int i0, int j0, int i1, int j1, glm::vec2 &r) const {
+	// celdas que cubre el nodo
+	int a0 = i<<nivel, b0 = j<<nivel;
+	int a1 = min(((i+1)<<nivel)-1,celdas-1), b1 = min(((j+1)<<nivel)-1,celdas-1);
+	if(a1<i0 || a0>i1 || b1<j0 || b0>j1) return;
+	if(a0>=i0 && a1<=i1 && b0>=j0 && b1<=j1) {
+		const glm::vec2 &n = niveles[nivel][i*lados[nivel]+j];
+		r.x = min(r.x,n.x);
+		r.y = max(r.y,n.y);
+		return;
+	}
+	int n = lados[nivel-1];
+	for(int a=2*i;a<=2*i+1 && a<n;a++)
+		for(int b=2*j;b<=2*j+1 && b<n;b++)
+			rangoEnNodo(nivel-1,a,b,i0,j0,i1,j1,r);
+}
+
+glm::vec2 ArbolMinMax::rango(int x0, int z0, int x1, int z1) const {
+	glm::vec2 r(numeric_limits<float>::max(),-numeric_limits<float>::max());
+	if(vacio()) return r;
+	// celdas que tienen esas muestras (una sola muestra: la celda que empieza ahi)
+	int i0 = min(max(x0,0),celdas-1), j0 = min(max(z0,0),celdas-1);
+	int i1 = min(max(x1-1,i0),celdas-1), j1 = min(max(z1-1,j0),celdas-1);
+	rangoEnNodo(niveles.size()-1,0,0,i0,j0,i1,j1,r);
+	return r;
+}
+
+bool ArbolMinMax::intersectarCelda(int i, int j, const glm::vec3 &o, const glm::vec3 &d, float t0, float t1, float &t) const {
+	// la superficie es h = h00 + A u + B v + C u v, con u,v relativos a la celda; a
+	// lo largo del rayo f(t) = y(t)-h(t) = a t^2 + b t + c
+	const MapaDeRuido &m = *mapa;
+	double h00 = m[i][j], h10 = m[i+1][j], h01 = m[i][j+1], h11 = m[i+1][j+1];
+	double A = h10-h00, B = h01-h00, C = h00-h10-h01+h11;
+	double u0 = double(o.x)-i, v0 = double(o.z)-j, du = d.x, dv = d.z;
+	double a = -C*du*dv;
+	double b = d.y-(A*du+B*dv+C*(u0*dv+v0*du));
+	double c = o.y-(h00+A*u0+B*v0+C*u0*v0);
+	auto f = [&](double x) { return (a*x+b)*x+c; };
+	if(f(t0)<=0.0) { t = t0; return true; } // ya entra por debajo
+	if(f(t1)>0.0 && a==0.0) return false;
+	// la raiz mas chica en [t0,t1]
+	double mejor = numeric_limits<double>::max();
+	auto probar = [&](double x) { if(x>=t0 && x<=t1 && x<mejor) mejor = x; };
+	if(fabs(a)<1e-12*max(1.0,fabs(b))) {
+		if(b!=0.0) probar(-c/b);
+	} else {
+		double disc = b*b-4.0*a*c;
+		if(disc>=0.0) {
+			// la forma que no resta numeros parecidos
+			double q = -0.5*(b+(b<0.0?-1.0:1.0)*sqrt(disc));
+			probar(q/a);
+			if(q!=0.0) probar(c/q);
+		}
+	}
+	if(mejor==numeric_limits<double>::max()) {
+		if(f(t1)>0.0) return false;
+		mejor = t1; // por redondeo, pero termina debajo
+	}
+	t = float(mejor);
+	return true;
+}
+
+bool ArbolMinMax::intersectar(const glm::vec3 &origen, const glm::vec3 &direccion, float tMax, float &t, int *visitados) const {
+	if(visitados) *visitados = 0;
+	if(vacio()) return false;
+	// a muestras del mapa en x,z (t no cambia)
+	float escala = 0.5f*celdas;
+	glm::vec3 o((origen.x+1.f)*escala,origen.y,(origen.z+1.f)*escala);
+	glm::vec3 d(direccion.x*escala,direccion.y,direccion.z*escala);
+	glm::vec2 inv(1.f/d.x,1.f/d.z);
+
+	// tramo [t0,t1] del rayo sobre la caja xz de un nodo
+	auto tramo = [&](int nivel, int i, int j, float &t0, float &t1) {
+		float x0 = float(i<<nivel), x1 = float(min((i+1)<<nivel,celdas));
+		float z0 = float(j<<nivel), z1 = float(min((j+1)<<nivel,celdas));
+		t0 = 0.f; t1 = tMax;
+		if(d.x==0.f) { if(o.x<x0 || o.x>x1) return false; }
+		else {
+			float a = (x0-o.x)*inv.x, b = (x1-o.x)*inv.x;
+			t0 = max(t0,min(a,b)); t1 = min(t1,max(a,b));
+		}
+		if(d.z==0.f) { if(o.z<z0 || o.z>z1) return false; }
+		else {
+			float a = (z0-o.z)*inv.y, b = (z1-o.z)*inv.y;
+			t0 = max(t0,min(a,b)); t1 = min(t1,max(a,b));
+		}
+		return t0<=t1;
+	};
+
+	struct Nodo { int nivel, i, j; float t0, t1; };
+	vector<Nodo> pila;
+	Nodo raiz{int(niveles.size())-1,0,0,0.f,0.f};
+	if(!tramo(raiz.nivel,0,0,raiz.t0,raiz.t1)) return false;
+	pila.push_back(raiz);
+	while(!pila.empty()) {
+		Nodo n = pila.back();
+		pila.pop_back();
+		if(visitados) ++*visitados;
+		// el rayo pasa por encima de todo lo del nodo
+		float yMin = min(o.y+d.y*n.t0,o.y+d.y*n.t1);
+		if(yMin>niveles[n.nivel][n.i*lados[n.nivel]+n.j].y) continue;
+		if(n.nivel==0) {
+			if(intersectarCelda(n.i,n.j,o,d,n.t0,n.t1,t)) return true;
+			continue;
+		}
+		// los hijos que toca, del mas cercano al mas lejano (se apilan al reves);
+		// como no se superponen, el primer choque es el mas cercano
+		Nodo hijos[4];
+		int cantidad = 0, m = lados[n.nivel-1];
+		for(int a=2*n.i;a<=2*n.i+1 && a<m;a++) {
+			for(int b=2*n.j;b<=2*n.j+1 && b<m;b++) {
+				Nodo h{n.nivel-1,a,b,0.f,0.f};
+				if(tramo(h.nivel,a,b,h.t0,h.t1)) hijos[cantidad++] = h;
+			}
+		}
+		sort(hijos,hijos+cantidad,[](const Nodo &x, const Nodo &y){ return x.t0>y.t0; });
+		pila.insert(pila.end(),hijos,hijos+cantidad);
+	}
+	return false;
+}
+
+bool ArbolMinMax::visible(const glm::vec3 &a, const glm::vec3 &b) const {
+	// sin el final del segmento, para que un punto sobre la superficie se vea
+	float t;
+	return !intersectar(a,b-a,1.f-1e-3f,t);
+}
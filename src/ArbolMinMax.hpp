@@ -0,0 +1,55 @@
+#ifndef ARBOLMINMAX_HPP
+#define ARBOLMINMAX_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Terreno.hpp"
+
+// Alturas minima y maxima por regiones del mapa de ruido, como un quadtree
+// implicito: en el nivel 0 cada celda del mapa (entre 4 muestras), y en cada
+// nivel siguiente cada nodo junta 2x2 del anterior, hasta uno solo.
+//
+// Un rayo baja solo por los nodos cuya caja lo tiene por debajo de su maximo, en
+// orden de cercania, y en las celdas que quedan se intersecta con la superficie
+// bilineal exacta (una cuadratica en t). Asi el picking con el mouse, la linea de
+// vision entre dos puntos y las consultas de rango visitan unos pocos nodos por
+// nivel en vez de recorrer celda por celda.
+//
+// Las coordenadas son las de alturaEn: x,z de -1 a 1, y la altura del mapa (sin
+// restar el nivel del mar).
+class ArbolMinMax {
+public:
+	// todo de nuevo (en paralelo); el mapa tiene que seguir ahi (y del mismo tamanio) mientras se use
+	void construir(const MapaDeRuido &mapa);
+	// cambiaron las muestras [x0,x1]x[z0,z1] (ej: los bloques que retallaron los
+	// caminos): se recalcula esa zona y sus ancestros
+	void actualizar(const MapaDeRuido &mapa, int x0, int z0, int x1, int z1);
+	bool vacio() const { return niveles.empty(); }
+
+	// de todo el mapa
+	float minimo() const { return niveles.back()[0].x; }
+	float maximo() const { return niveles.back()[0].y; }
+	// (minimo,maximo) de las celdas que cubren las muestras [x0,x1]x[z0,z1], 
+	// combinando O(log n) nodos por lado
+	glm::vec2 rango(int x0, int z0, int x1, int z1) const;
+
+	// primer t>=0 (hasta tMax) en que origen+t*direccion toca el terreno; si el
+	// origen ya esta debajo, t=0. visitados es opcional, los nodos que miro
+	bool intersectar(const glm::vec3 &origen, const glm::vec3 &direccion, float tMax, float &t, int *visitados=nullptr) const;
+	// si el segmento entre a y b no pasa por debajo del terreno (b puede estar sobre
+	// la superficie misma)
+	bool visible(const glm::vec3 &a, const glm::vec3 &b) const;
+
+private:
+	void recalcularNodo(int nivel, int i, int j);
+	void rangoEnNodo(int nivel, int i, int j, int i0, int j0, int i1, int j1, glm::vec2 &r) const;
+	bool intersectarCelda(int i, int j, const glm::vec3 &o, const glm::vec3 &d, float t0, float t1, float &t) const;
+
+	const MapaDeRuido *mapa = nullptr;
+	int celdas = 0;       // por lado en el nivel 0
+	std::vector<int> lados; // nodos por lado de cada nivel
+	std::vector<std::vector<glm::vec2>> niveles; // (min,max) de cada nodo, por filas
+};
+
+#endif
+
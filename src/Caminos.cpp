@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include "Caminos.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+void TalladorDeCaminos::setBase(const ParametrosTerreno &p, const MapaDeRuido &nuevaBase) {
+	parametros = p;
+	base = nuevaBase;
+	tallado = nuevaBase;
+	alturasBase = MuestreadorTerreno(base);
+	int muestras = int(base.size());
+	bloquesX = (muestras+tamanioBloque-1)/tamanioBloque;
+	porBloque.assign(bloquesX*bloquesX,vector<Referencia>());
+	pendiente.assign(bloquesX*bloquesX,0);
+	for(int id=0;id<int(caminos.size());id++) {
+		caminos[id].bloques.clear();
+		if(caminos[id].activo) agregarABloques(id);
+	}
+}
+
+int TalladorDeCaminos::agregar(const Camino &camino) {
+	caminos.emplace_back();
+	int id = int(caminos.size())-1;
+	mover(id,camino);
+	return id;
+}
+
+void TalladorDeCaminos::mover(int id, const Camino &camino) {
+	cg_assert(id>=0 && id<int(caminos.size()),"id de camino invalido");
+	quitarDeBloques(id);
+	caminos[id].camino = camino;
+	caminos[id].activo = true;
+	agregarABloques(id);
+}
+
+void TalladorDeCaminos::quitar(int id) {
+	cg_assert(id>=0 && id<int(caminos.size()),"id de camino invalido");
+	quitarDeBloques(id);
+	caminos[id].activo = false;
+	caminos[id].segmentos.clear();
+}
+
+void TalladorDeCaminos::construirSegmentos(Entrada &e) {
+	float escala = parametros.tamanioMapa*0.5f; // de [-1,1] a muestras
+	auto aMuestras = [&](const glm::vec3 &p) { return glm::vec2((p.x+1.f)*escala,(p.z+1.f)*escala); };
+	const Bezier<glm::vec3,3> &curva = e.camino.curva;
+
+	// tramos de unas 4 muestras (el poligono de control es mas largo que la curva)
+	float largo = 0.f;
+	for(int i=0;i<curva.degree();i++) largo += glm::length(aMuestras(curva[i+1])-aMuestras(curva[i]));
+	int n = min(max(int(largo/4.f)+1,4),256);
+	vector<glm::vec3> puntos(n+1);
+	curva.sample(puntos.data(),n+1);
+
+	e.radioInterior = e.camino.ancho*0.5f*escala;
+	e.radioExterior = e.radioInterior + e.camino.borde*escala;
+	// la altura objetivo sigue al terreno sin tallar por el eje de la curva
+	vector<float> alturas(n+1);
+	alturasBase.muestrear(puntos.data(),n+1,alturas.data());
+	e.segmentos.resize(n);
+	for(int i=0;i<n;i++) {
+		Segmento &s = e.segmentos[i];
+		s.a = aMuestras(puntos[i]);
+		s.ab = aMuestras(puntos[i+1])-s.a;
+		float largo2 = glm::dot(s.ab,s.ab);
+		s.invLargo2 = largo2>0.f ? 1.f/largo2 : 0.f;
+		s.ya = alturas[i] + puntos[i].y;
+		s.yb = alturas[i+1] + puntos[i+1].y;
+	}
+}
+
+void TalladorDeCaminos::agregarABloques(int id) {
+	Entrada &e = caminos[id];
+	if(base.empty()) return; // se reparte en setBase
+	construirSegmentos(e);
+	int ultimaMuestra = int(base.size())-1;
+	auto bloqueDe = [&](float m) { return min(max(int(floor(m)),0),ultimaMuestra)/tamanioBloque; };
+	for(int i=0;i<int(e.segmentos.size());i++) {
+		const Segmento &s = e.segmentos[i];
+		glm::vec2 b = s.a+s.ab;
+		float r = e.radioExterior;
+		// bloques que toca la caja del segmento ensanchada por el radio
+		int bx0 = bloqueDe(min(s.a.x,b.x)-r), bx1 = bloqueDe(ceil(max(s.a.x,b.x)+r));
+		int bz0 = bloqueDe(min(s.a.y,b.y)-r), bz1 = bloqueDe(ceil(max(s.a.y,b.y)+r));
+		for(int bx=bx0;bx<=bx1;bx++) {
+			for(int bz=bz0;bz<=bz1;bz++) {
+				int bloque = bz*bloquesX+bx;
+				porBloque[bloque].push_back({id,i});
+				e.bloques.push_back(bloque);
+			}
+		}
+	}
+	sort(e.bloques.begin(),e.bloques.end());
+	e.bloques.erase(unique(e.bloques.begin(),e.bloques.end()),e.bloques.end());
+	for(int bloque : e.bloques) {
+		// se aplican en orden de id, para que el resultado no dependa del orden de las ediciones
+		vector<Referencia> &refs = porBloque[bloque];
+		stable_sort(refs.begin(),refs.end(),[](const Referencia &a, const Referencia &b){ return a.camino<b.camino; });
+		pendiente[bloque] = 1;
+	}
+}
+
+void TalladorDeCaminos::quitarDeBloques(int id) {
+	for(int bloque : caminos[id].bloques) {
+		vector<Referencia> &refs = porBloque[bloque];
+		refs.erase(remove_if(refs.begin(),refs.end(),[id](const Referencia &r){ return r.camino==id; }),refs.end());
+		pendiente[bloque] = 1;
+	}
+	caminos[id].bloques.clear();
+}
+
+void TalladorDeCaminos::muestrasDeBloque(int bloque, int &x0, int &z0, int &x1, int &z1) const {
+	int muestras = int(base.size());
+	x0 = (bloque%bloquesX)*tamanioBloque; x1 = min(x0+tamanioBloque,muestras)-1;
+	z0 = (bloque/bloquesX)*tamanioBloque; z1 = min(z0+tamanioBloque,muestras)-1;
+}
+
+void TalladorDeCaminos::tallarBloque(int bloque) {
+	int muestras = int(base.size());
+	int x0 = (bloque%bloquesX)*tamanioBloque, x1 = min(x0+tamanioBloque,muestras);
+	int z0 = (bloque/bloquesX)*tamanioBloque, z1 = min(z0+tamanioBloque,muestras);
+	const vector<Referencia> &refs = porBloque[bloque];
+	for(int x=x0;x<x1;x++) {
+		for(int z=z0;z<z1;z++) {
+			float h = base[x][z];
+			glm::vec2 m(x,z);
+			for(size_t r=0;r<refs.size();) {
+				// el segmento mas cercano de este camino, y la altura objetivo en el
+				const Entrada &e = caminos[refs[r].camino];
+				float d2 = e.radioExterior*e.radioExterior, objetivo = 0.f;
+				bool cerca = false;
+				for(;r<refs.size() && &caminos[refs[r].camino]==&e;r++) {
+					const Segmento &s = e.segmentos[refs[r].segmento];
+					float t = min(max(glm::dot(m-s.a,s.ab)*s.invLargo2,0.f),1.f);
+					glm::vec2 v = m-(s.a+s.ab*t);
+					float dv = glm::dot(v,v);
+					if(dv<d2) { d2 = dv; objetivo = s.ya+(s.yb-s.ya)*t; cerca = true; }
+				}
+				if(!cerca) continue;
+				// 1 en el ancho, 0 fuera del borde, smoothstep entre medio
+				float d = sqrt(d2), peso = 1.f;
+				if(d>e.radioInterior) {
+					float u = (e.radioExterior-d)/(e.radioExterior-e.radioInterior);
+					peso = u*u*(3.f-2.f*u);
+				}
+				float nueva = h+(objetivo-h)*peso;
+				h = e.camino.tipo==Camino::cRio ? min(h,nueva) : nueva; // un rio solo cava
+			}
+			tallado[x][z] = h;
+		}
+	}
+}
+
+const MapaDeRuido &TalladorDeCaminos::aplicar() {
+	vector<int> bloques;
+	for(int b=0;b<int(pendiente.size());b++)
+		if(pendiente[b]) { bloques.push_back(b); pendiente[b] = 0; }
+	// cada bloque escribe solo sus muestras, y todos leen base y los segmentos
+	ThreadPool::shared().parallelFor(bloques.size(),1,[&](int i){ tallarBloque(bloques[i]); });
+	ultimosBloques.swap(bloques);
+	return tallado;
+}
@@ -0,0 +1,84 @@
+#ifndef CAMINOS_HPP
+#define CAMINOS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bezier.hpp"
+#include "Terreno.hpp"
+
+// Caminos y rios tallados en el mapa de ruido, despues de createNoiseMap.
+//
+// Cada curva se convierte en una polilinea, y sus segmentos se reparten en una
+// grilla de bloques del mapa (cada uno en todos los bloques que toca su
+// corredor, el segmento ensanchado por ancho/2+borde). Cada muestra solo se mide
+// contra los segmentos de su bloque, y los bloques se recalculan en paralelo
+// (ThreadPool::shared), independientes entre si. Al mover una curva solo se
+// recalculan los bloques que tocaba antes o toca ahora.
+
+struct Camino {
+	enum Tipo { cRuta, cRio };
+	Tipo tipo = cRuta;
+	// x,z en [-1,1] (como en alturaEn); y es la altura respecto del terreno en el
+	// eje de la curva: 0 para una ruta a nivel, negativo para la profundidad de un rio
+	Bezier<glm::vec3,3> curva;
+	float ancho = 0.06f; // en x,z, parte plana (o fondo del rio) completa
+	float borde = 0.06f; // en x,z, transicion suave a cada lado
+};
+
+class TalladorDeCaminos {
+public:
+	// nuevo mapa sin tallar (cambiaron los parametros del ruido): se recalcula todo
+	void setBase(const ParametrosTerreno &p, const MapaDeRuido &base);
+
+	// devuelven/usan un id que no cambia al quitar otros caminos
+	int agregar(const Camino &camino);
+	void mover(int id, const Camino &camino);
+	void quitar(int id);
+	const Camino &camino(int id) const { return caminos[id].camino; }
+	int cantidad() const { return caminos.size(); }
+
+	// recalcula los bloques pendientes y devuelve el mapa tallado
+	const MapaDeRuido &aplicar();
+
+	// bloques recalculados en el ultimo aplicar (para el perfil y las pruebas, y
+	// para actualizar lo que depende del mapa solo ahi)
+	int bloquesRecalculados() const { return int(ultimosBloques.size()); }
+	const std::vector<int> &ultimosRecalculados() const { return ultimosBloques; }
+	int bloquesTotales() const { return bloquesX*bloquesX; }
+	// muestras [x0,x1]x[z0,z1] (inclusive) de un bloque
+	void muestrasDeBloque(int bloque, int &x0, int &z0, int &x1, int &z1) const;
+
+	static constexpr int tamanioBloque = 16; // muestras por lado
+
+private:
+	struct Segmento {
+		glm::vec2 a, ab; // en muestras del mapa
+		float invLargo2;  // 1/|ab|^2 (0 si es un punto)
+		float ya, yb;     // altura objetivo en cada extremo
+	};
+	struct Entrada { // un camino y lo que se sabe de el para tallar
+		Camino camino;
+		bool activo = false;
+		float radioInterior = 0.f, radioExterior = 0.f; // en muestras
+		std::vector<Segmento> segmentos;
+		std::vector<int> bloques; // en los que tiene algun segmento
+	};
+	struct Referencia { int camino, segmento; };
+
+	void construirSegmentos(Entrada &e);
+	void agregarABloques(int id);
+	void quitarDeBloques(int id);
+	void tallarBloque(int bloque);
+
+	ParametrosTerreno parametros;
+	MapaDeRuido base, tallado;
+	MuestreadorTerreno alturasBase; // de base
+	std::vector<Entrada> caminos;
+	int bloquesX = 0;
+	std::vector<std::vector<Referencia>> porBloque; // ordenadas por camino
+	std::vector<char> pendiente;
+	std::vector<int> ultimosBloques;
+};
+
+#endif
+
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/ext.hpp>
+#include "Mundo.hpp"
+#include "Debug.hpp"
+#include "Shaders.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+MundoInfinito::MundoInfinito(int radio, int capacidad) {
+	setRadio(radio,capacidad);
+}
+
+MundoInfinito::~MundoInfinito() {
+	esperarPedidos();
+}
+
+void MundoInfinito::esperarPedidos() {
+	for(Pedido &p : pedidos) { 
+		p.datos.wait();
+		++totales.descartadas;
+	}
+	pedidos.clear();
+}
+
+void MundoInfinito::setAlmacen(const string &prefijo) {
+	if(prefijo==prefijoAlmacen) return;
+	esperarPedidos();
+	prefijoAlmacen = prefijo;
+	abrirAlmacen();
+}
+
+void MundoInfinito::abrirAlmacen() {
+	almacenParcelas.reset();
+	if(prefijoAlmacen.empty() || lado==0) return;
+	almacenParcelas.reset(new AlmacenDeParcelas());
+	string archivo = AlmacenDeParcelas::nombreArchivo(prefijoAlmacen,parametros);
+	if(!almacenParcelas->abrir(archivo,parametros,lado)) {
+		cg_info("No se pudo abrir el almacen de parcelas "+archivo);
+		almacenParcelas.reset();
+	}
+}
+
+void MundoInfinito::setRadio(int radio, int capacidad) {
+	radioParcelas = max(0,radio);
+	int porLado = 2*radioParcelas+1;
+	if(capacidad<=0) capacidad = (porLado+2)*(porLado+2);
+	// nunca menos que las que se dibujan a la vez
+	ranuras.resize(max(capacidad,porLado*porLado));
+}
+
+void MundoInfinito::setParametros(const ParametrosTerreno &p) {
+	parametros = p;
+	++version;
+	for(Ranura &r : ranuras) r.ocupada = false;
+	// hasta 128 cuadrados por lado, no mas que muestras tiene el mapa
+	int nuevoLado = min(max(p.tamanioMapa,1),128);
+	if(nuevoLado!=lado) {
+		lado = nuevoLado;
+		construirGrilla();
+	}
+	if(!prefijoAlmacen.empty()) {
+		// otro ruido, otro archivo (si solo cambio el nivel del mar, el mismo)
+		esperarPedidos(); // los que estan en curso usan el almacen anterior
+		abrirAlmacen();
+	}
+}
+
+void MundoInfinito::construirGrilla() {
+	for(Ranura &r : ranuras) r.buffers = GeometryRenderer(); // cambia la cantidad de vertices
+	grilla = Geometry();
+	for(int a=0;a<=lado;a++) {
+		for(int b=0;b<=lado;b++) {
+			grilla.positions.push_back(glm::vec3(-1.f+2.f*a/lado,0.f,-1.f+2.f*b/lado));
+			grilla.normals.push_back(glm::vec3(0.f,1.f,0.f));
+			grilla.tex_coords.push_back(glm::vec2(0.001f,0.5f));
+		}
+	}
+	for(int a=0;a<lado;a++) {
+		for(int b=0;b<lado;b++) {
+			int v = a*(lado+1)+b;
+			grilla.triangles.insert(grilla.triangles.end(),{v,v+1,v+lado+1, v+1,v+lado+2,v+lado+1});
+		}
+	}
+	grilla.trackMemory();
+}
+
+MundoInfinito::Datos MundoInfinito::generar(const ParametrosTerreno &p, int version, Id id, int lado, AlmacenDeParcelas *almacen) {
+	RuidoMundo ruido(p);
+	Datos d;
+	d.id = id;
+	d.version = version;
+
+	// alturas con un borde de una muestra para las normales; la posicion se calcula
+	// con numerador entero para que dos parcelas vecinas evaluen exactamente los
+	// mismos puntos en su borde (y en el de afuera)
+	int n = lado+3;
+	vector<float> alturas(n*n);
+	auto coordenada = [&](int parcela, int a) { return double((2LL*parcela-1)*lado+2LL*a)/lado; };
+	auto evaluar = [&](int a, int b) { alturas[(a+1)*n+(b+1)] = ruido.altura(coordenada(id.x,a),coordenada(id.z,b)); };
+	// si esta en el almacen solo se evaluan el borde de afuera y el propio (este
+	// exacto, como en las vecinas, para que no se abran grietas por la cuantizacion)
+	vector<float> interior((lado+1)*(lado+1));
+	d.leida = almacen && almacen->leer(id.x,id.z,interior.data());
+	for(int a=-1;a<=lado+1;a++) {
+		for(int b=-1;b<=lado+1;b++) {
+			bool borde = a<=0 || b<=0 || a>=lado || b>=lado;
+			if(d.leida && !borde) alturas[(a+1)*n+(b+1)] = interior[a*(lado+1)+b];
+			else evaluar(a,b);
+		}
+	}
+	auto altura = [&](int a, int b) { return alturas[(a+1)*n+(b+1)]; };
+	if(almacen && !d.leida) {
+		for(int a=0;a<=lado;a++)
+			for(int b=0;b<=lado;b++)
+				interior[a*(lado+1)+b] = altura(a,b);
+		almacen->guardar(id.x,id.z,interior.data()); // si no hay lugar, se generara otra vez
+	}
+
+	float paso = 2.f/lado;
+	d.posiciones.resize((lado+1)*(lado+1));
+	d.normales.resize(d.posiciones.size());
+	d.coords.resize(d.posiciones.size());
+	for(int a=0;a<=lado;a++) {
+		for(int b=0;b<=lado;b++) {
+			int i = a*(lado+1)+b;
+			float y = altura(a,b)-p.nivelMar;
+			d.posiciones[i] = glm::vec3(-1.f+2.f*a/lado,y,-1.f+2.f*b/lado);
+			float dx = (altura(a+1,b)-altura(a-1,b))/(2.f*paso);
+			float dz = (altura(a,b+1)-altura(a,b-1))/(2.f*paso);
+			d.normales[i] = glm::normalize(glm::vec3(-dx,1.f,-dz));
+			// la coordenada de textura como en modifyMesh
+			float s = 0.001f;
+			if(p.amp>0.f) s = y/p.amp;
+			d.coords[i] = glm::vec2(min(max(s,0.001f),0.999f),0.5f);
+		}
+	}
+	return d;
+}
+
+void MundoInfinito::cercanas(glm::vec2 centro, vector<Id> &ids) const {
+	int cx = int(floor((centro.x+1.f)*0.5f)), cz = int(floor((centro.y+1.f)*0.5f));
+	ids.clear();
+	for(int dx=-radioParcelas;dx<=radioParcelas;dx++) {
+		for(int dz=-radioParcelas;dz<=radioParcelas;dz++) {
+			ids.push_back({cx+dx,cz+dz});
+		}
+	}
+	auto distancia = [&](const Id &id) { return glm::length(glm::vec2(2.f*id.x,2.f*id.z)-centro); };
+	stable_sort(ids.begin(),ids.end(),[&](const Id &a, const Id &b){ return distancia(a)<distancia(b); });
+}
+
+bool MundoInfinito::cerca(Id id) const {
+	return find(deseadas.begin(),deseadas.end(),id)!=deseadas.end();
+}
+
+int MundoInfinito::buscar(Id id) const {
+	for(size_t i=0;i<ranuras.size();i++)
+		if(ranuras[i].ocupada && ranuras[i].id==id) return i;
+	return -1;
+}
+
+void MundoInfinito::subir(Datos &d) {
+	// una libre, o la que hace mas que no se pide entre las que ya no estan cerca
+	int elegida = -1;
+	for(size_t i=0;i<ranuras.size();i++) {
+		const Ranura &r = ranuras[i];
+		if(!r.ocupada) { elegida = i; break; }
+		if(cerca(r.id)) continue;
+		if(elegida==-1 || r.usada<ranuras[elegida].usada) elegida = i;
+	}
+	cg_assert(elegida!=-1,"No hay ranuras para las parcelas cercanas");
+	Ranura &r = ranuras[elegida];
+	if(r.ocupada) ++totales.desalojadas;
+	if(r.buffers.vertexArray()==0) r.buffers = GeometryRenderer(grilla);
+	r.buffers.updatePositions(d.posiciones);
+	r.buffers.updateNormals(d.normales);
+	r.buffers.updateTexCoords(d.coords);
+	r.id = d.id;
+	r.ocupada = true;
+	r.usada = cuadro;
+	++totales.subidas;
+}
+
+void MundoInfinito::actualizar(glm::vec2 centro, double presupuesto) {
+	if(lado==0) return; // sin parametros todavia
+	++cuadro;
+	cercanas(centro,deseadas);
+	centroActual = centro;
+
+	// subir lo que ya se genero, mientras alcance el tiempo
+	auto inicio = chrono::steady_clock::now();
+	bool alguna = false;
+	for(size_t i=0;i<pedidos.size();) {
+		if(alguna && chrono::duration<double>(chrono::steady_clock::now()-inicio).count()>presupuesto) break;
+		if(pedidos[i].datos.wait_for(chrono::seconds(0))!=future_status::ready) { ++i; continue; }
+		Datos d = pedidos[i].datos.get();
+		pedidos.erase(pedidos.begin()+i);
+		++totales.generadas;
+		if(d.leida) ++totales.leidas;
+		if(d.version!=version || !cerca(d.id) || buscar(d.id)!=-1) { ++totales.descartadas; continue; }
+		subir(d);
+		alguna = true;
+	}
+
+	// pedir las que faltan, las mas cercanas primero; con pocas en curso, lo que se
+	// aleja antes de empezar no llega a pedirse
+	ThreadPool &pool = ThreadPool::shared();
+	size_t maximo = max(2,2*pool.size());
+	for(const Id &id : deseadas) {
+		int r = buscar(id);
+		if(r!=-1) { ranuras[r].usada = cuadro; continue; }
+		if(pedidos.size()>=maximo) continue;
+		bool pedida = false;
+		for(const Pedido &p : pedidos)
+			if(p.id==id && p.version==version) pedida = true;
+		if(pedida) continue;
+		ParametrosTerreno p = parametros;
+		int v = version, l = lado;
+		AlmacenDeParcelas *a = almacenParcelas.get();
+		pedidos.push_back({id,version,pool.submit([p,v,id,l,a](){ return generar(p,v,id,l,a); })});
+	}
+}
+
+void MundoInfinito::completar(glm::vec2 centro) {
+	for(;;) {
+		actualizar(centro,1e30);
+		if(estadisticas().faltantes==0 || pedidos.empty()) return;
+		pedidos.front().datos.wait();
+	}
+}
+
+void MundoInfinito::dibujar(Shader &shader, const glm::mat4 &modelo) {
+	for(const Id &id : deseadas) {
+		int r = buscar(id);
+		if(r==-1) continue;
+		glm::vec3 desplazamiento(2.f*id.x-centroActual.x,0.f,2.f*id.z-centroActual.y);
+		shader.setModelMatrix(glm::translate(modelo,desplazamiento));
+		shader.setBuffers(ranuras[r].buffers);
+		ranuras[r].buffers.draw();
+	}
+}
+
+MundoInfinito::Estadisticas MundoInfinito::estadisticas() const {
+	Estadisticas e = totales;
+	e.capacidad = ranuras.size();
+	e.enCurso = pedidos.size();
+	for(const Ranura &r : ranuras)
+		if(r.ocupada) ++e.residentes;
+	for(const Id &id : deseadas)
+		if(buscar(id)==-1) ++e.faltantes;
+	return e;
+}
+
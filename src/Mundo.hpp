@@ -0,0 +1,112 @@
+#ifndef MUNDO_HPP
+#define MUNDO_HPP
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Almacen.hpp"
+#include "GeometryRenderer.hpp"
+#include "Terreno.hpp"
+
+class Shader;
+
+// Mundo sin bordes, hecho de parcelas cuadradas de 2x2 (cada una del tamanio del
+// mapa de siempre: la (0,0) es el [-1,1] de siempre, la (1,0) va de 1 a 3, etc).
+//
+// Cada parcela se genera con RuidoMundo en un hilo del pool (ThreadPool::shared),
+// las mas cercanas a la camara primero y con pocas en curso a la vez, para que al
+// moverse lo que ya no hace falta no llegue a encolarse. En la gpu hay una
+// cantidad fija de ranuras (cada una con su GeometryRenderer, que se reusa sin
+// realocar); una parcela nueva ocupa una libre o la usada hace mas tiempo que ya
+// no esta cerca. Asi la memoria no depende de cuanto se haya recorrido.
+//
+// Con setAlmacen, lo generado se guarda en disco (AlmacenDeParcelas, un archivo
+// por cada juego de parametros del ruido) y se lee de ahi la proxima vez.
+class MundoInfinito {
+public:
+	// radio en parcelas alrededor de la del centro; capacidad de ranuras de la gpu
+	// (0 = las justas para el radio, mas un anillo)
+	MundoInfinito(int radio=2, int capacidad=0);
+	~MundoInfinito(); // espera lo que se esta generando (usa el almacen)
+	
+	// los archivos seran prefijo+huella+".cgtiles" (ver AlmacenDeParcelas), "" para no guardar
+	void setAlmacen(const std::string &prefijo);
+	const AlmacenDeParcelas *almacen() const { return almacenParcelas.get(); }
+
+	// cambiaron los parametros del ruido: lo residente y lo que se esta generando no sirve mas
+	void setParametros(const ParametrosTerreno &p);
+	void setRadio(int radio, int capacidad=0);
+	int radio() const { return radioParcelas; }
+
+	// pide las parcelas alrededor de centro (x,z del mundo) y sube las que ya se
+	// generaron hasta gastar el presupuesto (en segundos, al menos una)
+	void actualizar(glm::vec2 centro, double presupuesto);
+	// bloquea hasta que esten todas las del radio alrededor de centro (sin ventana)
+	void completar(glm::vec2 centro);
+
+	// dibuja las residentes cercanas con shader (ya en uso, con el material y la
+	// textura puestos), modelo es la matriz del mundo con centro en el origen
+	void dibujar(Shader &shader, const glm::mat4 &modelo);
+
+	// para la interfaz y el modo sin ventana
+	struct Estadisticas {
+		int residentes = 0, capacidad = 0; // ranuras ocupadas y totales
+		int enCurso = 0, faltantes = 0;     // generandose, y cercanas que todavia no estan
+		long long generadas = 0, leidas = 0; // de las que llegaron, cuantas salieron del almacen
+		long long descartadas = 0, subidas = 0, desalojadas = 0;
+	};
+	Estadisticas estadisticas() const;
+
+private:
+	struct Id {
+		int x, z;
+		bool operator==(const Id &o) const { return x==o.x && z==o.z; }
+	};
+	// lo que sale de un hilo del pool, todavia sin nada de gl
+	struct Datos {
+		Id id;
+		int version;
+		bool leida; // del almacen
+		std::vector<glm::vec3> posiciones, normales;
+		std::vector<glm::vec2> coords;
+	};
+	struct Ranura {
+		Id id;
+		bool ocupada = false;
+		long long usada = 0; // actualizar en que se pidio por ultima vez
+		GeometryRenderer buffers;
+	};
+	struct Pedido {
+		Id id;
+		int version;
+		std::future<Datos> datos;
+	};
+
+	static Datos generar(const ParametrosTerreno &p, int version, Id id, int lado, AlmacenDeParcelas *almacen);
+	void construirGrilla();
+	void esperarPedidos(); // descarta lo que se esta generando
+	void abrirAlmacen();
+	void cercanas(glm::vec2 centro, std::vector<Id> &ids) const; // por distancia
+	bool cerca(Id id) const;
+	int buscar(Id id) const; // ranura, o -1
+	void subir(Datos &d);
+
+	ParametrosTerreno parametros;
+	int version = 0; // de los parametros, para descartar lo viejo
+	int radioParcelas = 0;
+	int lado = 0; // cuadrados por lado de la malla de cada parcela
+	Geometry grilla; // la malla plana, la misma topologia para todas
+	std::vector<Ranura> ranuras;
+	std::vector<Pedido> pedidos;
+	std::vector<Id> deseadas; // las del ultimo actualizar, la mas cercana primero
+	glm::vec2 centroActual = glm::vec2(0.f,0.f);
+	long long cuadro = 0;
+	Estadisticas totales;
+	std::string prefijoAlmacen;
+	std::unique_ptr<AlmacenDeParcelas> almacenParcelas; // null si no hay o no se pudo abrir
+};
+
+#endif
+
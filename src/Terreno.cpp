@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <cmath>
+#include "Terreno.hpp"
+#include "ArbolMinMax.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+///IMPLEMENTACI?N FUNCIONES
+float interpolacionBilineal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty){
+	
+	
+	if(x1==x2) x2++;
+	if(z1==z2) z2++;
+	
+	float sumV1=fabs((tx-x1)*(ty-z1))*v4;
+	float sumV2=fabs((tx-x2)*(ty-z1))*v3;
+	float sumV3=fabs((tx-x1)*(ty-z2))*v2;
+	float sumV4=fabs((tx-x2)*(ty-z2))*v1;
+	float areaTotal=(x2-x1)*(z2-z1);
+	return (sumV1+sumV2+sumV3+sumV4)/areaTotal;
+}	
+	
+glm::vec3 interpolacionBilinealParanormal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty){
+	
+	if(x1==x2) x2++;
+	if(z1==z2) z2++;
+	
+	glm::vec3 n1 = glm::normalize(glm::cross( (glm::vec3(x1,v2,z2) - glm::vec3(x1,v1,z1)) , (glm::vec3(x2,v3,z1) - glm::vec3(x1,v1,z1))));
+	glm::vec3 n2 = glm::normalize(glm::cross( (glm::vec3(x1,v1,z1) - glm::vec3(x2,v2,z1)) , (glm::vec3(x2,v4,z2) - glm::vec3(x2,v2,z1))));
+	glm::vec3 n3 = glm::normalize(glm::cross( (glm::vec3(x2,v4,z2) - glm::vec3(x1,v3,z2)) , (glm::vec3(x1,v1,z1) - glm::vec3(x1,v3,z2))));
+	glm::vec3 n4 = glm::normalize(glm::cross( (glm::vec3(x2,v3,z1) - glm::vec3(x2,v4,z2)) , (glm::vec3(x1,v2,z2) - glm::vec3(x2,v4,z2))));
+	
+	
+	glm::vec3 sumV1=fabs((tx-x1)*(ty-z1))*n4;
+	glm::vec3 sumV2=fabs((tx-x2)*(ty-z1))*n3;
+	glm::vec3 sumV3=fabs((tx-x1)*(ty-z2))*n2;
+	glm::vec3 sumV4=fabs((tx-x2)*(ty-z2))*n1;
+	float areaTotal=(x2-x1)*(z2-z1);
+	return (sumV1+sumV2+sumV3+sumV4)/areaTotal;
+}	
+	
+	
+float interpolacionLineal(float x1,float x2, float v1,float v2, float tx){
+	float sumV1=fabs(tx-x1)*v2;
+	float sumV2=fabs(tx-x2)*v1;
+	float total=fabs(x2-x1);
+	return (sumV1+sumV2)/total;
+}
+	
+// altura de un punto (tx,tz, en muestras) en la celda de esquina (x1,z1): lo mismo
+// que interpolacionBilineal con x2=x1+1, z2=z1+1 (area 1). Si el punto cae justo
+// sobre una fila de muestras, floor==ceil y las esquinas repetidas pesan 0
+static inline float alturaEnCelda(float x1, float z1, float v1, float v2, float v3, float v4, float tx, float tz) {
+	float x2 = x1+1.f, z2 = z1+1.f;
+	float sumV1=fabs((tx-x1)*(tz-z1))*v4;
+	float sumV2=fabs((tx-x2)*(tz-z1))*v3;
+	float sumV3=fabs((tx-x1)*(tz-z2))*v2;
+	float sumV4=fabs((tx-x2)*(tz-z2))*v1;
+	return sumV1+sumV2+sumV3+sumV4;
+}
+
+void generarOctava(const ParametrosTerreno &parametros, GeneradorTerreno &generador, MapaDeRuido &nuevaOctava, float amplitud, int tamanioSubdivision){
+	
+	for(int i=0;i<=parametros.tamanioMapa;i+=tamanioSubdivision){
+		for(int j=0;j<=parametros.tamanioMapa;j+=tamanioSubdivision){
+			//Crear nodos
+			nuevaOctava[i][j] = amplitud*aleatorio(generador);
+			//Interpolar puntos interiores
+			if(i>=tamanioSubdivision && j>=tamanioSubdivision){
+				for(int a=i-tamanioSubdivision; a<=i; a++){
+					for(int b=j-tamanioSubdivision; b<=j; b++){
+						int x1=i-tamanioSubdivision;
+						int x2=i;
+						int z1=j-tamanioSubdivision;
+						int z2=j;
+						nuevaOctava[a][b] = interpolacionBilineal(x1, z1, x2, z2, nuevaOctava[x1][z1], nuevaOctava[x2][z1], nuevaOctava[x1][z2], nuevaOctava[x2][z2], a, b);
+					}
+				} 
+			}
+		}
+	}
+	
+}
+	
+MapaDeRuido createNoiseMap(const ParametrosTerreno &parametros){
+	// Cada octava saca del generador un valor por nodo y nada mas, asi que se sabe
+	// donde empieza cada una en la secuencia: se generan todas en paralelo (cada 
+	// una con su copia del generador adelantada) y se suman en el mismo orden que
+	// si fueran una atras de otra, da exactamente lo mismo.
+	vector<float> amplitudes;
+	vector<int> subdivisiones;
+	vector<unsigned long long> saltos;
+	
+	float frecuencia = parametros.freq;
+	float amplitud = parametros.amp;
+	unsigned long long salto = 0;
+	for(int o=0;o==0 || o<parametros.numeroDeOctavas;o++) { 
+		if(o>0) {
+			frecuencia *= parametros.persistency;
+			amplitud *= parametros.lacunarity;
+		}
+		int tamanioSubdivision = parametros.tamanioMapa/frecuencia;
+		if(tamanioSubdivision<1) tamanioSubdivision=1; //NO DEBE EXISTIR UNA SUBDIVISION MENOR A 1
+		amplitudes.push_back(amplitud);
+		subdivisiones.push_back(tamanioSubdivision);
+		saltos.push_back(salto);
+		unsigned long long nodos = parametros.tamanioMapa/tamanioSubdivision+1;
+		salto += nodos*nodos;
+	}
+	
+	// De a tandas de tantas octavas como hilos, para que la memoria no crezca con
+	// la cantidad de octavas: la primera va directo al mapa, el resto a mapas
+	// auxiliares que se reusan en cada tanda.
+	int cantidad = amplitudes.size(), lado = parametros.tamanioMapa+1;
+	ThreadPool &pool = ThreadPool::shared();
+	int tanda = max(1,min(cantidad-1,pool.size()));
+	MapaDeRuido noiseMap(lado,FilaDeRuido(lado,0.f));
+	vector<MapaDeRuido> octavas(cantidad>1?tanda:0,MapaDeRuido(lado,FilaDeRuido(lado,0.f)));
+	for(int inicio=0;inicio<cantidad;) {
+		int fin = min(cantidad,(inicio==0?1:inicio)+tanda);
+		pool.parallelFor(fin-inicio,1,[&](int i){
+			int o = inicio+i;
+			MapaDeRuido &octava = o==0 ? noiseMap : octavas[(o-1)%tanda];
+			// generarOctava no escribe lo que sobra si la subdivision no divide al mapa
+			if(inicio>0) for(FilaDeRuido &fila : octava) fill(fila.begin(),fila.end(),0.f);
+			GeneradorTerreno generador(parametros.seed);
+			generador.discard(saltos[o]);
+			generarOctava(parametros, generador, octava, amplitudes[o], subdivisiones[o]);
+		});
+		
+		//Acumular las octavas de la tanda sobre la primera, por filas y en orden
+		int primera = max(inicio,1);
+		pool.parallelFor(lado,16,[&](int m){
+			for(int o=primera;o<fin;o++) { 
+				const FilaDeRuido &fila = octavas[(o-1)%tanda][m];
+				for(int n=0; n<lado;n++) { 
+					noiseMap[m][n] += fila[n];
+				}
+			}
+		});
+		inicio = fin;
+	}
+	return noiseMap;
+}
+// mezcla de 32 bits (el final de murmur3): cambiar un bit de la entrada cambia la mitad de la salida
+static inline uint32_t mezclar(uint32_t h) {
+	h ^= h>>16; h *= 0x85ebca6bu;
+	h ^= h>>13; h *= 0xc2b2ae35u;
+	h ^= h>>16;
+	return h;
+}
+
+RuidoMundo::RuidoMundo(const ParametrosTerreno &parametros) {
+	muestrasPorUnidad = parametros.tamanioMapa*0.5;
+	float frecuencia = parametros.freq;
+	float amplitud = parametros.amp;
+	for(int o=0;o==0 || o<parametros.numeroDeOctavas;o++) { 
+		if(o>0) {
+			frecuencia *= parametros.persistency;
+			amplitud *= parametros.lacunarity;
+		}
+		int tamanioSubdivision = parametros.tamanioMapa/frecuencia;
+		if(tamanioSubdivision<1) tamanioSubdivision=1;
+		octavas.push_back({amplitud,double(tamanioSubdivision),mezclar(uint32_t(parametros.seed)*0x9e3779b9u+uint32_t(o))});
+	}
+}
+
+float RuidoMundo::altura(double x, double z) const {
+	// en muestras, con el (0,0) del mapa de siempre en el (0,0)
+	double xm = (x+1.0)*muestrasPorUnidad, zm = (z+1.0)*muestrasPorUnidad;
+	float suma = 0.f;
+	for(const Octava &o : octavas) { 
+		double xn = xm/o.subdivision, zn = zm/o.subdivision;
+		double xi = floor(xn), zi = floor(zn);
+		float tx = float(xn-xi), tz = float(zn-zi);
+		uint32_t i = uint32_t(int64_t(xi)), j = uint32_t(int64_t(zi));
+		auto nodo = [&](uint32_t a, uint32_t b) {
+			uint32_t h = mezclar(o.semilla ^ mezclar(a+0x9e3779b9u*mezclar(b)));
+			return float(h>>8)*(1.f/16777215.f); // en [0,1]
+		};
+		float v0 = nodo(i,j)*(1.f-tx) + nodo(i+1,j)*tx;
+		float v1 = nodo(i,j+1)*(1.f-tx) + nodo(i+1,j+1)*tx;
+		suma += o.amplitud*(v0*(1.f-tz) + v1*tz);
+	}
+	return suma;
+}
+
+float alturaMaxima(const ParametrosTerreno &parametros) {
+	float total = 0.f, amplitud = parametros.amp;
+	for(int o=0;o<parametros.numeroDeOctavas;o++) { 
+		total += amplitud;
+		amplitud *= parametros.lacunarity;
+	}
+	return total;
+}
+
+float alturaEn(const ParametrosTerreno &parametros, const MapaDeRuido &noiseMap, float x, float z) {
+	float xRuido = (x+1.f)/(2.f) * (float)parametros.tamanioMapa;
+	float zRuido = (z+1.f)/(2.f) * (float)parametros.tamanioMapa;
+	// fuera del mapa, el borde (como en MuestreadorTerreno)
+	xRuido = min(max(xRuido,0.f),(float)parametros.tamanioMapa);
+	zRuido = min(max(zRuido,0.f),(float)parametros.tamanioMapa);
+	
+	int xInterMin = floor(xRuido);
+	int xInterMax = ceil(xRuido);
+	
+	int zInterMin = floor(zRuido);
+	int zInterMax = ceil(zRuido);
+	
+	return alturaEnCelda(xInterMin, zInterMin,
+						 noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
+						 noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
+						 xRuido, zRuido);
+}
+
+// normal de un triangulo de la celda, como glm::normalize(glm::cross(a,b))
+static inline void normalDeTriangulo(float ax, float ay, float az, float bx, float by, float bz, float &nx, float &ny, float &nz) {
+	nx = ay*bz-by*az;
+	ny = az*bx-bz*ax;
+	nz = ax*by-bx*ay;
+	float k = 1.f/sqrt((nx*nx+ny*ny)+nz*nz);
+	nx *= k; ny *= k; nz *= k;
+}
+
+// interpolacionBilinealParanormal con x2=x1+1, z2=z1+1, con las mismas cuentas
+// en el mismo orden (da exactamente lo mismo), pero sin vectores de glm de por
+// medio, para que el lazo de MuestreadorTerreno se pueda vectorizar
+static inline void normalEnCelda(float x1, float z1, float v1, float v2, float v3, float v4, float tx, float tz, glm::vec3 &normal) {
+	float x2 = x1+1.f, z2 = z1+1.f;
+	float n1x, n1y, n1z, n2x, n2y, n2z, n3x, n3y, n3z, n4x, n4y, n4z;
+	normalDeTriangulo(x1-x1,v2-v1,z2-z1, x2-x1,v3-v1,z1-z1, n1x,n1y,n1z);
+	normalDeTriangulo(x1-x2,v1-v2,z1-z1, x2-x2,v4-v2,z2-z1, n2x,n2y,n2z);
+	normalDeTriangulo(x2-x1,v4-v3,z2-z2, x1-x1,v1-v3,z1-z2, n3x,n3y,n3z);
+	normalDeTriangulo(x2-x2,v3-v4,z1-z2, x1-x2,v2-v4,z2-z2, n4x,n4y,n4z);
+	float w1 = fabs((tx-x1)*(tz-z1)), w2 = fabs((tx-x2)*(tz-z1));
+	float w3 = fabs((tx-x1)*(tz-z2)), w4 = fabs((tx-x2)*(tz-z2));
+	normal.x = w1*n4x+w2*n3x+w3*n2x+w4*n1x;
+	normal.y = w1*n4y+w2*n3y+w3*n2y+w4*n1y;
+	normal.z = w1*n4z+w2*n3z+w3*n2z+w4*n1z;
+}
+
+MuestreadorTerreno::MuestreadorTerreno(const MapaDeRuido &mapa, glm::vec2 minimo, glm::vec2 maximo) 
+	: lado(int(mapa.size())-1), minimo(minimo), tamanio(maximo-minimo)
+{
+	if(lado<0) { lado = 0; return; }
+	muestras.resize(mapa.size()*mapa.size());
+	for(size_t i=0;i<mapa.size();i++) 
+		copy(mapa[i].begin(),mapa[i].end(),muestras.begin()+i*mapa.size());
+}
+
+static constexpr int cBloque = 64; // puntos por vuelta de MuestreadorTerreno
+
+// la z de un punto del plano xz (en un vec2, la segunda)
+static inline float coordenadaZ(const glm::vec2 &p) { return p.y; }
+static inline float coordenadaZ(const glm::vec3 &p) { return p.z; }
+
+template<typename Punto>
+void MuestreadorTerreno::muestrearBloque(const Punto *puntos, int n, float *alturas, glm::vec3 *normales, float *pendientes) const {
+	const int filas = lado+1;
+	const float maximo = float(lado);
+	// en muestras (con las mismas cuentas que modifyMesh con la caja de la malla y
+	// alturaEn con [-1,1]), recortadas al mapa; floor es el truncado porque no hay
+	// negativos, y ceil se guarda como el paso a la fila/columna siguiente
+	float tx[cBloque], tz[cBloque], x1[cBloque], z1[cBloque];
+	int base[cBloque], pasoX[cBloque], pasoZ[cBloque];
+	for(int k=0;k<n;k++) {
+		float x = ((puntos[k].x-minimo.x)/tamanio.x)*float(lado);
+		float z = ((coordenadaZ(puntos[k])-minimo.y)/tamanio.y)*float(lado);
+		x = min(max(x,0.f),maximo);
+		z = min(max(z,0.f),maximo);
+		int xi = int(x), zi = int(z);
+		tx[k] = x; tz[k] = z;
+		x1[k] = float(xi); z1[k] = float(zi);
+		base[k] = xi*filas+zi;
+		pasoX[k] = x>x1[k] ? filas : 0;
+		pasoZ[k] = z>z1[k] ? 1 : 0;
+	}
+	// las esquinas de cada celda
+	float v1[cBloque], v2[cBloque], v3[cBloque], v4[cBloque];
+	const float *m = muestras.data();
+	for(int k=0;k<n;k++) {
+		v1[k] = m[base[k]];
+		v2[k] = m[base[k]+pasoX[k]];
+		v3[k] = m[base[k]+pasoZ[k]];
+		v4[k] = m[base[k]+pasoX[k]+pasoZ[k]];
+	}
+	if(alturas) {
+		for(int k=0;k<n;k++)
+			alturas[k] = alturaEnCelda(x1[k],z1[k],v1[k],v2[k],v3[k],v4[k],tx[k],tz[k]);
+	}
+	if(normales) {
+		// con las esquinas repetidas en floor==ceil, como siempre fueron las de la malla
+		for(int k=0;k<n;k++)
+			normalEnCelda(x1[k],z1[k],v1[k],v2[k],v3[k],v4[k],tx[k],tz[k],normales[k]);
+	}
+	if(pendientes) {
+		// el gradiente si necesita las vecinas de verdad: la celda de la izquierda en
+		// el ultimo borde, y la siguiente sobre una fila de muestras
+		float escalaX = float(lado)/tamanio.x, escalaZ = float(lado)/tamanio.y;
+		for(int k=0;k<n;k++) {
+			int xi = min(int(x1[k]),lado-1), zi = min(int(z1[k]),lado-1);
+			int b = xi*filas+zi;
+			v1[k] = m[b]; v2[k] = m[b+filas]; v3[k] = m[b+1]; v4[k] = m[b+filas+1];
+			tx[k] -= float(xi); tz[k] -= float(zi);
+		}
+		for(int k=0;k<n;k++) {
+			float dx = ((1.f-tz[k])*(v2[k]-v1[k]) + tz[k]*(v4[k]-v3[k]))*escalaX;
+			float dz = ((1.f-tx[k])*(v3[k]-v1[k]) + tx[k]*(v4[k]-v2[k]))*escalaZ;
+			pendientes[k] = sqrt(dx*dx+dz*dz);
+		}
+	}
+}
+
+void MuestreadorTerreno::muestrear(const glm::vec2 *puntos, int n, float *alturas, glm::vec3 *normales, float *pendientes) const {
+	if(vacio()) return;
+	for(int i=0;i<n;i+=cBloque)
+		muestrearBloque(puntos+i,min(cBloque,n-i),alturas?alturas+i:nullptr,normales?normales+i:nullptr,pendientes?pendientes+i:nullptr);
+}
+
+void MuestreadorTerreno::muestrear(const glm::vec3 *puntos, int n, float *alturas, glm::vec3 *normales, float *pendientes) const {
+	if(vacio()) return;
+	for(int i=0;i<n;i+=cBloque)
+		muestrearBloque(puntos+i,min(cBloque,n-i),alturas?alturas+i:nullptr,normales?normales+i:nullptr,pendientes?pendientes+i:nullptr);
+}
+
+float MuestreadorTerreno::altura(float x, float z) const {
+	glm::vec2 punto(x,z);
+	float h = 0.f;
+	muestrear(&punto,1,&h);
+	return h;
+}
+
+void ubicarYuyos(const ParametrosTerreno &parametros, const MapaDeRuido &noiseMap, std::vector<glm::mat4> &matrices, bool activados, const ArbolMinMax *arbol) {
+	// con su propio generador, para que no cambien al tocar otra cosa
+	GeneradorTerreno generador(parametros.seed);
+	// sin tierra firme suficientemente alta, los 1000 intentos de cada uno no encontrarian nada
+	if(arbol && !arbol->vacio() && arbol->maximo()-0.4f<parametros.nivelMar) activados = false;
+	for(size_t i=0;i<matrices.size();i++) { 
+		float y = 0.f;
+		float x = 0.f;
+		float z = 0.f;
+		int intentos = 0; // si no hay tierra firme suficientemente alta, no buscar para siempre
+		while (((y - 0.4f<parametros.nivelMar)) && parametros.nivelMar<0.7f && activados && intentos++<1000){
+			
+			x = aleatorio(generador)*2 - 1.f;
+			z = aleatorio(generador)*2 - 1.f;
+			y = alturaEn(parametros, noiseMap, x, z);
+			
+			if(y != y) y=-999.f;
+			
+		}
+		
+		float size = aleatorio(generador)*0.01f + 0.005f;
+		
+		matrices[i] = glm::mat4(	size,	0.00f,  0.00f,	0.00f,
+								  0.00f,	size,	0.00f,	0.00f,
+								  0.00f,	0.00f,	size,	0.00f,
+								  x,	(y-parametros.nivelMar+ size*0.5f), z,	1.00f);
+		
+		size *= 10000.f;
+		matrices[i] = matrices[i] * 	glm::mat4(cos(size),	0.00f,  sin(size),	0.00f,
+										0.0f,	1.00f,  0.00f,	0.00f,
+										-1.f*sin(size),	0.00f,  cos(size),	0.00f,
+										0.0f,	0.00f,  0.00f,	1.00f);
+		
+	}
+}
+
+void modifyMesh(const ParametrosTerreno &parametros, const std::vector<glm::vec3> &v, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &coords, const MapaDeRuido &noiseMap) {
+	
+	vertices.resize(v.size());
+	normals.resize(v.size());
+	coords.resize(v.size());
+	
+	float xMin = v[0].x;
+	float xMax = v[0].x;
+	float zMin = v[0].z;
+	float zMax = v[0].z;
+	
+	for(int i=0;i<v.size();i++) { 
+		if(v[i].x<xMin) xMin = v[i].x;
+		if(v[i].x>xMax) xMax = v[i].x;
+		if(v[i].z<zMin) zMin = v[i].z;
+		if(v[i].z>zMax) zMax = v[i].z;
+	}
+	
+	// el mapa cubre la caja de la malla; cada tramo de vertices es independiente de los demas
+	MuestreadorTerreno muestreador(noiseMap,glm::vec2(xMin,zMin),glm::vec2(xMax,zMax));
+	const int tramo = 2048;
+	ThreadPool::shared().parallelFor((v.size()+tramo-1)/tramo,1,[&](int parte){
+		int inicio = parte*tramo, cantidad = min<int>(tramo,v.size()-inicio);
+		float alturas[tramo];
+		muestreador.muestrear(&v[inicio],cantidad,alturas,&normals[inicio]);
+		for(int i=inicio;i<inicio+cantidad;i++) { 
+			vertices[i] = glm::vec3(v[i].x,alturas[i-inicio]-parametros.nivelMar,v[i].z);
+			
+			float s = 0.001f;
+			if(parametros.amp>0.f) s = vertices[i].y / (parametros.amp);
+			
+			if(s<0.001f)s=0.001f;
+			if(s>0.999f)s=0.999f;
+			float t = 0.5f;
+			coords[i] = glm::vec2(s,t);
+		}
+	});
+}
@@ -0,0 +1,120 @@
+#ifndef TERRENO_HPP
+#define TERRENO_HPP
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MemoryStats.hpp"
+
+// Generacion del terreno (ruido por octavas y deformacion de la malla), sin nada
+// de OpenGL ni estado global: lo usan el programa interactivo y el generador por
+// lotes (generador.cpp), y se puede llamar desde varios hilos a la vez.
+
+struct ParametrosTerreno {
+	int tamanioMapa = 64;
+	int numeroDeOctavas = 8;  		//numero de octavas
+	int freq = 1;			 		//frecuencia
+	int amp = 1;					//amplitud
+	int seed = 0;           		//semilla del generador
+	float persistency = 2.f;       	//factor de "conservacion" de la frecuencia
+	float lacunarity = 0.5f;       	//factor de "desvanecimiento" de la amplitud
+	float nivelMar = 0.4f;       	//esto sube el nivel del mar
+};
+
+// mapa[x][z], de (tamanioMapa+1)x(tamanioMapa+1) muestras (cuentan en memory_stats)
+using FilaDeRuido = std::vector<float,TrackingAllocator<float,memory_stats::cNoiseMaps>>;
+using MapaDeRuido = std::vector<FilaDeRuido,TrackingAllocator<FilaDeRuido,memory_stats::cNoiseMaps>>;
+
+// generador de cada terreno: minstd_rand da la misma secuencia en cualquier
+// plataforma (rand() no, y ademas es global)
+using GeneradorTerreno = std::minstd_rand;
+
+// en [0,1] (uniform_real_distribution tampoco da lo mismo en todas las bibliotecas)
+inline float aleatorio(GeneradorTerreno &generador) {
+	return float(generador()-GeneradorTerreno::min())/float(GeneradorTerreno::max()-GeneradorTerreno::min());
+}
+
+MapaDeRuido createNoiseMap(const ParametrosTerreno &p);
+
+// una octava: valores al azar cada tamanioSubdivision muestras, interpolados entre ellos
+void generarOctava(const ParametrosTerreno &p, GeneradorTerreno &generador, MapaDeRuido &nuevaOctava, float amplitud, int tamanioSubdivision);
+
+// Ruido del mundo sin bordes (ver Mundo.hpp): las mismas octavas que createNoiseMap,
+// pero el valor de cada nodo sale de un hash de la semilla, la octava y la posicion 
+// del nodo en vez de la secuencia del generador, asi que cada punto se evalua solo
+// y dos parcelas vecinas dan lo mismo en su borde. x,z en las unidades de alturaEn:
+// el mapa de siempre va de -1 a 1, y el mundo sigue para todos lados.
+class RuidoMundo {
+public:
+	RuidoMundo(const ParametrosTerreno &p);
+	float altura(double x, double z) const; // sin restar el nivel del mar
+private:
+	struct Octava { 
+		float amplitud;
+		double subdivision; // en muestras del mapa, como en createNoiseMap
+		std::uint32_t semilla;
+	};
+	std::vector<Octava> octavas;
+	double muestrasPorUnidad;
+};
+
+// altura maxima que puede alcanzar el ruido (suma de las amplitudes de las octavas)
+float alturaMaxima(const ParametrosTerreno &p);
+
+// altura del mapa en x,z en [-1,1] (sin restar el nivel del mar)
+float alturaEn(const ParametrosTerreno &p, const MapaDeRuido &noiseMap, float x, float z);
+
+// Alturas, normales y pendientes del mapa en muchos puntos por llamada, para la
+// malla, los yuyos, los caminos o lo que necesite consultar el terreno.
+//
+// Tiene su propia copia del mapa, contigua, y no cambia despues de construido:
+// se puede usar desde varios hilos a la vez. Los puntos se procesan de a bloques:
+// primero las coordenadas de todos, despues las esquinas de sus celdas (leidas
+// con un indice cada una, sin filas de por medio) y al final las cuentas, en
+// lazos sin saltos que el compilador hace con instrucciones vectoriales. Da
+// exactamente lo mismo que alturaEn e interpolacionBilinealParanormal.
+class MuestreadorTerreno {
+public:
+	MuestreadorTerreno() = default;
+	// minimo y maximo: el rectangulo x,z que cubre el mapa (fuera de el, el borde)
+	MuestreadorTerreno(const MapaDeRuido &mapa, glm::vec2 minimo=glm::vec2(-1.f,-1.f), glm::vec2 maximo=glm::vec2(1.f,1.f));
+
+	// n puntos (x,z; de un vec3 no se usa y); las salidas que no hagan falta en nullptr
+	// (sin mapa no se escribe nada).
+	// normales como las de interpolacionBilinealParanormal (en unidades de muestras) y 
+	// pendientes como el largo del gradiente en las unidades de x,z
+	void muestrear(const glm::vec2 *puntos, int n, float *alturas, glm::vec3 *normales=nullptr, float *pendientes=nullptr) const;
+	void muestrear(const glm::vec3 *puntos, int n, float *alturas, glm::vec3 *normales=nullptr, float *pendientes=nullptr) const;
+	float altura(float x, float z) const;
+
+	bool vacio() const { return lado==0; }
+
+private:
+	template<typename Punto>
+	void muestrearBloque(const Punto *puntos, int n, float *alturas, glm::vec3 *normales, float *pendientes) const;
+
+	FilaDeRuido muestras; // mapa[x][z] en muestras[x*(lado+1)+z]
+	int lado = 0;         // celdas por lado
+	glm::vec2 minimo, tamanio;
+};
+
+class ArbolMinMax;
+
+// matrices de los yuyos, en lugares al azar por encima del nivel del mar (si 
+// activados, sino todos en el centro), con tamanio y giro al azar. Con el arbol
+// del mapa, si no hay ningun lugar suficientemente alto no se buscan
+void ubicarYuyos(const ParametrosTerreno &p, const MapaDeRuido &noiseMap, std::vector<glm::mat4> &matrices, bool activados=true,
+				 const ArbolMinMax *arbol=nullptr);
+
+// desplaza los vertices v (plano xz) segun el mapa de ruido
+void modifyMesh(const ParametrosTerreno &p, const std::vector<glm::vec3> &v, std::vector<glm::vec3> &vertices,
+				std::vector<glm::vec3> &normals, std::vector<glm::vec2> &coords, const MapaDeRuido &noiseMap);
+
+//Auxiliares
+float interpolacionBilineal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty);
+glm::vec3 interpolacionBilinealParanormal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty);
+float interpolacionLineal(float x1,float x2, float v1,float v2, float tx);
+
+#endif
+
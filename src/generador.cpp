@@ -0,0 +1,253 @@
+// Generador de terrenos por lotes, sin ventana: recorre todas las combinaciones
+// de las listas de parametros y semillas que se le den, genera cada terreno en
+// un hilo del pool y guarda el mapa de alturas. Al final informa cuantos
+// terrenos por segundo y cuantos MB por segundo se lograron.
+//
+//    generador [opciones]
+//       --seeds LISTA         semillas (0)
+//       --size LISTA          tamanioMapa (64)
+//       --octaves LISTA       numeroDeOctavas (8)
+//       --freq LISTA          frecuencia (1)
+//       --amp LISTA           amplitud (1)
+//       --persistency LISTA   (2)
+//       --lacunarity LISTA    (0.5)
+//       --sealevel LISTA      nivelMar (0.4)
+//       --format png,raw,obj  formatos de salida (png)
+//       --out carpeta         donde se guardan (.)
+//       --threads N           hilos, 0 = uno por nucleo (0)
+//
+// LISTA son valores separados por coma, y cada uno puede ser un rango a:b o
+// a:b:paso (ej: --seeds 0:99,500 --lacunarity 0.4:0.6:0.1).
+//
+// Salidas, terreno_NNNNN.ext mas indice.csv con los parametros de cada uno:
+//   png: gris de 16 bits, 0 = altura 0 y 65535 = alturaMaxima (fila = z, columna = x)
+//   raw: floats de 32 bits en el orden de la maquina, mismo orden que el png,
+//        con la altura sin escalar
+//   obj: la grilla como malla, en [-1,1]x[-1,1] y con el nivel del mar restado
+//        (como la dibuja el programa interactivo)
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Terreno.hpp"
+#include "ThreadPool.hpp"
+#include "PngWriter.hpp"
+using namespace std;
+
+struct Resultado {
+	bool ok = true;
+	size_t bytes = 0;
+	double segundosGenerar = 0, segundosGuardar = 0;
+};
+
+// "a,b:c,d:e:paso" => todos los valores
+static bool leerLista(const string &texto, vector<double> &valores) {
+	valores.clear();
+	istringstream items(texto);
+	for(string item; getline(items,item,','); ) {
+		double desde, hasta, paso = 1;
+		char sep1, sep2;
+		istringstream ss(item);
+		if(!(ss>>desde)) return false;
+		if(!(ss>>sep1)) { valores.push_back(desde); continue; }
+		if(sep1!=':' || !(ss>>hasta)) return false;
+		if(ss>>sep2 && (sep2!=':' || !(ss>>paso) || paso<=0)) return false;
+		for(double v=desde; v<=hasta+paso*1e-6; v+=paso)
+			valores.push_back(v);
+	}
+	return !valores.empty();
+}
+
+static bool guardarPNG(const string &archivo, const ParametrosTerreno &p, const MapaDeRuido &mapa, size_t &bytes) {
+	int n = p.tamanioMapa+1;
+	float escala = alturaMaxima(p)>0.f ? 65535.f/alturaMaxima(p) : 0.f;
+	vector<uint16_t> pixeles(size_t(n)*n);
+	for(int z=0;z<n;z++) {
+		for(int x=0;x<n;x++) {
+			float v = mapa[x][z]*escala + 0.5f;
+			pixeles[size_t(z)*n+x] = v<0.f ? 0 : (v>65535.f ? 65535 : uint16_t(v));
+		}
+	}
+	if(!savePNG(archivo,n,n,1,16,pixeles.data())) return false;
+	bytes += pixeles.size()*2; // aprox, sin cabeceras
+	return true;
+}
+
+static bool guardarRAW(const string &archivo, const ParametrosTerreno &p, const MapaDeRuido &mapa, size_t &bytes) {
+	int n = p.tamanioMapa+1;
+	vector<float> alturas(size_t(n)*n);
+	for(int z=0;z<n;z++) {
+		for(int x=0;x<n;x++) {
+			alturas[size_t(z)*n+x] = mapa[x][z];
+		}
+	}
+	ofstream file(archivo,ios::binary|ios::trunc);
+	file.write(reinterpret_cast<const char*>(alturas.data()),alturas.size()*sizeof(float));
+	if(!file.good()) return false;
+	bytes += alturas.size()*sizeof(float);
+	return true;
+}
+
+// agrega una linea con formato al texto; false si no entro entera (no deberia)
+template<typename... Args>
+static bool agregarLinea(string &texto, const char *formato, Args... args) {
+	char linea[256];
+	int largo = snprintf(linea,sizeof(linea),formato,args...);
+	if(largo<0 || largo>=int(sizeof(linea))) return false;
+	texto.append(linea,largo);
+	return true;
+}
+
+static bool guardarOBJ(const string &archivo, const ParametrosTerreno &p, const MapaDeRuido &mapa, size_t &bytes) {
+	int n = p.tamanioMapa+1;
+	float paso = 2.f/p.tamanioMapa;
+	auto altura = [&](int x, int z) {
+		x = x<0 ? 0 : (x>=n ? n-1 : x);
+		z = z<0 ? 0 : (z>=n ? n-1 : z);
+		return mapa[x][z];
+	};
+	string texto;
+	texto.reserve(size_t(n)*n*100);
+	bool ok = true;
+	for(int z=0;z<n;z++) {
+		for(int x=0;x<n;x++) {
+			ok = ok && agregarLinea(texto,"v %g %g %g\n",x*paso-1.f,mapa[x][z]-p.nivelMar,z*paso-1.f);
+		}
+	}
+	for(int z=0;z<n;z++) {
+		for(int x=0;x<n;x++) {
+			ok = ok && agregarLinea(texto,"vt %g %g\n",float(x)/p.tamanioMapa,float(z)/p.tamanioMapa);
+		}
+	}
+	for(int z=0;z<n;z++) {
+		for(int x=0;x<n;x++) { // diferencias centradas
+			glm::vec3 normal = glm::normalize(glm::vec3(altura(x-1,z)-altura(x+1,z), 2.f*paso, altura(x,z-1)-altura(x,z+1)));
+			ok = ok && agregarLinea(texto,"vn %g %g %g\n",normal.x,normal.y,normal.z);
+		}
+	}
+	for(int z=0;z+1<n;z++) {
+		for(int x=0;x+1<n;x++) {
+			int a = z*n+x+1, b = a+1, c = a+n, d = c+1; // los indices de obj empiezan en 1
+			ok = ok && agregarLinea(texto,"f %i/%i/%i %i/%i/%i %i/%i/%i\n",a,a,a,c,c,c,b,b,b);
+			ok = ok && agregarLinea(texto,"f %i/%i/%i %i/%i/%i %i/%i/%i\n",b,b,b,c,c,c,d,d,d);
+		}
+	}
+	if(!ok) return false;
+	ofstream file(archivo,ios::trunc);
+	file.write(texto.data(),texto.size());
+	if(!file.good()) return false;
+	bytes += texto.size();
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	vector<double> semillas = {0}, tamanios = {64}, octavas = {8}, frecuencias = {1}, amplitudes = {1},
+		persistencias = {2}, lacunaridades = {0.5}, niveles = {0.4};
+	struct { const char *nombre; vector<double> *lista; } listas[] = {
+		{"--seeds",&semillas}, {"--size",&tamanios}, {"--octaves",&octavas}, {"--freq",&frecuencias},
+		{"--amp",&amplitudes}, {"--persistency",&persistencias}, {"--lacunarity",&lacunaridades},
+		{"--sealevel",&niveles} };
+	bool png = true, raw = false, obj = false;
+	string salida = ".";
+	int hilos = 0;
+
+	for(int i=1;i<argc;i++) {
+		string opcion = argv[i];
+		if(i+1>=argc) { cerr<<"Falta el valor de "<<opcion<<endl; return 1; }
+		string valor = argv[++i];
+		bool conocida = false;
+		for(auto &l : listas) {
+			if(opcion!=l.nombre) continue;
+			if(!leerLista(valor,*l.lista)) { cerr<<"Lista invalida para "<<opcion<<": "<<valor<<endl; return 1; }
+			conocida = true;
+		}
+		if(conocida) continue;
+		if(opcion=="--format") {
+			png = raw = obj = false;
+			istringstream formatos(valor);
+			for(string formato; getline(formatos,formato,','); ) {
+				if(formato=="png") png = true;
+				else if(formato=="raw") raw = true;
+				else if(formato=="obj") obj = true;
+				else { cerr<<"Formato desconocido: "<<formato<<endl; return 1; }
+			}
+			if(!png && !raw && !obj) { cerr<<"Falta el formato de --format"<<endl; return 1; }
+		}
+		else if(opcion=="--out") salida = valor;
+		else if(opcion=="--threads") hilos = max(0,atoi(valor.c_str()));
+		else { cerr<<"Opcion desconocida: "<<opcion<<endl; return 1; }
+	}
+
+	// todas las combinaciones
+	vector<ParametrosTerreno> trabajos;
+	for(double t : tamanios) for(double o : octavas) for(double f : frecuencias) for(double a : amplitudes)
+	for(double pe : persistencias) for(double l : lacunaridades) for(double nm : niveles) for(double s : semillas) {
+		ParametrosTerreno p;
+		p.tamanioMapa = max(8,int(t));
+		p.numeroDeOctavas = max(1,int(o));
+		p.freq = max(1,int(f));
+		p.amp = max(0,int(a));
+		p.persistency = pe;
+		p.lacunarity = l;
+		p.nivelMar = nm;
+		p.seed = int(s);
+		trabajos.push_back(p);
+	}
+
+	ofstream indice(salida+"/indice.csv",ios::trunc);
+	if(!indice.is_open()) { cerr<<"No se pudo escribir en "<<salida<<endl; return 1; }
+
+	// el mismo pool que usa createNoiseMap para las octavas, asi no hay mas hilos que nucleos
+	ThreadPool::configureShared(hilos);
+	ThreadPool &pool = ThreadPool::shared();
+	cout<<trabajos.size()<<" terrenos con "<<pool.size()<<" hilos"<<endl;
+	auto t0 = chrono::steady_clock::now();
+	vector<future<Resultado>> resultados;
+	for(size_t i=0;i<trabajos.size();i++) {
+		resultados.push_back(pool.submit([&,i](){
+			Resultado r;
+			const ParametrosTerreno &p = trabajos[i];
+			auto t1 = chrono::steady_clock::now();
+			MapaDeRuido mapa = createNoiseMap(p);
+			auto t2 = chrono::steady_clock::now();
+			char base[32]; snprintf(base,sizeof(base),"/terreno_%05i",int(i));
+			if(png) r.ok = guardarPNG(salida+base+".png",p,mapa,r.bytes) && r.ok;
+			if(raw) r.ok = guardarRAW(salida+base+".raw",p,mapa,r.bytes) && r.ok;
+			if(obj) r.ok = guardarOBJ(salida+base+".obj",p,mapa,r.bytes) && r.ok;
+			r.segundosGenerar = chrono::duration<double>(t2-t1).count();
+			r.segundosGuardar = chrono::duration<double>(chrono::steady_clock::now()-t2).count();
+			return r;
+		}));
+	}
+
+	indice<<"indice,seed,tamanioMapa,numeroDeOctavas,freq,amp,persistency,lacunarity,nivelMar,alturaMaxima\n";
+	Resultado total;
+	int fallidos = 0;
+	for(size_t i=0;i<resultados.size();i++) {
+		Resultado r = resultados[i].get();
+		if(!r.ok) { cerr<<"No se pudo guardar el terreno "<<i<<endl; ++fallidos; }
+		total.bytes += r.bytes;
+		total.segundosGenerar += r.segundosGenerar;
+		total.segundosGuardar += r.segundosGuardar;
+		const ParametrosTerreno &p = trabajos[i];
+		indice<<i<<","<<p.seed<<","<<p.tamanioMapa<<","<<p.numeroDeOctavas<<","<<p.freq<<","<<p.amp<<","
+			<<p.persistency<<","<<p.lacunarity<<","<<p.nivelMar<<","<<alturaMaxima(p)<<"\n";
+	}
+	double segundos = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+
+	double mb = total.bytes/(1024.0*1024.0);
+	cout<<fixed<<setprecision(3)
+		<<"Tiempo total:  "<<segundos<<" s"<<endl
+		<<"Terrenos/s:    "<<(trabajos.size()-fallidos)/segundos<<endl
+		<<"Escritos:      "<<mb<<" MB, "<<mb/segundos<<" MB/s"<<endl
+		<<"Por terreno:   "<<1000.0*total.segundosGenerar/max<size_t>(1,trabajos.size())<<" ms generando, "
+		<<1000.0*total.segundosGuardar/max<size_t>(1,trabajos.size())<<" ms guardando (en cada hilo)"<<endl;
+	return fallidos ? 1 : 0;
+}
+
@@ -7,180 +7,173 @@
 #include <glm/ext.hpp>
 #include "ObjMesh.hpp"
 #include "Shaders.hpp"
+#include "ShaderLibrary.hpp"
 #include "Texture.hpp"
 #include "Window.hpp"
 #include "Callbacks.hpp"
 #include "Model.hpp"
+#include "AssetLoader.hpp"
+#include "TextureData.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "HeadlessContext.hpp"
+#include "Framebuffer.hpp"
+#include "PngWriter.hpp"
+#include "Misc.hpp"
+#include "Terreno.hpp"
+#include "Caminos.hpp"
+#include "ArbolMinMax.hpp"
+#include "Mundo.hpp"
+#include "MemoryStats.hpp"
+#include "ThreadPool.hpp"
 
 #define VERSION 20221019
 #include <iostream>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
 using namespace std;
 
 ///GLOBALES
-typedef struct {
-	int tamanioMapa = 64;
-	int numeroDeOctavas = 8;  		//numero de octavas
+// los del terreno (ver Terreno.hpp) mas los que solo usa la interfaz
+struct sets : ParametrosTerreno {
 	int fact = 1; 					//escala de ruido
-	int freq = 1;			 		//frecuencia
-	int amp = 1;					//amplitud
-	int seed = 0;           		//seed para el srand()
-	float persistency = 2.f;       	//factor de "conservaci?n" de la frecuencia
-	float lacunarity = 0.5f;       	//factor de "desvanecimiento" de la amplitud
-	float nivelMar = 0.4f;       	//esto sube el nivel del mar
 	bool objetosActivados = false;	//lit
 	bool wireframe = false;			//wireframe
-}sets;
+	bool caminosActivados = false;	//caminos y rios tallados en el terreno
+	bool mundoInfinito = false;		//parcelas alrededor de la camara en vez del mapa solo
+	int radioMundo = 2;				//parcelas a cada lado de la del centro
+};
 sets parametros;
 bool reload = true; 
+bool retallar = false; // solo cambiaron los caminos, el ruido no hace falta recalcularlo
 
-///FUNCIONES
-//Perlin
-vector<vector<float>> createNoiseMap();
-void generarOctava(vector<vector<float>> &nuevaOctava, float amplitud, int tamanioSubdivision);
+///ESCENA
+// Todo lo que se dibuja, lo mismo con ventana o sin ella (--headless)
+struct Escena {
+	// se compilan juntos (o se levantan de la cache de binarios), y se recargan
+	// solos si se modifica alguno de sus archivos
+	ShaderLibrary shaders;
+	Shader &shader_phong = shaders.add("shaders/texture");
+	Shader &shader_wire = shaders.add("shaders/wireframe");
+	Shader &shader_instancias = shaders.add("shaders/texture",vector<string>{"INSTANCED"});
+	
+	// Los modelos y texturas se cargan en segundo plano, mientras tanto se dibuja lo que ya este listo
+	AssetLoader loader;
+	
+	// Este es el terreno
+	AssetHandle<vector<Model>> terreno;
+	AssetHandle<Texture> gradiente;
+	bool terrenoListo = false;
+	
+	// Estos son los yuyos: un solo modelo dibujado con instancias, una matriz por yuyo
+	AssetHandle<Model> yuyo;
+	AssetHandle<Texture> yuyoTex;
+	vector<glm::mat4> yuyosMats = vector<glm::mat4>(20);
+	InstanceBuffer yuyosInstancias;
+	
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec3> normales;
+	std::vector<glm::vec2> coords;
+	TrackedBytes memoriaMalla{memory_stats::cGeometry}; // la de estos tres vectores
+	
+	// Una ruta y un rio de ejemplo, se pueden mover desde la interfaz
+	TalladorDeCaminos caminos;
+	vector<Camino> caminosEjemplo;
+	
+	// Alturas minimas y maximas del mapa tallado, para el picking con el mouse y la
+	// linea de vision; se rehace con el ruido y se actualiza con los bloques retallados
+	ArbolMinMax arbol;
+	
+	// El mundo sin bordes (si mundoInfinito): se mueve con shift+arrastrar (world_pos),
+	// y lo generado queda en mundo_*.cgtiles para la proxima vez
+	MundoInfinito mundo;
+	bool mundoPendiente = true; // cambiaron los parametros desde el ultimo setParametros
+	
+	Escena(Window *ventana); // sin ventana, las subidas se hacen todas en actualizar
+	void actualizar(double presupuesto); // subidas pendientes y regeneracion (si reload o retallar)
+	void activarCaminos(bool activar);
+	void regenerarTerreno(bool ruidoNuevo);
+	void dibujar();
+	// punto del terreno bajo el cursor (en coordenadas del modelo, como la malla)
+	bool picar(double x, double y, glm::vec3 &punto, int *visitados=nullptr) const;
+	bool visibleDesdeCamara(const glm::vec3 &punto) const;
+};
 
-//Modificar Malla
-void modifyMesh(const std::vector<glm::vec3> &v, const std::vector<glm::vec3> &n, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &coords, vector<vector<float>> &noiseMap);
+// estado de OpenGL comun a los dos modos
+void configurarGL();
 
-//Auxiliares
-float interpolacionBilineal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty);
-glm::vec3 interpolacionBilinealParanormal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty);
-float interpolacionLineal(float x1,float x2, float v1,float v2, float tx);
-void interpolarAltura(int i, float xMin, float xMax, float zMin, float zMax, const std::vector<glm::vec3> &v, vector<vector<float>> &noiseMap, float &valorInterpolado, glm::vec3 &normal );
+// modo sin ventana: corre un guion y guarda tiempos y capturas
+int correrSinVentana(const string &guion, const string &salida);
 
-int main() {
+int main(int argc, char *argv[]) {
+	
+	// "--bake [--bc1] imagenes..." genera las texturas precocinadas (con mipmaps) y termina
+	if(argc>1 && string(argv[1])=="--bake") {
+		bool comprimir = false;
+		for(int i=2;i<argc;i++) { 
+			if(string(argv[i])=="--bc1") { comprimir = true; continue; }
+			if(!saveTextureData(bakeTexture(loadImage(argv[i]),comprimir),bakedTextureName(argv[i])))
+				cerr<<"No se pudo guardar "<<bakedTextureName(argv[i])<<endl;
+		}
+		return 0;
+	}
+	
+	// "--headless guion [--out carpeta] [--size ancho x alto]" dibuja sin ventana (ver correrSinVentana)
+	if(argc>2 && string(argv[1])=="--headless") {
+		string salida = ".";
+		for(int i=3;i+1<argc;i+=2) { 
+			if(string(argv[i])=="--out") salida = argv[i+1];
+			else if(string(argv[i])=="--size") sscanf(argv[i+1],"%ix%i",&win_width,&win_height);
+			else { cerr<<"Opcion desconocida: "<<argv[i]<<endl; return 1; }
+		}
+		return correrSinVentana(argv[2],salida);
+	}
 	
 	// initialize window and setup callbacks
 	Window window(win_width,win_height,"Terreno Procedural",true);
 	setCommonCallbacks(window);
 	
 	// setup OpenGL state and load shaders
-	glEnable(GL_DEPTH_TEST); glDepthFunc(GL_LESS);
-	glEnable(GL_BLEND); glad_glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-	glClearColor(0.7f,0.7f,0.7f,1.f);
-	
+	configurarGL();
+	GLState &glState = GLState::current();
+	Escena escena(&window);
 	
-	Shader shader_phong("shaders/texture");
-	Shader shader_wire("shaders/wireframe");
+	// tiempos de cada parte del cuadro (ventana "Perfil")
+	Profiler &profiler = Profiler::get();
 	
-	// Este es el terreno
-	auto models = Model::load("mallaRefinada",Model::fKeepGeometry);
-	Model &plane = models[0];
-	plane.texture = Texture("models/elevation_gradient_3.png",false,false);
-	
-	// Estos son los yuyos
-	vector<Model> yuyos(20);
-	vector<glm::mat4> yuyosMats(yuyos.size());
-	for(int i=0;i<yuyos.size();i++) { 
-		yuyos[i] = Model::loadSingle("bush",Model::fKeepGeometry);
-		yuyos[i].texture = Texture("models/green.png",true,true);
-	}
-	
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec3> normales;
-	std::vector<glm::vec2> coords;
+	// clic derecho marca un punto del terreno, para ver si se ve desde la camara
+	bool hayMarca = false;
+	glm::vec3 marca;
+	setPickCallback([&](double x, double y){ hayMarca = escena.picar(x,y,marca); });
 	
 	do {
 		
-		if(parametros.numeroDeOctavas < 3) parametros.objetosActivados = false;
-		
-		if(reload){
-			
-			vector<vector<float>> noiseMap = createNoiseMap();
-			
-			modifyMesh(plane.geometry.positions, plane.geometry.normals, vertices, normales, coords, noiseMap);
-			plane.buffers.updatePositions(vertices,true);
-			plane.buffers.updateTexCoords(coords,true);
-			plane.buffers.updateNormals(normales,true);
-			
-			//YUYOS
-			for(int i=0;i<20;i++) { 
-				float y = 0.f;
-				float x = 0.f;
-				float z = 0.f;
-				while (((y - 0.4f<parametros.nivelMar)) && parametros.nivelMar<0.7f && parametros.objetosActivados){
-					
-					x = ((float)rand()/RAND_MAX)*2 - 1.f;
-					z = ((float)rand()/RAND_MAX)*2 - 1.f;
-					
-					float xRuido = (x+1.f)/(2.f) * (float)parametros.tamanioMapa;
-					float zRuido = (z+1.f)/(2.f) * (float)parametros.tamanioMapa;
-					
-					float xInterMin = floor(xRuido);
-					float xInterMax = ceil(xRuido);
-					
-					float zInterMin = floor(zRuido);
-					float zInterMax = ceil(zRuido);
-					
-					
-					y = interpolacionBilineal(xInterMin, zInterMin, xInterMax, zInterMax,
-													noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
-														noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
-															xRuido, zRuido);
-					
-					if(y != y) y=-999.f;
-					
-				}
-				
-				float size = ((float) rand()/RAND_MAX)*0.01f + 0.005f;
-				
-				yuyosMats[i] = glm::mat4(	size,	0.00f,  0.00f,	0.00f,
-										  0.00f,	size,	0.00f,	0.00f,
-										  0.00f,	0.00f,	size,	0.00f,
-										  x,	(y-parametros.nivelMar+ size*0.5f), z,	1.00f);
-				
-				size *= 10000.f;
-				yuyosMats[i] = yuyosMats[i] * 	glm::mat4(cos(size),	0.00f,  sin(size),	0.00f,
-												0.0f,	1.00f,  0.00f,	0.00f,
-												-1.f*sin(size),	0.00f,  cos(size),	0.00f,
-												0.0f,	0.00f,  0.00f,	1.00f);
-				
-			}
-			
-			reload = false;
-		}
-		
-		glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-		
-		Shader &shader = parametros.wireframe ? shader_wire : shader_phong;
-		shader.use();
-//		glColor3f(1.f,0.64f,0.f);
-		setMatrixes(shader);
-		shader.setLight(glm::vec4{0.f, 1.f, 1.f, 0.f}, glm::vec3{1.f,1.f,1.f}, 0.0f);
-		for(Model &mod : models) {
-			mod.texture.bind();
-			shader.setMaterial(mod.material);
-			shader.setBuffers(mod.buffers);
-			glPolygonMode(GL_FRONT_AND_BACK,parametros.wireframe ? GL_LINE : GL_FILL);
-			
-			mod.buffers.draw();
-		}
+		glState.newFrame();
+		profiler.newFrame();
+		escena.shaders.poll(); // recarga en caliente de shaders editados
+		escena.actualizar(0.005);
+		escena.dibujar();
 		
-		if(!parametros.wireframe && parametros.objetosActivados){
-			shader.use();
-			int i=0;//Dibujar yuyos
-			for(Model &mod : yuyos) {
-				mod.texture.bind();
-				glm::mat4 model_matrix = 	glm::rotate(glm::mat4(1.f), view_angle,glm::vec3{1.f,0.f,0.f}) *
-											glm::rotate(glm::mat4(1.f), model_angle,glm::vec3{0.f,1.f,0.f}) * yuyosMats[i];
-				
-				glm::mat4 view_matrix = common_callbacks::getMatrixes()[1];
-				glm::mat4 proyection_matrix = common_callbacks::getMatrixes()[2];
-				
-				shader.setMatrixes(model_matrix,view_matrix,proyection_matrix);
-				shader.setMaterial(mod.material);
-				shader.setBuffers(mod.buffers);
-				glPolygonMode(GL_FRONT_AND_BACK,GL_FILL);
-				mod.buffers.draw();
-				i++;
-			}
+		// lo que esta bajo el mouse, en cada cuadro
+		bool hayPicado = false;
+		glm::vec3 picado;
+		int visitados = 0;
+		if(!ImGui::GetIO().WantCaptureMouse) {
+			cg_profile("Picking");
+			double x, y;
+			glfwGetCursorPos(window,&x,&y);
+			hayPicado = escena.picar(x,y,picado,&visitados);
 		}
 		
-		
 		// IMGUI
-		window.ImGuiDialog("Parametros Perlin",[&](){
+		profiler.beginCpu("ImGui");
+		window.ImGuiFrame([&](){
+			profiler.drawImGui("Perfil");
+			ImGui::Begin("Parametros Perlin");
 			if(ImGui::InputInt("Tamanio mapa de ruido", &parametros.tamanioMapa)) {
 				if(parametros.tamanioMapa<8) parametros.tamanioMapa = 8; //M?nimo debe existir 1 octava.
 				reload = true;
@@ -203,6 +196,75 @@ int main() {
 			if(ImGui::SliderFloat("Nivel del mar", &parametros.nivelMar, 0, 1)) reload = true;
 			ImGui::Checkbox("Wireframe",&parametros.wireframe);
 			if(ImGui::Checkbox("Objetos activados",&parametros.objetosActivados)) reload = true;
+			if(ImGui::Checkbox("Caminos y rios",&parametros.caminosActivados)) escena.activarCaminos(parametros.caminosActivados);
+			if(parametros.caminosActivados && ImGui::CollapsingHeader("Caminos")) {
+				for(int c=0;c<escena.caminos.cantidad();c++) { 
+					Camino camino = escena.caminos.camino(c);
+					bool cambio = false;
+					ImGui::PushID(c);
+					ImGui::Text(camino.tipo==Camino::cRio?"Rio %i":"Ruta %i",c);
+					for(int i=0;i<=camino.curva.degree();i++) { 
+						float xz[2] = { camino.curva[i].x, camino.curva[i].z };
+						ImGui::PushID(i);
+						if(ImGui::DragFloat2("x,z",xz,0.01f,-1.f,1.f)) {
+							camino.curva[i].x = xz[0]; camino.curva[i].z = xz[1];
+							cambio = true;
+						}
+						ImGui::PopID();
+					}
+					ImGui::PopID();
+					if(cambio) {
+						escena.caminos.mover(c,camino); // solo se retallan los bloques que tocaba o toca
+						retallar = true;
+					}
+				}
+				ImGui::Text("Bloques retallados: %i de %i",escena.caminos.bloquesRecalculados(),escena.caminos.bloquesTotales());
+			}
+			ImGui::Checkbox("Mundo infinito",&parametros.mundoInfinito);
+			if(parametros.mundoInfinito && ImGui::CollapsingHeader("Mundo")) {
+				ImGui::SliderInt("Radio (parcelas)",&parametros.radioMundo,0,6);
+				ImGui::Text("Shift+arrastrar para moverse, en (%.1f, %.1f)",world_pos.x,world_pos.y);
+				MundoInfinito::Estadisticas e = escena.mundo.estadisticas();
+				ImGui::Text("Parcelas en gpu: %i de %i (%i faltan, %i generandose)",e.residentes,e.capacidad,e.faltantes,e.enCurso);
+				ImGui::Text("Generadas %lli (%lli del disco), descartadas %lli, desalojadas %lli",e.generadas,e.leidas,e.descartadas,e.desalojadas);
+				if(const AlmacenDeParcelas *almacen = escena.mundo.almacen()) {
+					AlmacenDeParcelas::Estadisticas a = almacen->estadisticas();
+					ImGui::Text("En disco: %lli parcelas, %.2f MB (%.2f MB sin comprimir)",a.parcelas,a.bytes/(1024.0*1024.0),a.bytesSinComprimir/(1024.0*1024.0));
+				}
+			}
+			if(!parametros.mundoInfinito && ImGui::CollapsingHeader("Picking")) {
+				if(hayPicado) ImGui::Text("Bajo el mouse: (%.3f, %.3f, %.3f), %i nodos",picado.x,picado.y,picado.z,visitados);
+				else ImGui::Text("Bajo el mouse: nada");
+				if(hayMarca) ImGui::Text("Marca: (%.3f, %.3f, %.3f), %s desde la camara",marca.x,marca.y,marca.z,
+										 escena.visibleDesdeCamara(marca)?"visible":"oculta");
+				else ImGui::Text("Clic derecho en el terreno para marcar un punto");
+			}
+			ImGui::Text("Cambios de estado GL evitados: %i de %i",glState.lastFrameStats().skipped,glState.lastFrameStats().calls);
+			if(ImGui::CollapsingHeader("Memoria")) {
+				ImGui::Columns(3);
+				ImGui::Text("Subsistema"); ImGui::NextColumn(); ImGui::Text("Actual (MB)"); ImGui::NextColumn(); ImGui::Text("Maximo (MB)"); ImGui::NextColumn();
+				for(int i=0;i<memory_stats::cCount;i++) { 
+					memory_stats::Category c = static_cast<memory_stats::Category>(i);
+					ImGui::Text("%s%s",memory_stats::name(c),memory_stats::isGpu(c)?" (gpu)":""); ImGui::NextColumn();
+					ImGui::Text("%.2f",memory_stats::current(c)/(1024.0*1024.0)); ImGui::NextColumn();
+					ImGui::Text("%.2f",memory_stats::peak(c)/(1024.0*1024.0)); ImGui::NextColumn();
+				}
+				ImGui::Columns(1);
+			}
+			if(ImGui::CollapsingHeader("Hilos")) {
+				ThreadPool &pool = ThreadPool::shared();
+				ImGui::Columns(4);
+				ImGui::Text("Hilo"); ImGui::NextColumn(); ImGui::Text("Tareas"); ImGui::NextColumn(); ImGui::Text("Robadas"); ImGui::NextColumn(); ImGui::Text("Uso"); ImGui::NextColumn();
+				vector<ThreadPool::WorkerStats> hilos = pool.stats();
+				for(size_t i=0;i<hilos.size();i++) { 
+					ImGui::Text("%i",int(i)); ImGui::NextColumn();
+					ImGui::Text("%lli",hilos[i].tasks); ImGui::NextColumn();
+					ImGui::Text("%lli",hilos[i].stolen); ImGui::NextColumn();
+					ImGui::ProgressBar(hilos[i].utilisation()); ImGui::NextColumn();
+				}
+				ImGui::Columns(1);
+				if(ImGui::Button("Reiniciar contadores")) pool.resetStats();
+			}
 			if (ImGui::Button("Reset")) {
 				parametros.tamanioMapa = 64;
 				parametros.numeroDeOctavas = 8;
@@ -215,204 +277,355 @@ int main() {
 				parametros.nivelMar = 0.4f; 
 				parametros.objetosActivados = false;
 				parametros.wireframe = false;
+				parametros.caminosActivados = false;
+				parametros.mundoInfinito = false;
+				parametros.radioMundo = 2;
+				world_pos = glm::vec2(0.f,0.f);
+				escena.activarCaminos(false);
 				reload = true;
 			}
+			ImGui::End();
 		});
+		profiler.endCpu();
 		
 		// finish frame
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		{
+			cg_profile("Swap");
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
 		
 	} while(glfwGetKey(window,GLFW_KEY_ESCAPE)!=GLFW_PRESS && !glfwWindowShouldClose(window));
 	
 	cout<<"XD";
 }
 
-///IMPLEMENTACI?N FUNCIONES
-float interpolacionBilineal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty){
-	
-	
-	if(x1==x2) x2++;
-	if(z1==z2) z2++;
-	
-	float sumV1=fabs((tx-x1)*(ty-z1))*v4;
-	float sumV2=fabs((tx-x2)*(ty-z1))*v3;
-	float sumV3=fabs((tx-x1)*(ty-z2))*v2;
-	float sumV4=fabs((tx-x2)*(ty-z2))*v1;
-	float areaTotal=(x2-x1)*(z2-z1);
-	return (sumV1+sumV2+sumV3+sumV4)/areaTotal;
-}	
-	
-glm::vec3 interpolacionBilinealParanormal(float x1,float z1,float x2,float z2, float v1,float v2,float v3,float v4,float tx,float ty){
-	
-	if(x1==x2) x2++;
-	if(z1==z2) z2++;
-	
-	glm::vec3 n1 = glm::normalize(glm::cross( (glm::vec3(x1,v2,z2) - glm::vec3(x1,v1,z1)) , (glm::vec3(x2,v3,z1) - glm::vec3(x1,v1,z1))));
-	glm::vec3 n2 = glm::normalize(glm::cross( (glm::vec3(x1,v1,z1) - glm::vec3(x2,v2,z1)) , (glm::vec3(x2,v4,z2) - glm::vec3(x2,v2,z1))));
-	glm::vec3 n3 = glm::normalize(glm::cross( (glm::vec3(x2,v4,z2) - glm::vec3(x1,v3,z2)) , (glm::vec3(x1,v1,z1) - glm::vec3(x1,v3,z2))));
-	glm::vec3 n4 = glm::normalize(glm::cross( (glm::vec3(x2,v3,z1) - glm::vec3(x2,v4,z2)) , (glm::vec3(x1,v2,z2) - glm::vec3(x2,v4,z2))));
-	
-	
-	glm::vec3 sumV1=fabs((tx-x1)*(ty-z1))*n4;
-	glm::vec3 sumV2=fabs((tx-x2)*(ty-z1))*n3;
-	glm::vec3 sumV3=fabs((tx-x1)*(ty-z2))*n2;
-	glm::vec3 sumV4=fabs((tx-x2)*(ty-z2))*n1;
-	float areaTotal=(x2-x1)*(z2-z1);
-	return (sumV1+sumV2+sumV3+sumV4)/areaTotal;
-}	
-	
-	
-float interpolacionLineal(float x1,float x2, float v1,float v2, float tx){
-	float sumV1=fabs(tx-x1)*v2;
-	float sumV2=fabs(tx-x2)*v1;
-	float total=fabs(x2-x1);
-	return (sumV1+sumV2)/total;
+void configurarGL() {
+	glEnable(GL_DEPTH_TEST); glDepthFunc(GL_LESS);
+	GLState &glState = GLState::current();
+	glState.enableBlend(true); glState.blendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+	glClearColor(0.7f,0.7f,0.7f,1.f);
 }
+
+Escena::Escena(Window *ventana) {
+	shaders.loadAll();
+	if(ventana) loader.enableSharedContext(*ventana);
+	terreno = loader.loadModels("mallaRefinada",Model::fKeepGeometry);
+	gradiente = loader.loadTexture("models/elevation_gradient_3.png",false,false);
+	yuyo = loader.loadModel("bush",Model::fKeepGeometry);
+	yuyoTex = loader.loadTexture("models/green.png",true,true);
+	
+	Camino ruta;
+	ruta.curva = { {-0.9f,0.f,-0.6f}, {-0.3f,0.f,0.4f}, {0.3f,0.f,-0.5f}, {0.9f,0.f,0.5f} };
+	caminosEjemplo.push_back(ruta);
+	Camino rio;
+	rio.tipo = Camino::cRio;
+	rio.curva = { {-0.2f,-0.15f,-1.f}, {0.5f,-0.15f,-0.3f}, {-0.6f,-0.15f,0.3f}, {0.1f,-0.15f,1.f} };
+	rio.ancho = 0.05f; rio.borde = 0.1f;
+	caminosEjemplo.push_back(rio);
+	for(const Camino &c : caminosEjemplo) caminos.agregar(c);
+	activarCaminos(parametros.caminosActivados);
+	mundo.setAlmacen("mundo_");
+}
+
+void Escena::activarCaminos(bool activar) {
+	for(int c=0;c<caminos.cantidad();c++) { 
+		if(activar) caminos.mover(c,caminosEjemplo[c]);
+		else caminos.quitar(c);
+	}
+	retallar = true;
+}
+
+void Escena::actualizar(double presupuesto) {
+	{
+		cg_profile_gpu("Subidas asincronicas");
+		loader.processUploads(presupuesto); // y las demas tareas para el hilo principal del pool
+	}
+	if(!terrenoListo && terreno->ready() && gradiente->ready()){
+		terreno->get()[0].texture = std::move(gradiente->get());
+		terrenoListo = true;
+	}
 	
-void interpolarAltura(int i, float xMin, float xMax, float zMin, float zMax, const std::vector<glm::vec3> &v, vector<vector<float>> &noiseMap, float &valorInterpolado, glm::vec3 &normal) {
-	
-	float deltaX = abs(xMax - xMin);
-	float deltaZ = abs(zMax - zMin);
-	
-	float xRuido = ((v[i].x-(float)xMin)/((float)deltaX)) * (float)parametros.tamanioMapa;
-	float zRuido = ((v[i].z-(float)zMin)/((float)deltaZ)) * (float)parametros.tamanioMapa;
-	
-	float xInterMin = floor(xRuido);
-	float xInterMax = ceil(xRuido);
-	
-	float zInterMin = floor(zRuido);
-	float zInterMax = ceil(zRuido);
+	if(parametros.numeroDeOctavas < 3) parametros.objetosActivados = false;
+	if(reload) mundoPendiente = true;
 	
+	if((reload || retallar) && terrenoListo){
+		regenerarTerreno(reload);
+		reload = retallar = false;
+	}
 	
-	if(xInterMax == xInterMin){ //Si el punto a interpolar se encuentra perfectamente entre 2 puntos del mapa de ruido se hace una interpolaciï¿½n lineal directamente.
-		if(zInterMax == zInterMin){//Si el punto se encuentra donde hay un valor en el mapa de ruido nisiquiera se interpola nada. Tomamos el valor y listo
-			valorInterpolado = noiseMap[xInterMin][zInterMin]; 
-			normal = interpolacionBilinealParanormal(xInterMin, zInterMin, xInterMax, zInterMax,
-													 noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
-														 noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
-															 xRuido, zRuido);
+	world_pan = parametros.mundoInfinito;
+	if(parametros.mundoInfinito) {
+		cg_profile_gpu("Mundo");
+		if(mundo.radio()!=parametros.radioMundo) mundo.setRadio(parametros.radioMundo);
+		if(mundoPendiente) { mundo.setParametros(parametros); mundoPendiente = false; }
+		mundo.actualizar(world_pos,presupuesto);
+	}
+}
+
+void Escena::regenerarTerreno(bool ruidoNuevo) {
+	cg_profile("Regenerar terreno");
+	Model &plane = terreno->get()[0];
+	
+	// la malla y los yuyos solo dependen del mapa tallado, se calculan a la vez, y
+	// lo de gl se hace en este hilo (el del contexto) apenas esta listo cada uno
+	const MapaDeRuido *tallado = nullptr;
+	TaskGraph tareas;
+	TaskGraph::Id mapa = tareas.add([&](){
+		if(ruidoNuevo) {
+			cg_profile("Ruido");
+			caminos.setBase(parametros,createNoiseMap(parametros));
 		}
-		else{
-			valorInterpolado = interpolacionLineal(zInterMin, zInterMax, noiseMap[xInterMin][zInterMin], noiseMap[xInterMin][zInterMax], zRuido);
-			
-			
-			normal = interpolacionBilinealParanormal(xInterMin, zInterMin, xInterMax, zInterMax,
-													 noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
-														 noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
-															 xRuido, zRuido);
+		{
+			cg_profile("Tallar caminos");
+			tallado = &caminos.aplicar();
+		}
+		cg_profile("Arbol min-max");
+		if(ruidoNuevo) arbol.construir(*tallado);
+		else {
+			for(int b : caminos.ultimosRecalculados()) { 
+				int x0, z0, x1, z1;
+				caminos.muestrasDeBloque(b,x0,z0,x1,z1);
+				arbol.actualizar(*tallado,x0,z0,x1,z1);
+			}
+		}
+	});
+	TaskGraph::Id malla = tareas.add([&](){
+		cg_profile("Modificar malla");
+		modifyMesh(parametros, plane.geometry.positions, vertices, normales, coords, *tallado);
+		memoriaMalla.set(heldBytes(vertices)+heldBytes(normales)+heldBytes(coords));
+	},{mapa});
+	TaskGraph::Id yuyos = tareas.add([&](){
+		cg_profile("Ubicar yuyos");
+		ubicarYuyos(parametros, *tallado, yuyosMats, parametros.objetosActivados, &arbol);
+	},{mapa});
+	tareas.add([&](){
+		cg_profile_gpu("Subir malla");
+		plane.buffers.updatePositions(vertices,true);
+		plane.buffers.updateTexCoords(coords,true);
+		plane.buffers.updateNormals(normales,true);
+	},{malla},true);
+	tareas.add([&](){ yuyosInstancias.update(yuyosMats); },{yuyos},true);
+	tareas.run();
+}
+
+void Escena::dibujar() {
+	GLState &glState = GLState::current();
+	glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+	
+	Shader &shader = parametros.wireframe ? shader_wire : shader_phong;
+	shader.use();
+//	glColor3f(1.f,0.64f,0.f);
+	setMatrixes(shader);
+	shader.setLight(glm::vec4{0.f, 1.f, 1.f, 0.f}, glm::vec3{1.f,1.f,1.f}, 0.0f);
+	if(terrenoListo && parametros.mundoInfinito) {
+		// las parcelas usan el material y el gradiente del terreno de siempre
+		cg_profile_gpu("Dibujar terreno");
+		Model &mod = terreno->get()[0];
+		mod.texture.bind();
+		shader.setMaterial(mod.material);
+		glState.polygonMode(parametros.wireframe ? GL_LINE : GL_FILL);
+		mundo.dibujar(shader,common_callbacks::getMatrixes()[0]);
+		return; // los yuyos son del mapa solo
+	}
+	if(terrenoListo) {
+		cg_profile_gpu("Dibujar terreno");
+		for(Model &mod : terreno->get()) {
+			mod.texture.bind();
+			shader.setMaterial(mod.material);
+			shader.setBuffers(mod.buffers);
+			glState.polygonMode(parametros.wireframe ? GL_LINE : GL_FILL);
 			
+			mod.buffers.draw();
 		}
-	}else if(zInterMax == zInterMin){
-		valorInterpolado = interpolacionLineal(xInterMin, xInterMax, noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax], xRuido);
-		
-		normal = interpolacionBilinealParanormal(xInterMin, zInterMin, xInterMax, zInterMax,
-												 noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
-													 noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
-														 xRuido, zRuido);
-		
-	}else{
-		valorInterpolado = interpolacionBilineal(xInterMin, zInterMin, xInterMax, zInterMax,
-												 noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
-													 noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
-														 xRuido, zRuido);
-		
-		normal = interpolacionBilinealParanormal(xInterMin, zInterMin, xInterMax, zInterMax,
-									   noiseMap[xInterMin][zInterMin], noiseMap[xInterMax][zInterMin],
-										   noiseMap[xInterMin][zInterMax], noiseMap[xInterMax][zInterMax],
-											   xRuido, zRuido);
-		
 	}
-}
-void generarOctava(vector<vector<float>> &nuevaOctava, float amplitud, int tamanioSubdivision){
 	
-	for(int i=0;i<=parametros.tamanioMapa;i+=tamanioSubdivision){
-		for(int j=0;j<=parametros.tamanioMapa;j+=tamanioSubdivision){
-			//Crear nodos
-			nuevaOctava[i][j] = amplitud*((float)rand()/RAND_MAX);
-			//Interpolar puntos interiores
-			if(i>=tamanioSubdivision && j>=tamanioSubdivision){
-				for(int a=i-tamanioSubdivision; a<=i; a++){
-					for(int b=j-tamanioSubdivision; b<=j; b++){
-						int x1=i-tamanioSubdivision;
-						int x2=i;
-						int z1=j-tamanioSubdivision;
-						int z2=j;
-						nuevaOctava[a][b] = interpolacionBilineal(x1, z1, x2, z2, nuevaOctava[x1][z1], nuevaOctava[x2][z1], nuevaOctava[x1][z2], nuevaOctava[x2][z2], a, b);
-					}
-				} 
-			}
+	if(!parametros.wireframe && parametros.objetosActivados && yuyo->ready() && yuyoTex->ready() && yuyosInstancias.count()){
+		//Dibujar yuyos, todos juntos (la matriz de cada uno esta en yuyosInstancias)
+		cg_profile_gpu("Dibujar yuyos");
+		shader_instancias.use();
+		Model &mod = yuyo->get();
+		yuyoTex->get().bind();
+		glm::mat4 model_matrix = 	glm::rotate(glm::mat4(1.f), view_angle,glm::vec3{1.f,0.f,0.f}) *
+									glm::rotate(glm::mat4(1.f), model_angle,glm::vec3{0.f,1.f,0.f});
+		// vista y proyeccion ya estan en el bloque Camera (setMatrixes de arriba)
+		shader_instancias.setModelMatrix(model_matrix);
+		shader_instancias.setMaterial(mod.material);
+		shader_instancias.setBuffers(mod.buffers,&yuyosInstancias);
+		glState.polygonMode(GL_FILL);
+		mod.buffers.drawInstanced(yuyosInstancias.count());
+	}
+}
+
+
+bool Escena::picar(double x, double y, glm::vec3 &punto, int *visitados) const {
+	if(parametros.mundoInfinito || arbol.vacio()) return false; // el arbol es del mapa solo
+	glm::vec3 origen, direccion;
+	common_callbacks::getMouseRay(x,y,origen,direccion);
+	origen.y += parametros.nivelMar; // el arbol tiene las alturas sin restar el nivel del mar
+	float t;
+	if(!arbol.intersectar(origen,direccion,1.f,t,visitados)) return false;
+	punto = origen+t*direccion;
+	punto.y -= parametros.nivelMar;
+	return true;
+}
+
+bool Escena::visibleDesdeCamara(const glm::vec3 &punto) const {
+	// la camara en coordenadas del modelo
+	auto ms = common_callbacks::getMatrixes();
+	glm::vec3 camara(glm::inverse(ms[1]*ms[0])*glm::vec4(0.f,0.f,0.f,1.f));
+	glm::vec3 mar(0.f,parametros.nivelMar,0.f);
+	return arbol.visible(camara+mar,punto+mar);
+}
+
+
+///MODO SIN VENTANA
+// Cada linea del guion es un paso: pares clave=valor que cambian los parametros
+// (los que no se dan quedan como en el paso anterior), se dibujan "frames" 
+// cuadros y si hay "capture=archivo.png" se guarda el ultimo. Lineas con # son 
+// comentarios. Ver bin/guion_ejemplo.txt.
+static bool aplicarParametro(Escena &escena, const string &clave, const string &valor, int &cuadros, string &captura, vector<glm::vec2> &picados) {
+	auto bandera = [&](){ return valor=="1" || valor=="true"; };
+	auto vector3 = [&](glm::vec3 &v){ return sscanf(valor.c_str(),"%f,%f,%f",&v.x,&v.y,&v.z)==3; };
+	bool regenerar = true;
+	if(clave=="tamanioMapa") parametros.tamanioMapa = max(8,stoi(valor));
+	else if(clave=="numeroDeOctavas") parametros.numeroDeOctavas = max(1,stoi(valor));
+	else if(clave=="seed") parametros.seed = stoi(valor);
+	else if(clave=="freq") parametros.freq = max(1,stoi(valor));
+	else if(clave=="amp") parametros.amp = max(0,stoi(valor));
+	else if(clave=="persistency") parametros.persistency = stof(valor);
+	else if(clave=="lacunarity") parametros.lacunarity = stof(valor);
+	else if(clave=="nivelMar") parametros.nivelMar = stof(valor);
+	else if(clave=="objetosActivados") parametros.objetosActivados = bandera();
+	else if(clave=="mundoInfinito") { parametros.mundoInfinito = bandera(); return true; }
+	else if(clave=="radioMundo") { parametros.radioMundo = max(0,stoi(valor)); return true; }
+	else if(clave=="posMundo") return sscanf(valor.c_str(),"%f,%f",&world_pos.x,&world_pos.y)==2;
+	else if(clave=="caminosActivados") { 
+		parametros.caminosActivados = bandera();
+		escena.activarCaminos(parametros.caminosActivados);
+		return true; // solo hace falta retallar
+	}
+	else {
+		regenerar = false;
+		if(clave=="wireframe") parametros.wireframe = bandera();
+		else if(clave=="model_angle") model_angle = stof(valor);
+		else if(clave=="view_angle") view_angle = stof(valor);
+		else if(clave=="view_fov") view_fov = stof(valor);
+		else if(clave=="view_pos") return vector3(view_pos);
+		else if(clave=="view_target") return vector3(view_target);
+		else if(clave=="frames") cuadros = max(1,stoi(valor));
+		else if(clave=="capture") captura = valor;
+		else if(clave=="picar") { 
+			glm::vec2 cursor;
+			if(sscanf(valor.c_str(),"%f,%f",&cursor.x,&cursor.y)!=2) return false;
+			picados.push_back(cursor);
 		}
+		else return false;
 	}
-	
+	if(regenerar) reload = true;
+	return true;
 }
-	
-vector<vector<float>> createNoiseMap(){
-	srand(parametros.seed); 
-	vector<vector<float>> noiseMap(parametros.tamanioMapa+1,vector<float>(parametros.tamanioMapa+1,0.f));
-	
-	float frecuencia = parametros.freq;
-	float amplitud = parametros.amp;
-	int tamanioSubdivision = parametros.tamanioMapa/frecuencia;
-	
-	if(tamanioSubdivision<1) tamanioSubdivision=1; //NO DEBE EXISTIR UNA SUBDIVISION MENOR A 1
-	
-	///PRIMERA OCTAVA
-	generarOctava(noiseMap, amplitud, tamanioSubdivision);
-	
-	///SEGUNDA Y DEM?S OCTAVAS
-	for(int o=1;o<parametros.numeroDeOctavas;o++) { 
-		frecuencia *= parametros.persistency;
-		amplitud *= parametros.lacunarity;
-		
-		tamanioSubdivision = parametros.tamanioMapa/frecuencia;
-		if(tamanioSubdivision<1) tamanioSubdivision=1; //NO DEBE EXISTIR UNA SUBDIVISION MENOR A 1
-		
-		vector<vector<float>> nuevaOctava(parametros.tamanioMapa+1,vector<float>(parametros.tamanioMapa+1));
-		generarOctava(nuevaOctava, amplitud, tamanioSubdivision);
+
+int correrSinVentana(const string &guion, const string &salida) {
+	ifstream archivo(guion);
+	if(!archivo.is_open()) { cerr<<"No se pudo abrir "<<guion<<endl; return 1; }
+	
+	HeadlessContext contexto;
+	Framebuffer destino(win_width,win_height);
+	destino.bind();
+	configurarGL();
+	GLState &glState = GLState::current();
+	Escena escena(nullptr);
+	escena.loader.finishAll();
+	
+	ofstream tiempos(salida+"/tiempos.csv");
+	if(!tiempos.is_open()) { cerr<<"No se pudo escribir en "<<salida<<endl; return 1; }
+	const char *columnas[] = { "Regenerar terreno", "Ruido", "Tallar caminos", "Arbol min-max", "Modificar malla", "Subir malla", "Ubicar yuyos", 
+							   "Mundo", "Dibujar terreno", "Dibujar yuyos", "Finish" };
+	tiempos<<"paso,cuadro,cuadro_ms";
+	for(const char *c : columnas) tiempos<<","<<c<<"_ms";
+	for(int m=0;m<memory_stats::cCount;m++) tiempos<<","<<memory_stats::name(static_cast<memory_stats::Category>(m))<<"_MB";
+	tiempos<<",captura\n";
+	
+	Profiler &profiler = Profiler::get();
+	profiler.newFrame(); // descarta lo que se midio al cargar
+	int paso = 0, lineaNro = 0;
+	for(string linea; getline(archivo,linea); ) {
+		++lineaNro;
+		fixEOL(linea);
+		if(linea.find('#')!=string::npos) linea.erase(linea.find('#'));
+		istringstream tokens(linea);
+		int cuadros = 1;
+		string captura, token;
+		vector<glm::vec2> picados;
+		bool hayAlgo = false;
+		while(tokens>>token) {
+			hayAlgo = true;
+			auto igual = token.find('=');
+			bool ok = false;
+			try { ok = igual!=string::npos && aplicarParametro(escena,token.substr(0,igual),token.substr(igual+1),cuadros,captura,picados); }
+			catch(std::exception &) { ok = false; } // stoi/stof
+			if(!ok) { cerr<<guion<<":"<<lineaNro<<": no se entiende \""<<token<<"\""<<endl; return 1; }
+		}
+		if(!hayAlgo) continue;
 		
-		//Acumular la nuevaOctava
-		for(int m=0; m<noiseMap.size();m++) { 
-			for(int n=0; n<noiseMap[m].size();n++) { 
-				noiseMap[m][n] += nuevaOctava[m][n];
+		for(int i=0;i<cuadros;i++) {
+			glState.newFrame();
+			escena.actualizar(0.0);
+			if(parametros.mundoInfinito) escena.mundo.completar(world_pos); // que la captura no dependa de los tiempos
+			escena.dibujar();
+			{
+				cg_profile("Finish"); // para que el tiempo del cuadro incluya el de la gpu
+				glFinish();
 			}
+			profiler.newFrame();
+			
+			// totales por nombre del cuadro que se acaba de cerrar
+			const Profiler::Frame &cuadro = profiler.frame(profiler.framesCount()-1);
+			map<string,double> totales;
+			for(const Profiler::Event &e : cuadro.events) 
+				if(e.thread!=-1) totales[e.name] += (e.end-e.start)*1000.0;
+			tiempos<<paso<<","<<i<<","<<cuadro.duration()*1000.0;
+			for(const char *c : columnas) tiempos<<","<<totales[c];
+			for(int m=0;m<memory_stats::cCount;m++) tiempos<<","<<memory_stats::current(static_cast<memory_stats::Category>(m))/(1024.0*1024.0);
+			tiempos<<","<<(i+1==cuadros?captura:"")<<"\n";
+		}
+		
+		if(!captura.empty()) {
+			vector<unsigned char> pixeles = destino.readPixels();
+			if(!savePNG(salida+"/"+captura,destino.width(),destino.height(),4,8,pixeles.data()))
+				cerr<<"No se pudo guardar "<<salida<<"/"<<captura<<endl;
+		}
+		cout<<"Paso "<<paso<<": "<<cuadros<<" cuadros"<<(captura.empty()?"":", "+captura)<<endl;
+		for(const glm::vec2 &cursor : picados) { 
+			glm::vec3 punto;
+			int visitados = 0;
+			cout<<"  Picar ("<<cursor.x<<","<<cursor.y<<"): ";
+			if(escena.picar(cursor.x,cursor.y,punto,&visitados))
+				cout<<"("<<punto.x<<","<<punto.y<<","<<punto.z<<"), "<<visitados<<" nodos, "
+					<<(escena.visibleDesdeCamara(punto)?"visible":"oculto")<<" desde la camara"<<endl;
+			else cout<<"nada ("<<visitados<<" nodos)"<<endl;
 		}
+		++paso;
 	}
-	return noiseMap;
-}
-void modifyMesh(const std::vector<glm::vec3> &v, const std::vector<glm::vec3> &n, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &coords, vector<vector<float>> &noiseMap) {
-	
-	vertices.resize(v.size());
-	normals.resize(v.size());
-	coords.resize(v.size());
 	
-	float xMin = v[0].x;
-	float xMax = v[0].x;
-	float zMin = v[0].z;
-	float zMax = v[0].z;
+	// memoria al terminar y maximos de toda la corrida
+	cout<<"Memoria:"<<endl;
+	memory_stats::report(cout);
+	ofstream memoria(salida+"/memoria.txt");
+	memory_stats::report(memoria);
 	
-	for(int i=0;i<v.size();i++) { 
-		if(v[i].x<xMin) xMin = v[i].x;
-		if(v[i].x>xMax) xMax = v[i].x;
-		if(v[i].z<zMin) zMin = v[i].z;
-		if(v[i].z>zMax) zMax = v[i].z;
+	if(escena.mundo.estadisticas().capacidad) {
+		MundoInfinito::Estadisticas e = escena.mundo.estadisticas();
+		cout<<"Mundo: "<<e.residentes<<" parcelas de "<<e.capacidad<<" en gpu, "<<e.generadas<<" generadas ("
+			<<e.leidas<<" del disco, "<<e.descartadas<<" descartadas), "<<e.desalojadas<<" desalojadas"<<endl;
 	}
 	
-	float valorInterpolado = 0.f;
-	glm::vec3 normal(0.f,1.f,0.f);
-	
-	for(int i=0;i<v.size();i++) { 
-		interpolarAltura(i, xMin, xMax, zMin, zMax, v, noiseMap, valorInterpolado, normal); 
-		
-		vertices[i] = glm::vec3(v[i].x,valorInterpolado-parametros.nivelMar,v[i].z);
-		normals[i] = normal;
-		
-		float s = 0.001f;
-		if(parametros.amp>0.f) s = vertices[i].y / (parametros.amp);
-		
-		if(s<0.001f)s=0.001f;
-		if(s>0.999f)s=0.999f;
-		float t = 0.5f;
-		coords[i] = glm::vec2(s,t);
-	}
+	// cuanto trabajo hizo cada hilo del pool en toda la corrida
+	cout<<"Hilos:"<<endl;
+	vector<ThreadPool::WorkerStats> hilos = ThreadPool::shared().stats();
+	for(size_t i=0;i<hilos.size();i++) 
+		cout<<"  "<<i<<": "<<hilos[i].tasks<<" tareas ("<<hilos[i].stolen<<" robadas), uso "<<int(hilos[i].utilisation()*100+0.5)<<"%"<<endl;
+	return 0;
 }
+